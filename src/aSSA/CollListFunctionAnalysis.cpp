@@ -3,6 +3,7 @@
 #include "parcoach/CollectiveList.h"
 #include "parcoach/DepGraphDCF.h"
 #include "parcoach/MPICommAnalysis.h"
+#include "parcoach/ModuleSummary.h"
 #include "parcoach/Options.h"
 
 #include "PTACallGraph.h"
@@ -114,13 +115,18 @@ struct CollListCFGVisitor : CFGVisitor<CollListCFGVisitor> {
 
 void checkWarnings(
     Function &F, CollectiveList::CommToBBToCollListMap const &CollListsPerComm,
-    DepGraphDCF const &DG, WarningCollection &Warnings,
+    DepGraphDCF &DG, WarningCollection &Warnings,
     FunctionAnalysisManager &FAM, bool EmitDotDG) {
   llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+  // Calls to a function defined in another module are checked like calls to
+  // a collective if its imported summary says it executes some.
   auto IsaDirectCallToCollective = [](Instruction const &I) {
     if (CallInst const *CI = dyn_cast<CallInst>(&I)) {
       Function const *F = CI->getCalledFunction();
       if (F) {
+        if (auto const *FS = summary::findImportedSummary(*F)) {
+          return !FS->Collectives.empty();
+        }
         return Collective::isCollective(*F);
       }
     }
@@ -131,16 +137,16 @@ void checkWarnings(
   for (Instruction &I : Candidates) {
     CallInst &CI = cast<CallInst>(I);
     Function &F = *CI.getCalledFunction();
+    // Null for the functions defined in another module.
     Collective const *Coll = Collective::find(F);
-    assert(Coll && "Coll expected to be not null because of filter");
     // Get conditionals from the callsite
     std::set<BasicBlock const *> CallIpdf;
     DG.getCallInterIPDF(&CI, CallIpdf);
-    LLVM_DEBUG(dbgs() << "Call to " << Coll->Name << "\n");
+    LLVM_DEBUG(dbgs() << "Call to " << F.getName() << "\n");
     LLVM_DEBUG(dbgs() << "callIPDF size: " << CallIpdf.size() << "\n");
     Value *CommForCollective{};
 
-    if (auto const *MPIColl = dyn_cast<MPICollective>(Coll)) {
+    if (auto const *MPIColl = dyn_cast_or_null<MPICollective>(Coll)) {
       CommForCollective = MPIColl->getCommunicator(CI);
     }
 
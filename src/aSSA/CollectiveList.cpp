@@ -1,5 +1,7 @@
 #include "parcoach/CollectiveList.h"
 
+#include "parcoach/ModuleSummary.h"
+
 #include "PTACallGraph.h"
 #include "Utils.h"
 
@@ -104,6 +106,14 @@ CollectiveList CollectiveList::CreateFromBB(BBToCollListMap const &CollLists,
       if (!shouldIgnore(CI, *Coll, Comm)) {
         Current.extendWith<CollElement>(*Coll);
       }
+    } else if (auto const *FS = summary::findImportedSummary(F)) {
+      // The function is defined in another module, we don't know which
+      // communicators its collectives use.
+      for (std::string const &Name : FS->Collectives) {
+        if (auto const *Coll = Collective::find(Name)) {
+          Current.extendWith<CollElement>(*Coll);
+        }
+      }
     } else if (CollLists.count(&F.getEntryBlock()) != 0) {
       auto const &ListForFunc = CollLists.find(&F.getEntryBlock())->second;
       Current.extendWith(ListForFunc);
@@ -56,7 +56,11 @@ private:
 bool Collective::enabled() const { return Options::get().isActivated(P_); }
 
 Collective const *Collective::find(Function const &F) {
-  auto It = Registry::get().find(F.getName());
+  return find(F.getName());
+}
+
+Collective const *Collective::find(StringRef Name) {
+  auto It = Registry::get().find(Name);
   if (It != Registry::get().end() && It->second->enabled()) {
     return It->second;
   }
@@ -3,16 +3,21 @@
 #include "MSSAMuChi.h"
 #include "PTACallGraph.h"
 #include "Utils.h"
+#include "parcoach/ModuleSummary.h"
 #include "parcoach/Options.h"
 
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <algorithm>
 #include <fstream>
+#include <limits>
 #include <queue>
 
 #define DEBUG_TYPE "dgdcf"
@@ -31,32 +36,43 @@ std::vector<char const *> LoadValueSources;
 std::vector<FunctionArg> ResetFunctions;
 cl::opt<bool> OptWeakUpdate("weak-update", cl::desc("Weak update"),
                             cl::cat(ParcoachCategory));
+
+cl::opt<unsigned> OptTaintThreads(
+    "taint-threads",
+    cl::desc("Number of threads used to propagate the taint in the "
+             "context-insensitive mode (0 uses all the cores)"),
+    cl::init(1), cl::cat(ParcoachCategory));
 } // namespace
 
 DepGraphDCF::DepGraphDCF(MemorySSA *Mssa, PTACallGraph const &CG,
                          FunctionAnalysisManager &AM, Module &M,
-                         bool ContextInsensitive, bool NoPtrDep, bool NoPred,
-                         bool DisablePhiElim)
+                         bool ContextInsensitive, bool DemandDriven,
+                         bool NoPtrDep, bool NoPred, bool DisablePhiElim)
     : mssa(Mssa), CG(CG), FAM(AM), M(M), ContextInsensitive(ContextInsensitive),
-      PDT(nullptr), noPtrDep(NoPtrDep), noPred(NoPred),
-      disablePhiElim(DisablePhiElim) {
+      DemandDriven(DemandDriven), PDT(nullptr), noPtrDep(NoPtrDep),
+      noPred(NoPred), disablePhiElim(DisablePhiElim) {
 
-  if (Options::get().isActivated(Paradigm::MPI)) {
-    enableMPI();
-  }
+  // The source and reset functions are shared by all the graphs.
+  static bool const FunctionsEnabled = [] {
+    if (Options::get().isActivated(Paradigm::MPI)) {
+      enableMPI();
+    }
 #ifdef PARCOACH_ENABLE_OPENMP
-  if (Options::get().isActivated(Paradigm::OMP)) {
-    enableOMP();
-  }
+    if (Options::get().isActivated(Paradigm::OMP)) {
+      enableOMP();
+    }
 #endif
 #ifdef PARCOACH_ENABLE_UPC
-  if (Options::get().isActivated(Paradigm::UPC))
-    enableUPC();
+    if (Options::get().isActivated(Paradigm::UPC))
+      enableUPC();
 #endif
 #ifdef PARCOACH_ENABLE_CUDA
-  if (Options::get().isActivated(Paradigm::CUDA))
-    enableCUDA();
+    if (Options::get().isActivated(Paradigm::CUDA))
+      enableCUDA();
 #endif
+    return true;
+  }();
+  (void)FunctionsEnabled;
   build();
 }
 
@@ -64,6 +80,12 @@ DepGraphDCF::~DepGraphDCF() {}
 
 void DepGraphDCF::build() {
   TimeTraceScope TTS("DepGraphDCF");
+  if (DemandDriven) {
+    // The graph is built by the queries.
+    computeCallSites();
+    return;
+  }
+
   for (Function const &F : M) {
     if (!CG.isReachableFromEntry(F)) {
       continue;
@@ -80,6 +102,8 @@ void DepGraphDCF::build() {
     phiElimination();
   }
 
+  freezeGraph();
+
   // Compute tainted values
   if (ContextInsensitive) {
     computeTaintedValuesContextInsensitive();
@@ -88,15 +112,177 @@ void DepGraphDCF::build() {
   }
 
   LLVM_DEBUG({
-    dbgs() << "Tainted values (" << taintedLLVMNodes.size() << "/"
-           << taintedSSANodes.size() << "):\n";
-    for (auto *V : taintedLLVMNodes) {
-      V->print(dbgs());
-      dbgs() << "\n";
+    unsigned NumTaintedSSANodes = 0;
+    for (unsigned Id : taintedNodes.set_bits()) {
+      NumTaintedSSANodes += isSSANode(Id);
+    }
+    dbgs() << "Tainted values ("
+           << taintedNodes.count() - NumTaintedSSANodes << "/"
+           << NumTaintedSSANodes << "):\n";
+    for (unsigned Id : taintedNodes.set_bits()) {
+      if (Value const *V = idToLLVMNode[Id]) {
+        V->print(dbgs());
+        dbgs() << "\n";
+      }
     }
   });
 }
 
+void DepGraphDCF::freezeGraph() {
+  TimeTraceScope TTS("FreezeDepGraph");
+  auto GetLLVMNodeId = [this](Value const *V) {
+    assert(V && "null node in the dependency graph");
+    auto [It, Inserted] = llvmNodeIds.try_emplace(V, idToLLVMNode.size());
+    if (Inserted) {
+      idToLLVMNode.push_back(V);
+    }
+    return It->second;
+  };
+  auto GetSSANodeId = [this](MSSAVar const *V) {
+    auto [It, Inserted] = ssaNodeIds.try_emplace(V, idToLLVMNode.size());
+    if (Inserted) {
+      idToLLVMNode.push_back(nullptr);
+    }
+    return It->second;
+  };
+
+  // Count the functions each node belongs to.
+  DenseMap<Value const *, unsigned> LLVMNodeNumFuncs;
+  DenseMap<MSSAVar const *, unsigned> SSANodeNumFuncs;
+  for (Function const &F : M) {
+    auto ItSSA = funcToSSANodesMap.find(&F);
+    if (ItSSA != funcToSSANodesMap.end()) {
+      for (MSSAVar *V : ItSSA->second) {
+        SSANodeNumFuncs[V]++;
+      }
+    }
+    auto ItLLVM = funcToLLVMNodesMap.find(&F);
+    if (ItLLVM != funcToLLVMNodesMap.end()) {
+      for (Value const *V : ItLLVM->second) {
+        LLVMNodeNumFuncs[V]++;
+      }
+    }
+  }
+
+  // Number the nodes of each function, the ones which only belong to it first.
+  for (bool Shared : {false, true}) {
+    for (Function const &F : M) {
+      auto ItSSA = funcToSSANodesMap.find(&F);
+      auto ItLLVM = funcToLLVMNodesMap.find(&F);
+      if (ItSSA == funcToSSANodesMap.end() &&
+          ItLLVM == funcToLLVMNodesMap.end()) {
+        continue;
+      }
+      FunctionNodes &Nodes = funcToNodes[&F];
+      if (!Shared) {
+        Nodes.Begin = idToLLVMNode.size();
+      }
+      if (ItSSA != funcToSSANodesMap.end()) {
+        for (MSSAVar *V : ItSSA->second) {
+          if ((SSANodeNumFuncs[V] > 1) != Shared) {
+            continue;
+          }
+          unsigned Id = GetSSANodeId(V);
+          if (Shared) {
+            Nodes.Shared.push_back(Id);
+          }
+        }
+      }
+      if (ItLLVM != funcToLLVMNodesMap.end()) {
+        for (Value const *V : ItLLVM->second) {
+          if ((LLVMNodeNumFuncs[V] > 1) != Shared) {
+            continue;
+          }
+          unsigned Id = GetLLVMNodeId(V);
+          if (Shared) {
+            Nodes.Shared.push_back(Id);
+          }
+        }
+      }
+      if (Shared) {
+        llvm::sort(Nodes.Shared);
+      } else {
+        Nodes.End = idToLLVMNode.size();
+      }
+    }
+  }
+
+  // The sources and the extremities of the edges may belong to no function.
+  for (MSSAVar const *V : ssaSources) {
+    ssaSourceIds.push_back(GetSSANodeId(V));
+  }
+  for (Value const *V : valueSources) {
+    valueSourceIds.push_back(GetLLVMNodeId(V));
+  }
+  auto ForEachEdge = [&](auto Fn) {
+    for (auto const &[V, Children] : llvmToLLVMChildren) {
+      unsigned S = GetLLVMNodeId(V);
+      for (Value const *D : Children) {
+        Fn(S, GetLLVMNodeId(D));
+      }
+    }
+    for (auto const &[V, Children] : llvmToSSAChildren) {
+      unsigned S = GetLLVMNodeId(V);
+      for (MSSAVar *D : Children) {
+        Fn(S, GetSSANodeId(D));
+      }
+    }
+    for (auto &[V, Children] : ssaToLLVMChildren) {
+      unsigned S = GetSSANodeId(V);
+      for (Value const *D : Children) {
+        Fn(S, GetLLVMNodeId(D));
+      }
+    }
+    for (auto &[V, Children] : ssaToSSAChildren) {
+      unsigned S = GetSSANodeId(V);
+      for (MSSAVar *D : Children) {
+        Fn(S, GetSSANodeId(D));
+      }
+    }
+  };
+  ForEachEdge([](unsigned, unsigned) {});
+
+  // Store the children of each node contiguously.
+  unsigned NumNodes = idToLLVMNode.size();
+  childOffsets.assign(NumNodes + 1, 0);
+  ForEachEdge([this](unsigned S, unsigned) { childOffsets[S + 1]++; });
+  for (unsigned I = 0; I < NumNodes; I++) {
+    childOffsets[I + 1] += childOffsets[I];
+  }
+  childIds.resize(childOffsets.back());
+  std::vector<unsigned> NextChild(childOffsets.begin(), childOffsets.end() - 1);
+  ForEachEdge([&](unsigned S, unsigned D) { childIds[NextChild[S]++] = D; });
+
+  taintedNodes.resize(NumNodes);
+  taintResetNodes.resize(NumNodes);
+  for (MSSAVar const *V : taintResetSSANodes) {
+    auto It = ssaNodeIds.find(V);
+    if (It != ssaNodeIds.end()) {
+      taintResetNodes.set(It->second);
+    }
+  }
+}
+
+DepGraphDCF::FunctionNodes const &
+DepGraphDCF::getFunctionNodes(Function const *F) const {
+  static FunctionNodes const NoNodes;
+  auto It = funcToNodes.find(F);
+  if (It == funcToNodes.end()) {
+    return NoNodes;
+  }
+  return It->second;
+}
+
+bool DepGraphDCF::isTainted(Value const *V) const {
+  auto It = llvmNodeIds.find(V);
+  return It != llvmNodeIds.end() && taintedNodes.test(It->second);
+}
+
+bool DepGraphDCF::isTainted(MSSAVar const *V) const {
+  auto It = ssaNodeIds.find(V);
+  return It != ssaNodeIds.end() && taintedNodes.test(It->second);
+}
+
 void DepGraphDCF::enableMPI() {
   ResetFunctions.push_back({"MPI_Bcast", 0});
   ResetFunctions.push_back({"MPI_Allgather", 3});
@@ -139,13 +325,23 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
 
   visit(*const_cast<Function *>(F));
 
+  // The parameters the other modules may give a rank-dependent value to.
+  for (int ArgNo : summary::getImportedRankDependentArgs(*F)) {
+    if (ArgNo < 0 || static_cast<unsigned>(ArgNo) >= F->arg_size()) {
+      continue;
+    }
+    Argument const *Arg = F->getArg(ArgNo);
+    funcToLLVMNodesMap[F].insert(Arg);
+    valueSources.insert(Arg);
+  }
+
   // Add entry chi nodes to the graph.
-  for (auto const &Chi : getRange(mssa->getFunToEntryChiMap(), F)) {
+  for (auto *Chi : getRange(mssa->getFunToEntryChiMap(), F)) {
     assert(Chi && Chi->var);
-    funcToSSANodesMap[F].insert(Chi->var.get());
+    funcToSSANodesMap[F].insert(Chi->var);
     if (Chi->opVar) {
       funcToSSANodesMap[F].insert(Chi->opVar);
-      addEdge(Chi->opVar, Chi->var.get());
+      addEdge(Chi->opVar, Chi->var);
     }
   }
 
@@ -155,15 +351,15 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
     // Add var arg entry and exit chi nodes.
     if (F->isVarArg()) {
       for (auto const &I : getRange(mssa->getExtCSToVArgEntryChi(), F)) {
-        MSSAChi *EntryChi = I.second.get();
+        MSSAChi *EntryChi = I.second;
         assert(EntryChi && EntryChi->var && "cs to vararg not found");
-        funcToSSANodesMap[F].emplace(EntryChi->var.get());
+        funcToSSANodesMap[F].emplace(EntryChi->var);
       }
       for (auto const &I : getRange(mssa->getExtCSToVArgExitChi(), F)) {
-        MSSAChi *ExitChi = I.second.get();
+        MSSAChi *ExitChi = I.second;
         assert(ExitChi && ExitChi->var);
-        funcToSSANodesMap[F].insert(ExitChi->var.get());
-        addEdge(ExitChi->opVar, ExitChi->var.get());
+        funcToSSANodesMap[F].insert(ExitChi->var);
+        addEdge(ExitChi->opVar, ExitChi->var);
       }
     }
 
@@ -178,13 +374,13 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
       for (auto const &I : getRange(mssa->getExtCSToArgEntryChi(), F)) {
         MSSAChi *EntryChi = I.second.at(ArgNo);
         assert(EntryChi && EntryChi->var && "cs to arg not found");
-        funcToSSANodesMap[F].emplace(EntryChi->var.get());
+        funcToSSANodesMap[F].emplace(EntryChi->var);
       }
       for (auto const &I : getRange(mssa->getExtCSToArgExitChi(), F)) {
         MSSAChi *ExitChi = I.second.at(ArgNo);
         assert(ExitChi && ExitChi->var);
-        funcToSSANodesMap[F].emplace(ExitChi->var.get());
-        addEdge(ExitChi->opVar, ExitChi->var.get());
+        funcToSSANodesMap[F].emplace(ExitChi->var);
+        addEdge(ExitChi->opVar, ExitChi->var);
       }
 
       ArgNo++;
@@ -193,9 +389,9 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
     // Add retval chi node for external functions
     if (F->getReturnType()->isPointerTy()) {
       for (auto const &I : getRange(mssa->getExtCSToCalleeRetChi(), F)) {
-        MSSAChi *RetChi = I.second.get();
+        MSSAChi *RetChi = I.second;
         assert(RetChi && RetChi->var);
-        funcToSSANodesMap[F].emplace(RetChi->var.get());
+        funcToSSANodesMap[F].emplace(RetChi->var);
       }
     }
 
@@ -208,16 +404,16 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
         MSSAChi *SrcEntryChi = CSToArgEntry[CS][1];
         MSSAChi *DstExitChi = CSToArgExit[CS][0];
 
-        addEdge(SrcEntryChi->var.get(), DstExitChi->var.get());
+        addEdge(SrcEntryChi->var, DstExitChi->var);
 
         // llvm.mempcy instrinsic returns void whereas memcpy returns dst
         if (F->getReturnType()->isPointerTy()) {
           MSSAChi *RetChi{};
           auto It = mssa->getExtCSToCalleeRetChi().find(F);
           if (It != mssa->getExtCSToCalleeRetChi().end()) {
-            RetChi = It->second.at(CS).get();
+            RetChi = It->second.at(CS);
           }
-          addEdge(DstExitChi->var.get(), RetChi->var.get());
+          addEdge(DstExitChi->var, RetChi->var);
         }
       }
     }
@@ -232,16 +428,16 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
         MSSAChi *SrcEntryChi = CSToArgEntry[CS][1];
         MSSAChi *DstExitChi = CSToArgExit[CS][0];
 
-        addEdge(SrcEntryChi->var.get(), DstExitChi->var.get());
+        addEdge(SrcEntryChi->var, DstExitChi->var);
 
         // llvm.memmove instrinsic returns void whereas memmove returns dst
         if (F->getReturnType()->isPointerTy()) {
           MSSAChi *RetChi{};
           auto It = mssa->getExtCSToCalleeRetChi().find(F);
           if (It != mssa->getExtCSToCalleeRetChi().end()) {
-            RetChi = It->second.at(CS).get();
+            RetChi = It->second.at(CS);
           }
-          addEdge(DstExitChi->var.get(), RetChi->var.get());
+          addEdge(DstExitChi->var, RetChi->var);
         }
       }
     }
@@ -252,16 +448,16 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
         CallBase *CS = I.first;
 
         MSSAChi *ArgExitChi = mssa->getExtCSToArgExitChi().lookup(F)[CS][0];
-        addEdge(F->getArg(1), ArgExitChi->var.get());
+        addEdge(F->getArg(1), ArgExitChi->var);
 
         // llvm.memset instrinsic returns void whereas memset returns dst
         if (F->getReturnType()->isPointerTy()) {
           MSSAChi *RetChi{};
           auto It = mssa->getExtCSToCalleeRetChi().find(F);
           if (It != mssa->getExtCSToCalleeRetChi().end()) {
-            RetChi = It->second.at(CS).get();
+            RetChi = It->second.at(CS);
           }
-          addEdge(ArgExitChi->var.get(), RetChi->var.get());
+          addEdge(ArgExitChi->var, RetChi->var);
         }
       }
     }
@@ -269,48 +465,48 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
     // Unknown external function, we have to connect every input to every
     // output.
     else {
+      auto CSToArgExit = mssa->getExtCSToArgExitChi().lookup(F);
+      auto CSToArgEntry = mssa->getExtCSToArgEntryChi().lookup(F);
       for (CallBase *Cs : getRange(mssa->getExtFuncToCSMap(), F)) {
         std::set<MSSAVar *> SsaOutputs;
         std::set<MSSAVar *> SsaInputs;
 
         // Compute SSA outputs
-        auto const &CSToArgExit = mssa->getExtCSToArgExitChi();
-        auto const &CSToArgEntry = mssa->getExtCSToArgEntryChi();
-        auto IndexToExitChi = CSToArgExit.lookup(F)[Cs];
+        auto const &IndexToExitChi = CSToArgExit[Cs];
         for (auto &I : IndexToExitChi) {
           MSSAChi *ArgExitChi = I.second;
-          SsaOutputs.emplace(ArgExitChi->var.get());
+          SsaOutputs.emplace(ArgExitChi->var);
         }
         if (F->isVarArg()) {
           MSSAChi *VarArgExitChi{};
           auto It = mssa->getExtCSToVArgExitChi().find(F);
           if (It != mssa->getExtCSToVArgExitChi().end()) {
-            VarArgExitChi = It->second.at(Cs).get();
+            VarArgExitChi = It->second.at(Cs);
           }
-          SsaOutputs.emplace(VarArgExitChi->var.get());
+          SsaOutputs.emplace(VarArgExitChi->var);
         }
         if (F->getReturnType()->isPointerTy()) {
           MSSAChi *RetChi{};
           auto It = mssa->getExtCSToCalleeRetChi().find(F);
           if (It != mssa->getExtCSToCalleeRetChi().end()) {
-            RetChi = It->second.at(Cs).get();
+            RetChi = It->second.at(Cs);
           }
-          SsaOutputs.emplace(RetChi->var.get());
+          SsaOutputs.emplace(RetChi->var);
         }
 
         // Compute SSA inputs
-        auto IndexToEntryChi = CSToArgEntry.lookup(F)[Cs];
+        auto const &IndexToEntryChi = CSToArgEntry[Cs];
         for (auto &I : IndexToEntryChi) {
           MSSAChi *ArgEntryChi = I.second;
-          SsaInputs.emplace(ArgEntryChi->var.get());
+          SsaInputs.emplace(ArgEntryChi->var);
         }
         if (F->isVarArg()) {
           MSSAChi *VarArgEntryChi{};
           auto It = mssa->getExtCSToVArgEntryChi().find(F);
           if (It != mssa->getExtCSToVArgEntryChi().end()) {
-            VarArgEntryChi = It->second.at(Cs).get();
+            VarArgEntryChi = It->second.at(Cs);
           }
-          SsaInputs.emplace(VarArgEntryChi->var.get());
+          SsaInputs.emplace(VarArgEntryChi->var);
         }
 
         // Connect SSA inputs to SSA outputs
@@ -336,7 +532,7 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
       }
       for (auto const &I : getRange(mssa->getExtCSToArgExitChi(), F)) {
         assert(I.second.at(ArgNo));
-        ssaSources.emplace(I.second.at(ArgNo)->var.get());
+        ssaSources.emplace(I.second.at(ArgNo)->var);
       }
     }
   }
@@ -344,19 +540,19 @@ void DepGraphDCF::buildFunction(llvm::Function const *F) {
 
 void DepGraphDCF::visitBasicBlock(llvm::BasicBlock &BB) {
   // Add MSSA Phi nodes and edges to the graph.
-  for (auto const &Phi : getRange(mssa->getBBToPhiMap(), &BB)) {
+  for (auto *Phi : getRange(mssa->getBBToPhiMap(), &BB)) {
     assert(Phi && Phi->var);
-    funcToSSANodesMap[curFunc].insert(Phi->var.get());
+    funcToSSANodesMap[curFunc].insert(Phi->var);
     for (auto I : Phi->opsVar) {
       assert(I.second);
       funcToSSANodesMap[curFunc].insert(I.second);
-      addEdge(I.second, Phi->var.get());
+      addEdge(I.second, Phi->var);
     }
 
     if (!noPred) {
       for (Value const *Pred : Phi->preds) {
         funcToLLVMNodesMap[curFunc].insert(Pred);
-        addEdge(Pred, Phi->var.get());
+        addEdge(Pred, Phi->var);
       }
     }
   }
@@ -404,7 +600,7 @@ void DepGraphDCF::visitLoadInst(llvm::LoadInst &LI) {
   funcToLLVMNodesMap[curFunc].insert(LI.getPointerOperand());
 
   auto const &MuSetForLoad = getRange(mssa->getLoadToMuMap(), &LI);
-  for (auto const &Mu : MuSetForLoad) {
+  for (auto *Mu : MuSetForLoad) {
     assert(Mu && Mu->var);
     funcToSSANodesMap[curFunc].emplace(Mu->var);
     addEdge(Mu->var, &LI);
@@ -413,7 +609,7 @@ void DepGraphDCF::visitLoadInst(llvm::LoadInst &LI) {
   // Load value rank source
   for (auto const &Name : LoadValueSources) {
     if (LI.getPointerOperand()->getName() == Name) {
-      for (auto const &Mu : MuSetForLoad) {
+      for (auto *Mu : MuSetForLoad) {
         assert(Mu && Mu->var);
         ssaSources.emplace(Mu->var);
       }
@@ -430,21 +626,21 @@ void DepGraphDCF::visitLoadInst(llvm::LoadInst &LI) {
 void DepGraphDCF::visitStoreInst(llvm::StoreInst &I) {
   // Store inst
   // For each chi, connect the pointer, the value stored and the MSSA operand.
-  for (auto const &Chi : getRange(mssa->getStoreToChiMap(), &I)) {
+  for (auto *Chi : getRange(mssa->getStoreToChiMap(), &I)) {
     assert(Chi && Chi->var && Chi->opVar);
-    funcToSSANodesMap[curFunc].emplace(Chi->var.get());
+    funcToSSANodesMap[curFunc].emplace(Chi->var);
     funcToSSANodesMap[curFunc].emplace(Chi->opVar);
     funcToLLVMNodesMap[curFunc].emplace(I.getPointerOperand());
     funcToLLVMNodesMap[curFunc].emplace(I.getValueOperand());
 
-    addEdge(I.getValueOperand(), Chi->var.get());
+    addEdge(I.getValueOperand(), Chi->var);
 
     if (OptWeakUpdate) {
-      addEdge(Chi->opVar, Chi->var.get());
+      addEdge(Chi->opVar, Chi->var);
     }
 
     if (!noPtrDep) {
-      addEdge(I.getPointerOperand(), Chi->var.get());
+      addEdge(I.getPointerOperand(), Chi->var);
     }
   }
 }
@@ -574,6 +770,12 @@ void DepGraphDCF::visitCallInst(llvm::CallInst &CI) {
 
       valueSources.insert(&CI);
     }
+
+    // Return value of a function defined in another module.
+    if (auto const *FS = summary::findImportedSummary(*Callee);
+        FS && FS->RankDependentReturn) {
+      valueSources.insert(&CI);
+    }
   }
 
   // indirect call
@@ -598,26 +800,26 @@ void DepGraphDCF::visitCallInst(llvm::CallInst &CI) {
   }
 
   // Sync CHI
-  for (auto const &Chi : getRange(mssa->getCSToSynChiMap(), &CI)) {
+  for (auto *Chi : getRange(mssa->getCSToSynChiMap(), &CI)) {
     assert(Chi && Chi->var && Chi->opVar);
-    funcToSSANodesMap[curFunc].emplace(Chi->var.get());
+    funcToSSANodesMap[curFunc].emplace(Chi->var);
     funcToSSANodesMap[curFunc].emplace(Chi->opVar);
 
-    addEdge(Chi->opVar, Chi->var.get());
-    taintResetSSANodes.emplace(Chi->var.get());
+    addEdge(Chi->opVar, Chi->var);
+    taintResetSSANodes.emplace(Chi->var);
   }
 }
 
 void DepGraphDCF::connectCSMus(llvm::CallInst &I) {
   // Mu of the call site.
-  for (auto const &Mu : getRange(mssa->getCSToMuMap(), &I)) {
+  for (auto *Mu : getRange(mssa->getCSToMuMap(), &I)) {
     assert(Mu && Mu->var);
     funcToSSANodesMap[curFunc].emplace(Mu->var);
     Function const *Called = NULL;
 
     // External Function, we connect call mu to artifical chi of the external
     // function for each argument.
-    if (MSSAExtCallMu *ExtCallMu = dyn_cast<MSSAExtCallMu>(Mu.get())) {
+    if (MSSAExtCallMu *ExtCallMu = dyn_cast<MSSAExtCallMu>(Mu)) {
       CallBase *CS(&I);
 
       Called = ExtCallMu->called;
@@ -631,10 +833,10 @@ void DepGraphDCF::connectCSMus(llvm::CallInst &I) {
         auto ItEnd = mssa->getExtCSToVArgEntryChi().end();
         MSSAChi *Chi{};
         if (ItMap != ItEnd) {
-          Chi = ItMap->second.at(CS).get();
+          Chi = ItMap->second.at(CS);
         }
         assert(Chi);
-        MSSAVar *Var = Chi->var.get();
+        MSSAVar *Var = Chi->var;
         assert(Var);
         funcToSSANodesMap[Called].emplace(Var);
         addEdge(Mu->var, Var); // rule3
@@ -644,13 +846,13 @@ void DepGraphDCF::connectCSMus(llvm::CallInst &I) {
         // rule3
         auto const &CSToArgEntry = mssa->getExtCSToArgEntryChi();
         assert(CSToArgEntry.lookup(Called)[CS].at(ArgNo));
-        addEdge(Mu->var, CSToArgEntry.lookup(Called)[CS].at(ArgNo)->var.get());
+        addEdge(Mu->var, CSToArgEntry.lookup(Called)[CS].at(ArgNo)->var);
       }
 
       continue;
     }
 
-    MSSACallMu *CallMu = cast<MSSACallMu>(Mu.get());
+    MSSACallMu *CallMu = cast<MSSACallMu>(Mu);
     Called = CallMu->called;
 
     auto const &FunctionToChi = mssa->getFunRegToEntryChiMap();
@@ -659,28 +861,28 @@ void DepGraphDCF::connectCSMus(llvm::CallInst &I) {
     if (It != FunctionToChi.end()) {
       MSSAChi *EntryChi = It->second.at(Mu->region);
       assert(EntryChi && EntryChi->var && "reg to entrychi not found");
-      funcToSSANodesMap[Called].emplace(EntryChi->var.get());
-      addEdge(CallMu->var, EntryChi->var.get()); // rule3
+      funcToSSANodesMap[Called].emplace(EntryChi->var);
+      addEdge(CallMu->var, EntryChi->var); // rule3
     }
   }
 }
 
 void DepGraphDCF::connectCSChis(llvm::CallInst &I) {
   // Chi of the callsite.
-  for (auto const &Chi : getRange(mssa->getCSToChiMap(), &I)) {
+  for (auto *Chi : getRange(mssa->getCSToChiMap(), &I)) {
     assert(Chi && Chi->var && Chi->opVar);
     funcToSSANodesMap[curFunc].emplace(Chi->opVar);
-    funcToSSANodesMap[curFunc].emplace(Chi->var.get());
+    funcToSSANodesMap[curFunc].emplace(Chi->var);
 
     if (OptWeakUpdate) {
-      addEdge(Chi->opVar, Chi->var.get()); // rule4
+      addEdge(Chi->opVar, Chi->var); // rule4
     }
 
     Function const *Called = NULL;
 
     // External Function, we connect call chi to artifical chi of the external
     // function for each argument.
-    if (MSSAExtCallChi *ExtCallChi = dyn_cast<MSSAExtCallChi>(Chi.get())) {
+    if (MSSAExtCallChi *ExtCallChi = dyn_cast<MSSAExtCallChi>(Chi)) {
       CallBase *CS(&I);
       Called = ExtCallChi->called;
       unsigned ArgNo = ExtCallChi->argNo;
@@ -693,21 +895,20 @@ void DepGraphDCF::connectCSChis(llvm::CallInst &I) {
         auto ItEnd = mssa->getExtCSToVArgExitChi().end();
         MSSAChi *Chi{};
         if (ItMap != ItEnd) {
-          Chi = ItMap->second.at(CS).get();
+          Chi = ItMap->second.at(CS);
         }
         assert(Chi);
-        MSSAVar *Var = Chi->var.get();
+        MSSAVar *Var = Chi->var;
         assert(Var);
         funcToSSANodesMap[Called].emplace(Var);
-        addEdge(Var, Chi->var.get()); // rule5
+        addEdge(Var, Chi->var); // rule5
       }
 
       else {
         // rule5
         auto const &CSToArgExit = mssa->getExtCSToArgExitChi();
         assert(CSToArgExit.lookup(Called)[CS].at(ArgNo));
-        addEdge(CSToArgExit.lookup(Called)[CS].at(ArgNo)->var.get(),
-                Chi->var.get());
+        addEdge(CSToArgExit.lookup(Called)[CS].at(ArgNo)->var, Chi->var);
 
         // Reset functions
         for (auto const &[Name, FArgNo] : ResetFunctions) {
@@ -719,14 +920,14 @@ void DepGraphDCF::connectCSChis(llvm::CallInst &I) {
             continue;
           }
 
-          taintResetSSANodes.emplace(Chi->var.get());
+          taintResetSSANodes.emplace(Chi->var);
         }
       }
 
       continue;
     }
 
-    MSSACallChi *CallChi = cast<MSSACallChi>(Chi.get());
+    MSSACallChi *CallChi = cast<MSSACallChi>(Chi);
     Called = CallChi->called;
 
     auto const &FunctionToMu = mssa->getFunRegToReturnMuMap();
@@ -735,7 +936,7 @@ void DepGraphDCF::connectCSChis(llvm::CallInst &I) {
       MSSAMu *ReturnMu = It->second.at(Chi->region);
       assert(ReturnMu && ReturnMu->var && "entry not found in map");
       funcToSSANodesMap[Called].emplace(ReturnMu->var);
-      addEdge(ReturnMu->var, Chi->var.get()); // rule5
+      addEdge(ReturnMu->var, Chi->var); // rule5
     }
   }
 }
@@ -792,7 +993,7 @@ void DepGraphDCF::connectCSEffectiveParametersExt(CallInst &I,
     Value const *CArg = I.getArgOperand(1);
     assert(CArg);
     funcToLLVMNodesMap[I.getParent()->getParent()].emplace(CArg);
-    addEdge(CArg, ArgExitChi->var.get());
+    addEdge(CArg, ArgExitChi->var);
   }
 }
 
@@ -833,15 +1034,15 @@ void DepGraphDCF::connectCSRetChi(llvm::CallInst &I) {
   // direct call
   if (Callee) {
     if (Callee->isDeclaration() && Callee->getReturnType()->isPointerTy()) {
-      for (auto const &Chi : getRange(mssa->getExtCSToCallerRetChi(), &I)) {
+      for (auto *Chi : getRange(mssa->getExtCSToCallerRetChi(), &I)) {
         assert(Chi && Chi->var && Chi->opVar);
-        funcToSSANodesMap[curFunc].emplace(Chi->var.get());
+        funcToSSANodesMap[curFunc].emplace(Chi->var);
         funcToSSANodesMap[curFunc].emplace(Chi->opVar);
 
-        addEdge(Chi->opVar, Chi->var.get());
+        addEdge(Chi->opVar, Chi->var);
         auto ItMap = mssa->getExtCSToCalleeRetChi().find(Callee);
         assert(ItMap != mssa->getExtCSToCalleeRetChi().end());
-        addEdge(ItMap->second.at(CS)->var.get(), Chi->var.get());
+        addEdge(ItMap->second.at(CS)->var, Chi->var);
       }
     }
   }
@@ -851,15 +1052,15 @@ void DepGraphDCF::connectCSRetChi(llvm::CallInst &I) {
     for (Function const *MayCallee : getRange(CG.getIndirectCallMap(), &I)) {
       if (MayCallee->isDeclaration() &&
           MayCallee->getReturnType()->isPointerTy()) {
-        for (auto const &Chi : getRange(mssa->getExtCSToCallerRetChi(), &I)) {
+        for (auto *Chi : getRange(mssa->getExtCSToCallerRetChi(), &I)) {
           assert(Chi && Chi->var && Chi->opVar);
-          funcToSSANodesMap[curFunc].emplace(Chi->var.get());
+          funcToSSANodesMap[curFunc].emplace(Chi->var);
           funcToSSANodesMap[curFunc].emplace(Chi->opVar);
 
-          addEdge(Chi->opVar, Chi->var.get());
+          addEdge(Chi->opVar, Chi->var);
           auto ItMap = mssa->getExtCSToCalleeRetChi().find(MayCallee);
           assert(ItMap != mssa->getExtCSToCalleeRetChi().end());
-          addEdge(ItMap->second.at(CS)->var.get(), Chi->var.get());
+          addEdge(ItMap->second.at(CS)->var, Chi->var);
         }
       }
     }
@@ -1002,7 +1203,7 @@ void DepGraphDCF::toDot(StringRef Filename) const {
       Stream << "Node" << ((void *)S) << " -> "
              << "NodeCall" << ((void *)Call) << "\n";
     }
-    /*if (taintedLLVMNodes.count(s) != 0){
+    /*if (isTainted(s)){
             errs() << "DBG: " << s->getName() << " is a tainted condition \n";
             s->dump();
     }*/
@@ -1065,14 +1266,14 @@ void DepGraphDCF::dotExtFunction(raw_fd_ostream &Stream,
 }
 
 std::string DepGraphDCF::getNodeStyle(llvm::Value const *V) const {
-  if (taintedLLVMNodes.count(V) != 0) {
+  if (isTainted(V)) {
     return "style=filled, color=red";
   }
   return "style=filled, color=white";
 }
 
 std::string DepGraphDCF::getNodeStyle(MSSAVar const *V) const {
-  if (taintedSSANodes.count(V) != 0) {
+  if (isTainted(V)) {
     return "style=filled, color=red";
   }
   return "style=filled, color=white";
@@ -1108,104 +1309,429 @@ void DepGraphDCF::computeTaintedValuesContextInsensitive() {
 
   TimeTraceScope TTS("FloodDep");
 
-  std::queue<MSSAVar *> VarToVisit;
-  std::queue<Value const *> ValueToVisit;
+  if (OptTaintThreads != 1) {
+    floodInParallel();
+  } else {
+    floodSequentially();
+  }
 
-  // SSA sources
-  for (MSSAVar const *Src : ssaSources) {
-    taintedSSANodes.insert(Src);
-    VarToVisit.push(const_cast<MSSAVar *>(Src));
+  for (unsigned Id : taintedNodes.set_bits()) {
+    if (Value const *V = idToLLVMNode[Id]) {
+      taintedConditions.insert(V);
+    }
   }
 
-  // Value sources
-  for (Value const *Src : valueSources) {
-    taintedLLVMNodes.insert(Src);
-    ValueToVisit.push(Src);
+  assert(FuncToLlvmNodesMapSize == funcToLLVMNodesMap.size());
+  assert(FuncToSsaNodesMapSize == funcToSSANodesMap.size());
+  assert(VarArgNodeSize == varArgNodes.size());
+  assert(LlvmToLlvmChildrenSize == llvmToLLVMChildren.size());
+  assert(LlvmToLlvmParentsSize == llvmToLLVMParents.size());
+  assert(LlvmToSsaChildrenSize == llvmToSSAChildren.size());
+  assert(LlvmToSsaParentsSize == llvmToSSAParents.size());
+  assert(SsaToLlvmChildrenSize == ssaToLLVMChildren.size());
+  assert(SsaToLlvmParentsSize == ssaToLLVMParents.size());
+  assert(SsaToSsaChildrenSize == ssaToSSAChildren.size());
+  assert(SsaToSsaParentsSize == ssaToSSAParents.size());
+  assert(FuncToCallNodesSize == funcToCallNodes.size());
+  assert(CallToFuncEdgesSize == callToFuncEdges.size());
+  assert(CondToCallEdgesSize == condToCallEdges.size());
+  assert(FuncToCallSitesSize == funcToCallSites.size());
+  assert(CallsiteToCondsSize == callsiteToConds.size());
+}
+
+void DepGraphDCF::floodSequentially() {
+  std::vector<unsigned> ToVisit;
+
+  // SSA and value sources
+  for (unsigned Src : ssaSourceIds) {
+    taintedNodes.set(Src);
+    ToVisit.push_back(Src);
+  }
+  for (unsigned Src : valueSourceIds) {
+    taintedNodes.set(Src);
+    ToVisit.push_back(Src);
   }
 
-  while (!VarToVisit.empty() || !ValueToVisit.empty()) {
-    if (!VarToVisit.empty()) {
-      MSSAVar *S = VarToVisit.front();
-      VarToVisit.pop();
+  while (!ToVisit.empty()) {
+    unsigned S = ToVisit.back();
+    ToVisit.pop_back();
 
-      if (taintResetSSANodes.find(S) != taintResetSSANodes.end()) {
+    if (taintResetNodes.test(S)) {
+      continue;
+    }
+
+    for (unsigned D : getChildren(S)) {
+      if (taintedNodes.test(D)) {
         continue;
       }
 
-      if (ssaToSSAChildren.find(S) != ssaToSSAChildren.end()) {
-        for (MSSAVar *D : ssaToSSAChildren[S]) {
-          if (taintedSSANodes.count(D) != 0) {
-            continue;
-          }
+      taintedNodes.set(D);
+      ToVisit.push_back(D);
+    }
+  }
+}
 
-          taintedSSANodes.insert(D);
-          VarToVisit.push(D);
-        }
+void DepGraphDCF::floodInParallel() {
+  // The nodes of the functions of a SCC of the call graph are flooded by the
+  // same task, the SCCs concurrently. A task only reads and writes the taint
+  // of its own nodes, the taint leaving its SCC is collected and handed to
+  // the other SCCs between two rounds. The nodes shared by several
+  // functions, or which belong to none, are flooded between the rounds too.
+  static constexpr unsigned NoSCC = std::numeric_limits<unsigned>::max();
+  unsigned NumNodes = idToLLVMNode.size();
+  std::vector<unsigned> NodeSCC(NumNodes, NoSCC);
+  unsigned NumSCCs = 0;
+  for (auto It = scc_begin(&CG); !It.isAtEnd(); ++It) {
+    bool HasNodes = false;
+    for (PTACallGraphNode const *N : *It) {
+      FunctionNodes const &Nodes = getFunctionNodes(N->getFunction());
+      for (unsigned Id = Nodes.Begin; Id < Nodes.End; Id++) {
+        NodeSCC[Id] = NumSCCs;
+        HasNodes = true;
       }
+    }
+    NumSCCs += HasNodes;
+  }
 
-      if (ssaToLLVMChildren.find(S) != ssaToLLVMChildren.end()) {
-        for (Value const *D : ssaToLLVMChildren[S]) {
-          if (taintedLLVMNodes.count(D) != 0) {
-            continue;
-          }
+  // These are bytes rather than a BitVector, so that the nodes of distinct
+  // SCCs can be written concurrently.
+  std::vector<uint8_t> Tainted(NumNodes);
+  std::vector<std::vector<unsigned>> ToVisit(NumSCCs);
+  std::vector<std::vector<unsigned>> Leaving(NumSCCs);
+  std::vector<unsigned> SharedToVisit;
 
-          taintedLLVMNodes.insert(D);
-          ValueToVisit.push(D);
+  auto Taint = [&](unsigned Id) {
+    if (Tainted[Id]) {
+      return;
+    }
+    Tainted[Id] = true;
+    if (NodeSCC[Id] == NoSCC) {
+      SharedToVisit.push_back(Id);
+    } else {
+      ToVisit[NodeSCC[Id]].push_back(Id);
+    }
+  };
+  auto FloodShared = [&]() {
+    while (!SharedToVisit.empty()) {
+      unsigned S = SharedToVisit.back();
+      SharedToVisit.pop_back();
+      if (taintResetNodes.test(S)) {
+        continue;
+      }
+      for (unsigned D : getChildren(S)) {
+        Taint(D);
+      }
+    }
+  };
+  auto FloodSCC = [&](unsigned SCC) {
+    std::vector<unsigned> &SCCToVisit = ToVisit[SCC];
+    while (!SCCToVisit.empty()) {
+      unsigned S = SCCToVisit.back();
+      SCCToVisit.pop_back();
+      if (taintResetNodes.test(S)) {
+        continue;
+      }
+      for (unsigned D : getChildren(S)) {
+        if (NodeSCC[D] != SCC) {
+          Leaving[SCC].push_back(D);
+        } else if (!Tainted[D]) {
+          Tainted[D] = true;
+          SCCToVisit.push_back(D);
         }
       }
     }
+  };
 
-    if (!ValueToVisit.empty()) {
-      Value const *S = ValueToVisit.front();
-      ValueToVisit.pop();
+  // SSA and value sources
+  for (unsigned Src : ssaSourceIds) {
+    Taint(Src);
+  }
+  for (unsigned Src : valueSourceIds) {
+    Taint(Src);
+  }
+  FloodShared();
 
-      if (llvmToLLVMChildren.find(S) != llvmToLLVMChildren.end()) {
-        for (Value const *D : llvmToLLVMChildren[S]) {
-          if (taintedLLVMNodes.count(D) != 0) {
-            continue;
-          }
+  ThreadPool Pool(hardware_concurrency(OptTaintThreads));
+  while (true) {
+    bool Flooded = false;
+    for (unsigned SCC = 0; SCC < NumSCCs; SCC++) {
+      if (!ToVisit[SCC].empty()) {
+        Pool.async([&FloodSCC, SCC]() { FloodSCC(SCC); });
+        Flooded = true;
+      }
+    }
+    if (!Flooded) {
+      break;
+    }
+    Pool.wait();
 
-          taintedLLVMNodes.insert(D);
-          ValueToVisit.push(D);
-        }
+    for (std::vector<unsigned> &SCCLeaving : Leaving) {
+      for (unsigned D : SCCLeaving) {
+        Taint(D);
       }
+      SCCLeaving.clear();
+    }
+    FloodShared();
+  }
 
-      if (llvmToSSAChildren.find(S) != llvmToSSAChildren.end()) {
-        for (MSSAVar *D : llvmToSSAChildren[S]) {
-          if (taintedSSANodes.count(D) != 0) {
-            continue;
-          }
-          taintedSSANodes.insert(D);
-          VarToVisit.push(D);
+  for (unsigned Id = 0; Id < NumNodes; Id++) {
+    if (Tainted[Id]) {
+      taintedNodes.set(Id);
+    }
+  }
+}
+
+bool DepGraphDCF::isTaintedValue(Value const *V) {
+  if (!DemandDriven) {
+    return taintedConditions.find(V) != taintedConditions.end();
+  }
+
+  auto It = demandedValues.find(V);
+  if (It != demandedValues.end()) {
+    return It->second;
+  }
+  bool Tainted = computeTaintOnDemand(V);
+  demandedValues[V] = Tainted;
+  return Tainted;
+}
+
+void DepGraphDCF::computeCallSites() {
+  // The call sites are needed to find the callers of a function, and by
+  // getCallInterIPDF(), before the graph of their functions is built.
+  unsigned Index = 0;
+  for (Function const &F : M) {
+    funcToModuleIndex[&F] = Index++;
+    if (!CG.isReachableFromEntry(F) || F.isDeclaration()) {
+      continue;
+    }
+
+    for (Instruction const &I : instructions(F)) {
+      CallInst const *CI = dyn_cast<CallInst>(&I);
+      if (!CI || isIntrinsicDbgInst(CI)) {
+        continue;
+      }
+
+      if (Function const *Callee = CI->getCalledFunction()) {
+        funcToCallSites[Callee].insert(CI);
+        continue;
+      }
+      for (Function const *MayCallee : getRange(CG.getIndirectCallMap(), CI)) {
+        funcToCallSites[MayCallee].insert(CI);
+      }
+    }
+  }
+
+  // The nodes of the external functions are duplicated for each call site.
+  auto AddCallSiteChis = [this](auto const &CSToChi) {
+    for (auto const &[Callee, CallSites] : CSToChi) {
+      for (auto const &[CS, Chi] : CallSites) {
+        extNodeToCaller[Chi->var] = CS->getFunction();
+      }
+    }
+  };
+  auto AddCallSiteArgChis = [this](auto const &CSToArgChi) {
+    for (auto const &[Callee, CallSites] : CSToArgChi) {
+      for (auto const &[CS, ArgChis] : CallSites) {
+        for (auto const &[ArgNo, Chi] : ArgChis) {
+          extNodeToCaller[Chi->var] = CS->getFunction();
         }
       }
     }
+  };
+  AddCallSiteChis(mssa->getExtCSToCalleeRetChi());
+  AddCallSiteChis(mssa->getExtCSToVArgEntryChi());
+  AddCallSiteChis(mssa->getExtCSToVArgExitChi());
+  AddCallSiteArgChis(mssa->getExtCSToArgEntryChi());
+  AddCallSiteArgChis(mssa->getExtCSToArgExitChi());
+}
+
+void DepGraphDCF::buildFunctionOnDemand(Function const *F) {
+  if (!builtFunctions.insert(F).second) {
+    return;
   }
 
-  for (Value const *V : taintedLLVMNodes) {
-    taintedConditions.insert(V);
+  // Same functions as build().
+  if (!CG.isReachableFromEntry(*F) || isIntrinsicDbgFunction(F)) {
+    return;
   }
 
-  assert(FuncToLlvmNodesMapSize == funcToLLVMNodesMap.size());
-  assert(FuncToSsaNodesMapSize == funcToSSANodesMap.size());
-  assert(VarArgNodeSize == varArgNodes.size());
-  assert(LlvmToLlvmChildrenSize == llvmToLLVMChildren.size());
-  assert(LlvmToLlvmParentsSize == llvmToLLVMParents.size());
-  assert(LlvmToSsaChildrenSize == llvmToSSAChildren.size());
-  assert(LlvmToSsaParentsSize == llvmToSSAParents.size());
-  assert(SsaToLlvmChildrenSize == ssaToLLVMChildren.size());
-  assert(SsaToLlvmParentsSize == ssaToLLVMParents.size());
-  assert(SsaToSsaChildrenSize == ssaToSSAChildren.size());
-  assert(SsaToSsaParentsSize == ssaToSSAParents.size());
-  assert(FuncToCallNodesSize == funcToCallNodes.size());
-  assert(CallToFuncEdgesSize == callToFuncEdges.size());
-  assert(CondToCallEdgesSize == condToCallEdges.size());
-  assert(FuncToCallSitesSize == funcToCallSites.size());
-  assert(CallsiteToCondsSize == callsiteToConds.size());
+  buildFunction(F);
+}
+
+void DepGraphDCF::eliminatePhisOnDemand(Function const *F) {
+  buildFunctionOnDemand(F);
+  if (disablePhiElim || !phiEliminatedFunctions.insert(F).second) {
+    return;
+  }
+
+  // Eliminating the phis of a function needs all the edges of its nodes,
+  // some of them are added when building its callers.
+  auto It = funcToCallSites.find(F);
+  if (It != funcToCallSites.end()) {
+    for (Value const *CS : It->second) {
+      buildFunctionOnDemand(cast<CallInst>(CS)->getFunction());
+    }
+  }
+  TimeTraceScope TTS("PhiElimination");
+  eliminatePhis(*F);
+}
+
+void DepGraphDCF::prepareParents(Function const *F) {
+  if (!F || !preparedFunctions.insert(F).second) {
+    return;
+  }
+
+  // Nothing is connected to the arguments of an external function.
+  if (F->isDeclaration()) {
+    buildFunctionOnDemand(F);
+    return;
+  }
+
+  // The edges to the nodes of F are added when building F and its callers,
+  // and the phi elimination of these functions moves them. The phis are
+  // eliminated in the order of the module, as phiElimination() does.
+  std::vector<Function const *> ToEliminate{F};
+  auto It = funcToCallSites.find(F);
+  if (It != funcToCallSites.end()) {
+    for (Value const *CS : It->second) {
+      ToEliminate.push_back(cast<CallInst>(CS)->getFunction());
+    }
+  }
+  llvm::sort(ToEliminate, [this](Function const *A, Function const *B) {
+    return funcToModuleIndex.lookup(A) < funcToModuleIndex.lookup(B);
+  });
+  ToEliminate.erase(std::unique(ToEliminate.begin(), ToEliminate.end()),
+                    ToEliminate.end());
+  for (Function const *G : ToEliminate) {
+    eliminatePhisOnDemand(G);
+  }
+}
+
+void DepGraphDCF::prepareParents(MSSAVar const *V) {
+  // The node of an external function at a call site is connected by the
+  // external function and by the caller.
+  auto It = extNodeToCaller.find(V);
+  if (It != extNodeToCaller.end()) {
+    buildFunctionOnDemand(getNodeFunction(V));
+    eliminatePhisOnDemand(It->second);
+    return;
+  }
+  prepareParents(getNodeFunction(V));
+}
+
+bool DepGraphDCF::computeTaintOnDemand(Value const *V) {
+  TimeTraceScope TTS("TaintOnDemand");
+  // Walk the graph backward from V until reaching a source. The taint reset
+  // nodes don't propagate the taint to their children, the walk stops there.
+  std::vector<Value const *> LLVMToVisit{V};
+  std::vector<MSSAVar *> SSAToVisit;
+  DenseSet<Value const *> VisitedLLVM{V};
+  DenseSet<MSSAVar *> VisitedSSA;
+  std::vector<MSSAVar *> ResetNodes;
+
+  auto VisitLLVM = [&](Value const *P) {
+    if (!untaintedLLVMNodes.count(P) && VisitedLLVM.insert(P).second) {
+      LLVMToVisit.push_back(P);
+    }
+  };
+  auto VisitSSA = [&](MSSAVar *P) {
+    if (!untaintedSSANodes.count(P) && VisitedSSA.insert(P).second) {
+      SSAToVisit.push_back(P);
+    }
+  };
+
+  // The parents of D are only final once their own function is prepared:
+  // eliminating the phis of a callee moves the edges of a phi parent to the
+  // operand it is merged into. Prepare them until no function is built or
+  // has its phis eliminated anymore, then visit them.
+  auto VisitParents = [&](auto const &ToLLVMParents, auto const &ToSSAParents,
+                          auto *D) {
+    size_t Prepared;
+    do {
+      Prepared = builtFunctions.size() + phiEliminatedFunctions.size();
+      auto LLVMParents = getRange(ToLLVMParents, D);
+      std::vector<Value const *> LLVMParentsCopy(LLVMParents.begin(),
+                                                 LLVMParents.end());
+      for (Value const *P : LLVMParentsCopy) {
+        prepareParents(getNodeFunction(P));
+      }
+      auto SSAParents = getRange(ToSSAParents, D);
+      std::vector<MSSAVar *> SSAParentsCopy(SSAParents.begin(),
+                                            SSAParents.end());
+      for (MSSAVar *P : SSAParentsCopy) {
+        prepareParents(P);
+      }
+    } while (Prepared !=
+             builtFunctions.size() + phiEliminatedFunctions.size());
+
+    for (Value const *P : getRange(ToLLVMParents, D)) {
+      VisitLLVM(P);
+    }
+    for (MSSAVar *P : getRange(ToSSAParents, D)) {
+      VisitSSA(P);
+    }
+  };
+
+  while (!LLVMToVisit.empty() || !SSAToVisit.empty()) {
+    if (!LLVMToVisit.empty()) {
+      Value const *D = LLVMToVisit.back();
+      LLVMToVisit.pop_back();
+      prepareParents(getNodeFunction(D));
+      if (valueSources.count(D) != 0) {
+        return true;
+      }
+      if (D != V && demandedValues.lookup(D)) {
+        return true;
+      }
+      VisitParents(llvmToLLVMParents, llvmToSSAParents, D);
+      continue;
+    }
+
+    MSSAVar *D = SSAToVisit.back();
+    SSAToVisit.pop_back();
+    prepareParents(D);
+    // V is a top-level variable, so D was reached from one of its children.
+    if (taintResetSSANodes.count(D) != 0) {
+      ResetNodes.push_back(D);
+      continue;
+    }
+    if (ssaSources.count(D) != 0) {
+      return true;
+    }
+    VisitParents(ssaToLLVMParents, ssaToSSAParents, D);
+  }
+
+  // No source reaches the nodes visited, except maybe the reset ones.
+  for (MSSAVar *Var : ResetNodes) {
+    VisitedSSA.erase(Var);
+  }
+  untaintedLLVMNodes.insert(VisitedLLVM.begin(), VisitedLLVM.end());
+  untaintedSSANodes.insert(VisitedSSA.begin(), VisitedSSA.end());
+  return false;
+}
+
+Function const *DepGraphDCF::getNodeFunction(Value const *V) {
+  if (auto const *I = dyn_cast<Instruction>(V)) {
+    return I->getFunction();
+  }
+  if (auto const *Arg = dyn_cast<Argument>(V)) {
+    return Arg->getParent();
+  }
+  // The other values have no parents.
+  return nullptr;
 }
 
-bool DepGraphDCF::isTaintedValue(Value const *V) const {
-  return taintedConditions.find(V) != taintedConditions.end();
+Function const *DepGraphDCF::getNodeFunction(MSSAVar const *V) {
+  switch (V->def->type) {
+  case MSSADef::EXTVARARG:
+    return cast<MSSAExtVarArgChi>(V->def)->func;
+  case MSSADef::EXTARG:
+    return cast<MSSAExtArgChi>(V->def)->func;
+  case MSSADef::EXTRET:
+    return cast<MSSAExtRetChi>(V->def)->func;
+  default:
+    return V->bb ? V->bb->getParent() : nullptr;
+  }
 }
 
 void DepGraphDCF::getCallInterIPDF(
@@ -1239,101 +1765,70 @@ void DepGraphDCF::getCallInterIPDF(
   }
 }
 
-bool DepGraphDCF::areSSANodesEquivalent(MSSAVar *Var1, MSSAVar *Var2) {
-  assert(Var1);
-  assert(Var2);
-
-  if (Var1->def->type == MSSADef::PHI || Var2->def->type == MSSADef::PHI) {
-    return false;
-  }
-
-  VarSet IncomingSsAsVar1;
-  VarSet IncomingSsAsVar2;
-
-  ValueSet IncomingValuesVar1;
-  ValueSet IncomingValuesVar2;
-
-  bool FoundVar1 = false;
-  bool FoundVar2 = false;
-  FoundVar1 = ssaToSSAChildren.find(Var1) != ssaToSSAChildren.end();
-  FoundVar2 = ssaToSSAChildren.find(Var2) != ssaToSSAChildren.end();
-  if (FoundVar1 != FoundVar2) {
-    return false;
-  }
-
-  // Check whether number of edges are the same for both nodes.
-  if (FoundVar1 && FoundVar2) {
-    if (ssaToSSAChildren[Var1].size() != ssaToSSAChildren[Var2].size()) {
-      return false;
-    }
-  }
-
-  FoundVar1 = ssaToLLVMChildren.find(Var1) != ssaToLLVMChildren.end();
-  FoundVar2 = ssaToLLVMChildren.find(Var2) != ssaToLLVMChildren.end();
-  if (FoundVar1 != FoundVar2) {
-    return false;
-  }
-  if (FoundVar1 && FoundVar2) {
-    if (ssaToLLVMChildren[Var1].size() != ssaToLLVMChildren[Var2].size()) {
-      return false;
-    }
-  }
-
-  FoundVar1 = ssaToSSAParents.find(Var1) != ssaToSSAParents.end();
-  FoundVar2 = ssaToSSAParents.find(Var2) != ssaToSSAParents.end();
-  if (FoundVar1 != FoundVar2) {
-    return false;
-  }
-  if (FoundVar1 && FoundVar2) {
-    if (ssaToSSAParents[Var1].size() != ssaToSSAParents[Var2].size()) {
-      return false;
-    }
-  }
-
-  FoundVar1 = ssaToLLVMParents.find(Var1) != ssaToLLVMParents.end();
-  FoundVar2 = ssaToLLVMParents.find(Var2) != ssaToLLVMParents.end();
-  if (FoundVar1 != FoundVar2) {
-    return false;
-  }
-  if (FoundVar1 && FoundVar2) {
-    if (ssaToLLVMParents[Var1].size() != ssaToLLVMParents[Var2].size()) {
-      return false;
-    }
-  }
+void DepGraphDCF::getArgumentDependencies(Function const &F,
+                                          ArrayRef<Value const *> Values,
+                                          std::set<int> &ArgNos) const {
+  assert(!DemandDriven && "the parents of the nodes may not be built");
+  // Walk the graph backward from the values. The taint of a taint reset node
+  // doesn't reach its children, the walk doesn't go through it.
+  std::vector<Value const *> LLVMToVisit(Values.begin(), Values.end());
+  std::vector<MSSAVar *> SSAToVisit;
+  DenseSet<Value const *> VisitedLLVM(Values.begin(), Values.end());
+  DenseSet<MSSAVar *> VisitedSSA;
 
-  // Check whether outgoing edges are the same for both nodes.
-  if (ssaToSSAChildren.find(Var1) != ssaToSSAChildren.end()) {
-    for (MSSAVar *V : ssaToSSAChildren[Var1]) {
-      if (ssaToSSAChildren[Var2].find(V) == ssaToSSAChildren[Var2].end()) {
-        return false;
+  auto VisitParents = [&](auto const &ToLLVMParents, auto const &ToSSAParents,
+                          auto *D) {
+    for (Value const *P : getRange(ToLLVMParents, D)) {
+      if (VisitedLLVM.insert(P).second) {
+        LLVMToVisit.push_back(P);
       }
     }
-  }
-  if (ssaToLLVMChildren.find(Var1) != ssaToLLVMChildren.end()) {
-    for (Value const *V : ssaToLLVMChildren[Var1]) {
-      if (ssaToLLVMChildren[Var2].find(V) == ssaToLLVMChildren[Var2].end()) {
-        return false;
+    for (MSSAVar *P : getRange(ToSSAParents, D)) {
+      if (!taintResetSSANodes.count(P) && VisitedSSA.insert(P).second) {
+        SSAToVisit.push_back(P);
       }
     }
-  }
+  };
 
-  // Check whether incoming edges are the same for both nodes.
-  if (ssaToSSAParents.find(Var1) != ssaToSSAParents.end()) {
-    for (MSSAVar *V : ssaToSSAParents[Var1]) {
-      if (ssaToSSAParents[Var2].find(V) == ssaToSSAParents[Var2].end()) {
-        return false;
+  while (!LLVMToVisit.empty() || !SSAToVisit.empty()) {
+    if (!LLVMToVisit.empty()) {
+      Value const *D = LLVMToVisit.back();
+      LLVMToVisit.pop_back();
+      // Beyond the parameters of F are the arguments of its call sites.
+      if (auto const *Arg = dyn_cast<Argument>(D);
+          Arg && Arg->getParent() == &F) {
+        ArgNos.insert(Arg->getArgNo());
+        continue;
       }
+      VisitParents(llvmToLLVMParents, llvmToSSAParents, D);
+      continue;
     }
+
+    MSSAVar *D = SSAToVisit.back();
+    SSAToVisit.pop_back();
+    VisitParents(ssaToLLVMParents, ssaToSSAParents, D);
   }
-  if (ssaToLLVMParents.find(Var1) != ssaToLLVMParents.end()) {
-    for (Value const *V : ssaToLLVMParents[Var1]) {
-      if (ssaToLLVMParents[Var2].find(V) == ssaToLLVMParents[Var2].end()) {
-        return false;
-      }
-    }
+}
+
+bool DepGraphDCF::areSSANodesEquivalent(MSSAVar *Var1, MSSAVar *Var2) const {
+  assert(Var1);
+  assert(Var2);
+
+  if (Var1->def->type == MSSADef::PHI || Var2->def->type == MSSADef::PHI) {
+    return false;
   }
 
-  return true;
+  // Both nodes must have an entry in the same edge maps, with the same edges.
+  auto HaveSameEdges = [Var1, Var2](auto const &Map) {
+    auto It1 = Map.find(Var1);
+    auto It2 = Map.find(Var2);
+    if (It1 == Map.end() || It2 == Map.end()) {
+      return It1 == It2;
+    }
+    return It1->second == It2->second;
+  };
+  return HaveSameEdges(ssaToSSAChildren) && HaveSameEdges(ssaToLLVMChildren) &&
+         HaveSameEdges(ssaToSSAParents) && HaveSameEdges(ssaToLLVMParents);
 }
 
 void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
@@ -1370,12 +1865,12 @@ void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
 
   // Remove links from predicates to PHI
   for (Value const *V : Phi->preds) {
-    removeEdge(V, Phi->var.get());
+    removeEdge(V, Phi->var);
   }
 
   // Remove links from ops to PHI
   for (MSSAVar *Op : Ops) {
-    removeEdge(Op, Phi->var.get());
+    removeEdge(Op, Phi->var);
   }
 
   // For each outgoing edge from PHI to a SSA node N, connect
@@ -1383,10 +1878,10 @@ void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
   {
     std::vector<Ssa2SsaEdge> EdgesToAdd;
     std::vector<Ssa2SsaEdge> EdgesToRemove;
-    if (ssaToSSAChildren.find(Phi->var.get()) != ssaToSSAChildren.end()) {
-      for (MSSAVar *V : ssaToSSAChildren[Phi->var.get()]) {
+    if (ssaToSSAChildren.find(Phi->var) != ssaToSSAChildren.end()) {
+      for (MSSAVar *V : ssaToSSAChildren[Phi->var]) {
         EdgesToAdd.push_back(Ssa2SsaEdge(Ops[0], V));
-        EdgesToRemove.push_back(Ssa2SsaEdge(Phi->var.get(), V));
+        EdgesToRemove.push_back(Ssa2SsaEdge(Phi->var, V));
 
         // If N is a phi replace the phi operand of N with op1
         if (V->def->type == MSSADef::PHI) {
@@ -1394,7 +1889,7 @@ void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
 
           bool Found = false;
           for (auto &Entry : OutPhi->opsVar) {
-            if (Entry.second == Phi->var.get()) {
+            if (Entry.second == Phi->var) {
               Found = true;
               Entry.second = Ops[0];
               break;
@@ -1421,12 +1916,12 @@ void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
 
     // For each outgoing edge from PHI to a LLVM node N, connect
     // connect op1 to N and remove the link from PHI to N.
-    if (ssaToLLVMChildren.find(Phi->var.get()) != ssaToLLVMChildren.end()) {
-      for (Value const *V : ssaToLLVMChildren[Phi->var.get()]) {
+    if (ssaToLLVMChildren.find(Phi->var) != ssaToLLVMChildren.end()) {
+      for (Value const *V : ssaToLLVMChildren[Phi->var]) {
         // addEdge(ops[0], v);
         // removeEdge(phi->var, v);
         EdgesToAdd.push_back(Ssa2LlvmEdge(Ops[0], V));
-        EdgesToRemove.push_back(Ssa2LlvmEdge(Phi->var.get(), V));
+        EdgesToRemove.push_back(Ssa2LlvmEdge(Phi->var, V));
       }
     }
     for (Ssa2LlvmEdge E : EdgesToAdd) {
@@ -1440,7 +1935,7 @@ void DepGraphDCF::eliminatePhi(MSSAPhi *Phi, std::vector<MSSAVar *> Ops) {
   // Remove PHI Node
   Function const *F = Phi->var->bb->getParent();
   assert(F);
-  auto It = funcToSSANodesMap[F].find(Phi->var.get());
+  auto It = funcToSSANodesMap[F].find(Phi->var);
   assert(It != funcToSSANodesMap[F].end());
   funcToSSANodesMap[F].erase(It);
 
@@ -1497,42 +1992,117 @@ void DepGraphDCF::phiElimination() {
   // For each function, iterate through its basic block and try to eliminate phi
   // function until reaching a fixed point.
   for (Function const &F : M) {
-    bool Changed = true;
+    eliminatePhis(F);
+  }
+}
 
-    while (Changed) {
-      Changed = false;
+void DepGraphDCF::eliminatePhis(Function const &F) {
+  // The phis are visited in the order of the blocks, as long as one of them
+  // may be eliminated. A phi which can't be eliminated is only visited again
+  // once its operands or their edges changed, instead of visiting all the
+  // phis again until reaching a fixed point.
+  std::vector<MSSAPhi *> Phis;
+  for (BasicBlock const &BB : F) {
+    for (auto *Phi : getRange(mssa->getBBToPhiMap(), &BB)) {
+      Phis.push_back(Phi);
+    }
+  }
 
-      for (BasicBlock const &BB : F) {
-        for (auto const &Phi : getRange(mssa->getBBToPhiMap(), &BB)) {
+  // The phis using each operand, only indexed once a phi is eliminated.
+  DenseMap<MSSAPhi const *, unsigned> PhiToIndex;
+  DenseMap<MSSAVar *, SmallVector<unsigned, 2>> OpToPhis;
+  auto IndexPhis = [&]() {
+    if (!PhiToIndex.empty()) {
+      return;
+    }
+    for (unsigned I = 0; I < Phis.size(); ++I) {
+      PhiToIndex[Phis[I]] = I;
+      for (auto const &[Index, Op] : Phis[I]->opsVar) {
+        OpToPhis[Op].push_back(I);
+      }
+    }
+  };
 
-          assert(funcToSSANodesMap.find(&F) != funcToSSANodesMap.end());
+  BitVector ToVisit(Phis.size(), true);
+  BitVector Eliminated(Phis.size());
+  auto Revisit = [&](unsigned Index) {
+    if (!Eliminated.test(Index)) {
+      ToVisit.set(Index);
+    }
+  };
 
-          // Has the phi node been removed already ?
-          if (funcToSSANodesMap[&F].count(Phi->var.get()) == 0) {
-            continue;
-          }
+  while (ToVisit.any()) {
+    // The phis marked behind the current one are visited in the next round,
+    // as the previous loop over all the phis did.
+    for (int Idx = ToVisit.find_first(); Idx != -1;
+         Idx = ToVisit.find_next(Idx)) {
+      ToVisit.reset(Idx);
+      MSSAPhi *Phi = Phis[Idx];
 
-          // For each phi we test if its operands (chi) are not PHI and
-          // are equivalent
-          std::vector<MSSAVar *> PhiOperands;
-          for (auto J : Phi->opsVar) {
-            PhiOperands.push_back(J.second);
-          }
+      assert(funcToSSANodesMap.find(&F) != funcToSSANodesMap.end());
 
-          bool CanElim = true;
-          for (unsigned I = 0; I < PhiOperands.size() - 1; I++) {
-            if (!areSSANodesEquivalent(PhiOperands[I], PhiOperands[I + 1])) {
-              CanElim = false;
-              break;
-            }
-          }
-          if (!CanElim) {
-            continue;
+      // Has the phi node been removed already ?
+      if (funcToSSANodesMap[&F].count(Phi->var) == 0) {
+        continue;
+      }
+
+      // For each phi we test if its operands (chi) are not PHI and
+      // are equivalent
+      std::vector<MSSAVar *> PhiOperands;
+      for (auto J : Phi->opsVar) {
+        PhiOperands.push_back(J.second);
+      }
+
+      bool CanElim = true;
+      for (unsigned I = 0; I + 1 < PhiOperands.size(); I++) {
+        if (!areSSANodesEquivalent(PhiOperands[I], PhiOperands[I + 1])) {
+          CanElim = false;
+          break;
+        }
+      }
+      if (!CanElim) {
+        continue;
+      }
+
+      // Collect the nodes whose edges are changed by the elimination, the
+      // operand kept is the first one in the order of eliminatePhi().
+      IndexPhis();
+      MSSAVar *KeptOp = *std::min_element(
+          PhiOperands.begin(), PhiOperands.end(), std::less<MSSAVar *>());
+      SmallVector<MSSAVar *, 8> Changed(PhiOperands.begin(), PhiOperands.end());
+      for (MSSAVar *V : getRange(ssaToSSAChildren, Phi->var)) {
+        Changed.push_back(V);
+        // The operand of the phis using this one is replaced.
+        if (V->def->type == MSSADef::PHI) {
+          auto It = PhiToIndex.find(cast<MSSAPhi>(V->def));
+          if (It != PhiToIndex.end()) {
+            OpToPhis[KeptOp].push_back(It->second);
+            Revisit(It->second);
           }
+        }
+      }
+      for (MSSAVar *Op : PhiOperands) {
+        if (Op == KeptOp) {
+          continue;
+        }
+        for (MSSAVar *V : getRange(ssaToSSAParents, Op)) {
+          Changed.push_back(V);
+        }
+        for (MSSAVar *V : getRange(ssaToSSAChildren, Op)) {
+          Changed.push_back(V);
+        }
+      }
+
+      // PHI Node can be eliminated !
+      eliminatePhi(Phi, PhiOperands);
+      Eliminated.set(Idx);
 
-          // PHI Node can be eliminated !
-          Changed = true;
-          eliminatePhi(Phi.get(), PhiOperands);
+      for (MSSAVar *V : Changed) {
+        auto It = OpToPhis.find(V);
+        if (It != OpToPhis.end()) {
+          for (unsigned Index : It->second) {
+            Revisit(Index);
+          }
         }
       }
     }
@@ -1617,7 +2187,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
       continue;
     }
 
-    if (taintedLLVMNodes.find(P) == taintedLLVMNodes.end()) {
+    if (!isTainted(P)) {
       continue;
     }
 
@@ -1628,7 +2198,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
       continue;
     }
 
-    if (taintedSSANodes.find(P) == taintedSSANodes.end()) {
+    if (!isTainted(P)) {
       continue;
     }
 
@@ -1663,7 +2233,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
           continue;
         }
 
-        if (taintedLLVMNodes.find(P) == taintedLLVMNodes.end()) {
+        if (!isTainted(P)) {
           continue;
         }
 
@@ -1674,7 +2244,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
           continue;
         }
 
-        if (taintedSSANodes.find(P) == taintedSSANodes.end()) {
+        if (!isTainted(P)) {
           continue;
         }
 
@@ -1702,7 +2272,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
           continue;
         }
 
-        if (taintedLLVMNodes.find(P) == taintedLLVMNodes.end()) {
+        if (!isTainted(P)) {
           continue;
         }
 
@@ -1713,7 +2283,7 @@ void DepGraphDCF::dotTaintPath(Value const *V, StringRef Filename,
           continue;
         }
 
-        if (taintedSSANodes.find(P) == taintedSSANodes.end()) {
+        if (!isTainted(P)) {
           continue;
         }
 
@@ -2213,246 +2783,88 @@ bool DepGraphDCF::getDebugTrace(std::vector<DGDebugLoc> &DLs,
 }
 
 void DepGraphDCF::floodFunction(Function const *F) {
-  std::queue<MSSAVar *> VarToVisit;
-  std::queue<Value const *> ValueToVisit;
+  FunctionNodes const &Nodes = getFunctionNodes(F);
+  std::vector<unsigned> ToVisit;
 
   // 1) taint LLVM and SSA sources
-  for (MSSAVar const *S : ssaSources) {
-    if (funcToSSANodesMap.find(F) == funcToSSANodesMap.end()) {
-      continue;
-    }
-
-    if (funcToSSANodesMap[F].find(const_cast<MSSAVar *>(S)) !=
-        funcToSSANodesMap[F].end()) {
-      taintedSSANodes.insert(S);
+  for (unsigned S : ssaSourceIds) {
+    if (Nodes.contains(S)) {
+      taintedNodes.set(S);
     }
   }
 
-  for (Value const *S : valueSources) {
-    Instruction const *Inst = dyn_cast<Instruction>(S);
-    if (!Inst || Inst->getParent()->getParent() != F) {
+  for (unsigned S : valueSourceIds) {
+    if (getNodeFunction(idToLLVMNode[S]) != F) {
       continue;
     }
 
-    taintedLLVMNodes.insert(S);
+    taintedNodes.set(S);
   }
 
   // 2) Add tainted variables of the function to the queue.
-  if (funcToSSANodesMap.find(F) != funcToSSANodesMap.end()) {
-    for (MSSAVar *V : funcToSSANodesMap[F]) {
-      if (taintedSSANodes.find(V) != taintedSSANodes.end()) {
-        VarToVisit.push(V);
-      }
+  Nodes.forEach([&](unsigned V) {
+    if (taintedNodes.test(V)) {
+      ToVisit.push_back(V);
     }
-  }
-  if (funcToLLVMNodesMap.find(F) != funcToLLVMNodesMap.end()) {
-    for (Value const *V : funcToLLVMNodesMap[F]) {
-      if (taintedLLVMNodes.find(V) != taintedLLVMNodes.end()) {
-        ValueToVisit.push(V);
-      }
-    }
-  }
+  });
 
   // 3) flood function
-  while (!VarToVisit.empty() || !ValueToVisit.empty()) {
-    if (!VarToVisit.empty()) {
-      MSSAVar *S = VarToVisit.front();
-      VarToVisit.pop();
-
-      if (taintResetSSANodes.find(S) != taintResetSSANodes.end()) {
-        continue;
-      }
-
-      if (ssaToSSAChildren.find(S) != ssaToSSAChildren.end()) {
-        for (MSSAVar *D : ssaToSSAChildren[S]) {
-          if (funcToSSANodesMap.find(F) == funcToSSANodesMap.end()) {
-            continue;
-          }
-
-          if (funcToSSANodesMap[F].find(D) == funcToSSANodesMap[F].end()) {
-            continue;
-          }
-          if (taintedSSANodes.count(D) != 0) {
-            continue;
-          }
+  while (!ToVisit.empty()) {
+    unsigned S = ToVisit.back();
+    ToVisit.pop_back();
 
-          taintedSSANodes.insert(D);
-          VarToVisit.push(D);
-        }
-      }
-
-      if (ssaToLLVMChildren.find(S) != ssaToLLVMChildren.end()) {
-        for (Value const *D : ssaToLLVMChildren[S]) {
-          if (funcToLLVMNodesMap[F].find(D) == funcToLLVMNodesMap[F].end()) {
-            continue;
-          }
-
-          if (taintedLLVMNodes.count(D) != 0) {
-            continue;
-          }
-
-          taintedLLVMNodes.insert(D);
-          ValueToVisit.push(D);
-        }
-      }
+    if (taintResetNodes.test(S)) {
+      continue;
     }
 
-    if (!ValueToVisit.empty()) {
-      Value const *S = ValueToVisit.front();
-      ValueToVisit.pop();
-
-      if (llvmToLLVMChildren.find(S) != llvmToLLVMChildren.end()) {
-        for (Value const *D : llvmToLLVMChildren[S]) {
-          if (funcToLLVMNodesMap.find(F) == funcToLLVMNodesMap.end()) {
-            continue;
-          }
-
-          if (funcToLLVMNodesMap[F].find(D) == funcToLLVMNodesMap[F].end()) {
-            continue;
-          }
-
-          if (taintedLLVMNodes.count(D) != 0) {
-            continue;
-          }
-
-          taintedLLVMNodes.insert(D);
-          ValueToVisit.push(D);
-        }
+    for (unsigned D : getChildren(S)) {
+      if (taintedNodes.test(D) || !Nodes.contains(D)) {
+        continue;
       }
 
-      if (llvmToSSAChildren.find(S) != llvmToSSAChildren.end()) {
-        for (MSSAVar *D : llvmToSSAChildren[S]) {
-          if (funcToSSANodesMap.find(F) == funcToSSANodesMap.end()) {
-            continue;
-          }
-          if (funcToSSANodesMap[F].find(D) == funcToSSANodesMap[F].end()) {
-            continue;
-          }
-
-          if (taintedSSANodes.count(D) != 0) {
-            continue;
-          }
-          taintedSSANodes.insert(D);
-          VarToVisit.push(D);
-        }
-      }
+      taintedNodes.set(D);
+      ToVisit.push_back(D);
     }
   }
 }
 
 void DepGraphDCF::floodFunctionFromFunction(Function const *To,
                                             Function const *From) {
-  if (funcToSSANodesMap.find(From) != funcToSSANodesMap.end()) {
-    for (MSSAVar *S : funcToSSANodesMap[From]) {
-      if (taintedSSANodes.find(S) == taintedSSANodes.end()) {
-        continue;
-      }
-      if (taintResetSSANodes.find(S) != taintResetSSANodes.end()) {
-        if (ssaToSSAChildren.find(S) != ssaToSSAChildren.end()) {
-          for (MSSAVar *D : ssaToSSAChildren[S]) {
-            if (funcToSSANodesMap.find(To) == funcToSSANodesMap.end()) {
-              continue;
-            }
-            if (funcToSSANodesMap[To].find(D) == funcToSSANodesMap[To].end()) {
-              continue;
-            }
-            taintedSSANodes.erase(D);
-          }
-        }
-
-        if (ssaToLLVMChildren.find(S) != ssaToLLVMChildren.end()) {
-          for (Value const *D : ssaToLLVMChildren[S]) {
-            if (funcToLLVMNodesMap.find(To) == funcToLLVMNodesMap.end()) {
-              continue;
-            }
-
-            if (funcToLLVMNodesMap[To].find(D) ==
-                funcToLLVMNodesMap[To].end()) {
-              continue;
-            }
-            taintedLLVMNodes.erase(D);
-          }
-        }
-
-        continue;
-      }
-
-      if (ssaToSSAChildren.find(S) != ssaToSSAChildren.end()) {
-        for (MSSAVar *D : ssaToSSAChildren[S]) {
-          if (funcToSSANodesMap.find(To) == funcToSSANodesMap.end()) {
-            continue;
-          }
-          if (funcToSSANodesMap[To].find(D) == funcToSSANodesMap[To].end()) {
-            continue;
-          }
-          taintedSSANodes.insert(D);
-        }
-      }
-
-      if (ssaToLLVMChildren.find(S) != ssaToLLVMChildren.end()) {
-        for (Value const *D : ssaToLLVMChildren[S]) {
-          if (funcToLLVMNodesMap.find(To) == funcToLLVMNodesMap.end()) {
-            continue;
-          }
-
-          if (funcToLLVMNodesMap[To].find(D) == funcToLLVMNodesMap[To].end()) {
-            continue;
-          }
-          taintedLLVMNodes.insert(D);
-        }
-      }
+  FunctionNodes const &ToNodes = getFunctionNodes(To);
+  auto FloodChildren = [&](unsigned S) {
+    if (!taintedNodes.test(S)) {
+      return;
     }
-  }
-
-  if (funcToLLVMNodesMap.find(From) != funcToLLVMNodesMap.end()) {
-    for (Value const *S : funcToLLVMNodesMap[From]) {
-      if (taintedLLVMNodes.find(S) == taintedLLVMNodes.end()) {
-        continue;
-      }
-
-      if (llvmToSSAChildren.find(S) != llvmToSSAChildren.end()) {
-        for (MSSAVar *D : llvmToSSAChildren[S]) {
-          if (funcToSSANodesMap.find(To) == funcToSSANodesMap.end()) {
-            continue;
-          }
-          if (funcToSSANodesMap[To].find(D) == funcToSSANodesMap[To].end()) {
-            continue;
-          }
-          taintedSSANodes.insert(D);
-        }
+    // The children of a taint reset node are untainted.
+    bool Tainted = !taintResetNodes.test(S);
+    for (unsigned D : getChildren(S)) {
+      if (ToNodes.contains(D)) {
+        taintedNodes[D] = Tainted;
       }
+    }
+  };
 
-      if (llvmToLLVMChildren.find(S) != llvmToLLVMChildren.end()) {
-        for (Value const *D : llvmToLLVMChildren[S]) {
-          if (funcToLLVMNodesMap.find(To) == funcToLLVMNodesMap.end()) {
-            continue;
-          }
-          if (funcToLLVMNodesMap[To].find(D) == funcToLLVMNodesMap[To].end()) {
-            continue;
-          }
-          taintedLLVMNodes.insert(D);
-        }
-      }
+  // The ssa nodes are processed first: the top-level nodes they untaint don't
+  // propagate their taint.
+  FunctionNodes const &FromNodes = getFunctionNodes(From);
+  FromNodes.forEach([&](unsigned S) {
+    if (isSSANode(S)) {
+      FloodChildren(S);
     }
-  }
+  });
+  FromNodes.forEach([&](unsigned S) {
+    if (!isSSANode(S)) {
+      FloodChildren(S);
+    }
+  });
 }
 
 void DepGraphDCF::resetFunctionTaint(Function const *F) {
   assert(F && CG.isReachableFromEntry(*F));
-  if (funcToSSANodesMap.find(F) != funcToSSANodesMap.end()) {
-    for (MSSAVar *V : funcToSSANodesMap[F]) {
-      if (taintedSSANodes.find(V) != taintedSSANodes.end()) {
-        taintedSSANodes.erase(V);
-      }
-    }
-  }
-
-  if (funcToLLVMNodesMap.find(F) != funcToLLVMNodesMap.end()) {
-    for (Value const *V : funcToLLVMNodesMap[F]) {
-      if (funcToLLVMNodesMap.find(F) != funcToLLVMNodesMap.end()) {
-        taintedLLVMNodes.erase(V);
-      }
-    }
+  FunctionNodes const &Nodes = getFunctionNodes(F);
+  taintedNodes.reset(Nodes.Begin, Nodes.End);
+  for (unsigned V : Nodes.Shared) {
+    taintedNodes.reset(V);
   }
 }
 
@@ -2465,7 +2877,7 @@ void DepGraphDCF::computeFunctionCSTaintedConds(llvm::Function const *F) {
 
       if (callsiteToConds.find(cast<Value>(&I)) != callsiteToConds.end()) {
         for (Value const *V : callsiteToConds[cast<Value>(&I)]) {
-          if (taintedLLVMNodes.find(V) != taintedLLVMNodes.end()) {
+          if (isTainted(V)) {
             // EMMA : if(v->getName() != "cmp1" && v->getName() != "cmp302"){
             taintedConditions.insert(V);
             // errs() << "EMMA: value tainted: " << v->getName() << "\n";
@@ -2477,6 +2889,61 @@ void DepGraphDCF::computeFunctionCSTaintedConds(llvm::Function const *F) {
   }
 }
 
+BitVector DepGraphDCF::getFunctionTaint(FunctionNodes const &Nodes) const {
+  unsigned NumOwned = Nodes.End - Nodes.Begin;
+  BitVector Taint(NumOwned + Nodes.Shared.size());
+  for (int Id = taintedNodes.find_first_in(Nodes.Begin, Nodes.End); Id != -1;
+       Id = taintedNodes.find_first_in(Id + 1, Nodes.End)) {
+    Taint.set(Id - Nodes.Begin);
+  }
+  for (unsigned I = 0; I < Nodes.Shared.size(); I++) {
+    if (taintedNodes.test(Nodes.Shared[I])) {
+      Taint.set(NumOwned + I);
+    }
+  }
+  return Taint;
+}
+
+void DepGraphDCF::setFunctionTaint(FunctionNodes const &Nodes,
+                                   BitVector const &Taint) {
+  unsigned NumOwned = Nodes.End - Nodes.Begin;
+  taintedNodes.reset(Nodes.Begin, Nodes.End);
+  for (int I = Taint.find_first_in(0, NumOwned); I != -1;
+       I = Taint.find_first_in(I + 1, NumOwned)) {
+    taintedNodes.set(Nodes.Begin + I);
+  }
+  for (unsigned I = 0; I < Nodes.Shared.size(); I++) {
+    taintedNodes[Nodes.Shared[I]] = Taint.test(NumOwned + I);
+  }
+}
+
+void DepGraphDCF::floodFunctionWithSummary(Function const *F) {
+  FunctionNodes const &Nodes = getFunctionNodes(F);
+  // An empty bit vector is the empty key of the summary map.
+  if (Nodes.Begin == Nodes.End && Nodes.Shared.empty()) {
+    floodFunction(F);
+    computeFunctionCSTaintedConds(F);
+    return;
+  }
+
+  TaintSummaryMap &Summaries = taintSummaries[F];
+  BitVector In = getFunctionTaint(Nodes);
+  auto It = Summaries.find(In);
+  if (It != Summaries.end()) {
+    // The tainted conditions only depend on the taint of the function, they
+    // were collected when the summary was computed.
+    setFunctionTaint(Nodes, It->second);
+    return;
+  }
+
+  floodFunction(F);
+  computeFunctionCSTaintedConds(F);
+  BitVector Out = getFunctionTaint(Nodes);
+  // Flooding a flooded function doesn't change its taint.
+  Summaries.try_emplace(Out, Out);
+  Summaries.try_emplace(std::move(In), std::move(Out));
+}
+
 void DepGraphDCF::computeTaintedValuesContextSensitive() {
 #ifndef NDEBUG
   unsigned FuncToLlvmNodesMapSize = funcToLLVMNodesMap.size();
@@ -2555,34 +3022,28 @@ void DepGraphDCF::computeTaintedValuesCSForEntry(
         floodFunctionFromFunction(N->getFunction(), Prev);
 
         // errs() << "tainting " << N->getFunction()->getName() << "\n";
-        floodFunction(N->getFunction());
-
         // errs() << "for each call site get PDF+ and save tainted
         // conditions\n";
-        computeFunctionCSTaintedConds(N->getFunction());
+        floodFunctionWithSummary(N->getFunction());
       } else {
         // errs() << "tainting " << N->getFunction()->getName() << " from "
         //   << prev->getName() << "\n";
         floodFunctionFromFunction(N->getFunction(), Prev);
 
         // errs() << "tainting " << N->getFunction()->getName() << "\n";
-        floodFunction(N->getFunction());
-
         // errs() << "for each call site get PDF+ and save tainted
         // conditions\n";
-        computeFunctionCSTaintedConds(N->getFunction());
+        floodFunctionWithSummary(N->getFunction());
 
         // errs() << "untainting " << prev->getName() << "\n";
         resetFunctionTaint(Prev);
       }
     } else {
       // errs() << "tainting " << N->getFunction()->getName() << "\n";
-      floodFunction(N->getFunction());
-
       LLVM_DEBUG(
           dbgs()
           << "for each call site get PDF+ and save tainted conditions\n");
-      computeFunctionCSTaintedConds(N->getFunction());
+      floodFunctionWithSummary(N->getFunction());
     }
 
     // Add first unvisited callee to stack if any
@@ -2618,6 +3079,6 @@ DepGraphDCFAnalysis::run(Module &M, ModuleAnalysisManager &AM) {
   auto &MSSA = AM.getResult<MemorySSAAnalysis>(M);
   auto const &PTACG = AM.getResult<PTACallGraphAnalysis>(M);
   return std::make_unique<DepGraphDCF>(MSSA.get(), *PTACG, FAM, M,
-                                       ContextInsensitive_);
+                                       ContextInsensitive_, DemandDriven_);
 }
 } // namespace parcoach
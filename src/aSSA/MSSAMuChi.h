@@ -4,8 +4,10 @@
 #include "parcoach/MemoryRegion.h"
 
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/Allocator.h"
 
 #include <set>
+#include <tuple>
 #include <vector>
 
 class MSSAVar;
@@ -35,7 +37,7 @@ public:
   virtual std::string getName() const { return region->getName().str(); }
 
   MemRegEntry *region;
-  std::unique_ptr<MSSAVar> var;
+  MSSAVar *var;
   TYPE type;
 };
 
@@ -223,4 +225,23 @@ public:
   static inline bool classof(MSSAMu const *m) { return m->type == RET; }
 };
 
+// Owns the mus, chis, phis and variables of the memory SSA: they are bump
+// allocated, one slab list per type, and all freed with the allocator.
+class MSSAAllocator {
+  template <typename... Ts>
+  using AllocatorsTy = std::tuple<llvm::SpecificBumpPtrAllocator<Ts>...>;
+
+  AllocatorsTy<MSSAVar, MSSAPhi, MSSAExtVarArgChi, MSSAExtArgChi,
+               MSSAExtRetChi, MSSAEntryChi, MSSAStoreChi, MSSASyncChi,
+               MSSACallChi, MSSAExtCallChi, MSSAExtRetCallChi, MSSALoadMu,
+               MSSACallMu, MSSAExtCallMu, MSSARetMu>
+      Allocators;
+
+public:
+  template <typename T, typename... ArgsTy> T *create(ArgsTy &&...Args) {
+    auto &Allocator = std::get<llvm::SpecificBumpPtrAllocator<T>>(Allocators);
+    return new (Allocator.Allocate()) T(std::forward<ArgsTy>(Args)...);
+  }
+};
+
 #endif /* MSSAMUCHI */
@@ -96,11 +96,14 @@ MemReg::MemReg(Module &M, Andersen const &AA) {
 }
 
 void MemReg::createRegion(llvm::Value const *V) {
-  auto [ItEntry, _] =
-      valueToRegMap.insert({V, std::make_unique<MemRegEntry>(V)});
-  auto &Entry = ItEntry->second;
+  auto [ItEntry, Inserted] = valueToRegMap.insert({V, nullptr});
+  if (!Inserted) {
+    return;
+  }
+  auto *Entry = new (regionAllocator.Allocate()) MemRegEntry(V);
+  ItEntry->second = Entry;
   if (Entry->isCudaShared()) {
-    sharedCudaRegions.insert(Entry.get());
+    sharedCudaRegions.insert(Entry);
   }
 }
 
@@ -124,7 +127,7 @@ MemRegEntry *MemReg::getValueRegion(llvm::Value const *V) const {
     return NULL;
   }
 
-  return I->second.get();
+  return I->second;
 }
 
 void MemReg::getValuesRegion(std::vector<Value const *> &PtsSet,
@@ -10,6 +10,9 @@
 
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <atomic>
 
 #define DEBUG_TYPE "mssa"
 
@@ -25,13 +28,131 @@ cl::opt<std::string> OptDumpSsaFunc("dump-ssa-func",
                                              "for a particular function."),
                                     cl::cat(ParcoachCategory));
 
+cl::opt<unsigned> OptMssaThreads(
+    "mssa-threads",
+    cl::desc("Number of threads used to build the memory SSA of the "
+             "functions (0 uses all the cores)"),
+    cl::init(1), cl::cat(ParcoachCategory));
+
 } // namespace
 
+// The memory SSA of a function only depends on the results of the previous
+// analyses, which the builder doesn't modify, so the functions can be built
+// concurrently.
+// The builder keeps the mus, chis and phis it creates in plain maps until they
+// are moved to the MemorySSA: the ValueMaps of the MemorySSA register a value
+// handle in the LLVMContext for each key, which isn't thread-safe. They are
+// allocated by the allocator given to build(), which is only used by one
+// thread at a time.
+class MemorySSA::FunctionBuilder {
+  // Keyed by the external function, then by the call site.
+  using ExtCallSiteToChiMap =
+      std::map<Function const *,
+               std::map<CallBase *, MSSAChi *>>;
+  using ExtCallSiteToArgChiMap =
+      std::map<Function const *,
+               std::map<CallBase *, std::map<unsigned, MSSAChi *>>>;
+
+public:
+  FunctionBuilder(MemorySSA const &MSSA, Function const &F, DominatorTree &DT,
+                  DominanceFrontier &DF, PostDominatorTree &PDT)
+      : PTA(MSSA.PTA), CG(MSSA.CG), Regions(MSSA.Regions), MRA(MSSA.MRA),
+        extInfo(MSSA.extInfo), F(&F), DT(DT), DF(DF), PDT(PDT) {}
+
+  void build(MSSAAllocator &Allocator) {
+    this->Allocator = &Allocator;
+    {
+      TimeTraceScope TTS("parcoach::MemorySSA::ComputeMuChi");
+      computeMuChi();
+    }
+
+    {
+      TimeTraceScope TTS("parcoach::MemorySSA::ComputePhi");
+      computePhi();
+    }
+
+    {
+      TimeTraceScope TTS("parcoach::MemorySSA::Rename");
+      rename();
+    }
+
+    {
+      TimeTraceScope TTS("parcoach::MemorySSA::ComputePhiPredicates");
+      computePhiPredicates();
+    }
+  }
+
+private:
+  Andersen const &PTA;
+  PTACallGraph const &CG;
+  MemReg const &Regions;
+  ModRefAnalysisResult const *MRA;
+  ExtInfo const &extInfo;
+  MSSAAllocator *Allocator{};
+
+  MemRegSet usedRegs;
+  MemRegToBBMap regDefToBBMap;
+
+  void createArtificalChiForCalledFunction(llvm::CallBase *CB,
+                                           llvm::Function const *callee);
+
+  void computeMuChi();
+
+  void computeMuChiForCalledFunction(llvm::CallBase *inst,
+                                     llvm::Function *callee);
+
+  // The three following functions generate SSA from mu/chi by implementing the
+  // algorithm from the paper:
+  // R. Cytron, J. Ferrante, B. K. Rosen, M. N. Wegman, and F. K.
+  // Zadeck, “Efficiently computing static single assignment form and
+  // the control dependence graph,” ACM Trans. Program. Lang. Syst.,
+  // vol. 13, no. 4, pp. 451–490, Oct. 1991.
+  // http://doi.acm.org/10.1145/115372.115320
+  void computePhi();
+  void rename();
+  void renameBB(llvm::BasicBlock const *X, std::map<MemRegEntry *, unsigned> &C,
+                std::map<MemRegEntry *, std::vector<MSSAVar *>> &S);
+
+  void computePhiPredicates();
+  void computeLLVMPhiPredicates(llvm::PHINode const *phi);
+  void computeMSSAPhiPredicates(MSSAPhi *phi);
+
+  static unsigned whichPred(llvm::BasicBlock const *pred,
+                            llvm::BasicBlock const *succ);
+
+public:
+  Function const *F;
+  DominatorTree &DT;
+  DominanceFrontier &DF;
+  PostDominatorTree &PDT;
+
+  // What the builder computes, see the corresponding maps of MemorySSA.
+  DenseMap<LoadInst const *, MuList> loadToMuMap;
+  DenseMap<StoreInst const *, ChiList> storeToChiMap;
+  DenseMap<CallBase const *, MuList> callSiteToMuMap;
+  DenseMap<CallBase *, ChiList> callSiteToChiMap;
+  DenseMap<CallBase *, ChiList> callSiteToSyncChiMap;
+  DenseMap<BasicBlock const *, PhiList> bbToPhiMap;
+  ChiList entryChis;
+  MuList returnMus;
+  std::map<MemRegEntry *, MSSAChi *> regToEntryChiMap;
+  std::map<MemRegEntry *, MSSAMu *> regToReturnMuMap;
+  DenseMap<PHINode const *, ValueSet> llvmPhiToPredMap;
+  DenseMap<CallBase *, ChiList> extCallSiteToCallerRetChi;
+  // The external functions are shared by all the functions, these maps only
+  // hold the call sites of the function being built.
+  ExtCallSiteToChiMap extCallSiteToCalleeRetChi;
+  ExtCallSiteToChiMap extCallSiteToVarArgEntryChi;
+  ExtCallSiteToChiMap extCallSiteToVarArgExitChi;
+  ExtCallSiteToArgChiMap extCallSiteToArgEntryChi;
+  ExtCallSiteToArgChiMap extCallSiteToArgExitChi;
+  std::map<Function const *, std::set<CallBase *>> extFuncToCSMap;
+};
+
 MemorySSA::MemorySSA(Module &M, Andersen const &PTA, PTACallGraph const &CG,
                      MemReg const &Regions, ModRefAnalysisResult *MRA,
                      ExtInfo const &ExtInfo, ModuleAnalysisManager &AM)
-    : PTA(PTA), CG(CG), Regions(Regions), MRA(MRA), extInfo(ExtInfo),
-      curDF(NULL), curDT(NULL) {
+    : PTA(PTA), CG(CG), Regions(Regions), MRA(MRA), extInfo(ExtInfo) {
   buildSSA(M, AM);
 }
 
@@ -41,6 +162,9 @@ void MemorySSA::buildSSA(llvm::Module &M, llvm::ModuleAnalysisManager &AM) {
   TimeTraceScope TTS("MemorySSA");
   // Get an inner FunctionAnalysisManager from the module one.
   auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  // The analysis manager isn't thread-safe, the dominance information of all
+  // the functions is computed before building any of them.
+  std::vector<std::unique_ptr<FunctionBuilder>> Builders;
   for (Function &F : M) {
     if (!CG.isReachableFromEntry(F)) {
       // errs() << F.getName() << " is not reachable from entry\n";
@@ -56,52 +180,113 @@ void MemorySSA::buildSSA(llvm::Module &M, llvm::ModuleAnalysisManager &AM) {
       continue;
     }
 
-    // errs() << " + Fun: " << counter << " - " << F.getName() << "\n";
     DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
     DominanceFrontier &DF = FAM.getResult<DominanceFrontierAnalysis>(F);
     PostDominatorTree &PDT = FAM.getResult<PostDominatorTreeAnalysis>(F);
+    Builders.emplace_back(
+        std::make_unique<FunctionBuilder>(*this, F, DT, DF, PDT));
+  }
 
-    buildSSA(&F, DT, DF, PDT);
+  auto AddFunction = [this](std::unique_ptr<FunctionBuilder> &Builder) {
+    Function const *F = Builder->F;
+    addFunction(*Builder);
+    Builder.reset();
     if (OptDumpSsa) {
-      dumpMSSA(&F);
+      dumpMSSA(F);
     }
-    if (F.getName().equals(OptDumpSsaFunc)) {
-      dumpMSSA(&F);
+    if (F->getName().equals(OptDumpSsaFunc)) {
+      dumpMSSA(F);
     }
+  };
+
+  if (OptMssaThreads == 1) {
+    auto &Allocator =
+        *Allocators.emplace_back(std::make_unique<MSSAAllocator>());
+    for (auto &Builder : Builders) {
+      Builder->build(Allocator);
+      AddFunction(Builder);
+    }
+    return;
   }
-}
-
-void MemorySSA::buildSSA(Function const *F, DominatorTree &DT,
-                         DominanceFrontier &DF, PostDominatorTree &PDT) {
-  curDF = &DF;
-  curDT = &DT;
-  curPDT = &PDT;
-
-  usedRegs.clear();
-  regDefToBBMap.clear();
 
-  {
-    TimeTraceScope TTS("parcoach::MemorySSA::ComputeMuChi");
-    computeMuChi(F);
+  // Each task builds the next functions until there are none left, with its
+  // own allocator.
+  ThreadPool Pool(hardware_concurrency(OptMssaThreads));
+  std::atomic<size_t> NextBuilder{};
+  for (unsigned I = 0; I < Pool.getThreadCount(); I++) {
+    MSSAAllocator *Allocator =
+        Allocators.emplace_back(std::make_unique<MSSAAllocator>()).get();
+    Pool.async([&Builders, &NextBuilder, Allocator]() {
+      for (size_t Idx = NextBuilder++; Idx < Builders.size();
+           Idx = NextBuilder++) {
+        Builders[Idx]->build(*Allocator);
+      }
+    });
   }
-
-  {
-    TimeTraceScope TTS("parcoach::MemorySSA::ComputePhi");
-    computePhi(F);
+  Pool.wait();
+  // Add the functions in the module order, as the sequential build does.
+  for (auto &Builder : Builders) {
+    AddFunction(Builder);
   }
+}
 
-  {
-    TimeTraceScope TTS("parcoach::MemorySSA::Rename");
-    rename(F);
+void MemorySSA::addFunction(FunctionBuilder &Builder) {
+  Function const *F = Builder.F;
+  for (auto &[LI, Mus] : Builder.loadToMuMap) {
+    loadToMuMap[LI] = std::move(Mus);
   }
-
-  {
-    TimeTraceScope TTS("parcoach::MemorySSA::ComputePhiPredicates");
-    computePhiPredicates(F);
+  for (auto &[SI, Chis] : Builder.storeToChiMap) {
+    storeToChiMap[SI] = std::move(Chis);
+  }
+  for (auto &[CB, Mus] : Builder.callSiteToMuMap) {
+    callSiteToMuMap[CB] = std::move(Mus);
+  }
+  for (auto &[CB, Chis] : Builder.callSiteToChiMap) {
+    callSiteToChiMap[CB] = std::move(Chis);
+  }
+  for (auto &[CB, Chis] : Builder.callSiteToSyncChiMap) {
+    callSiteToSyncChiMap[CB] = std::move(Chis);
+  }
+  for (auto &[BB, Phis] : Builder.bbToPhiMap) {
+    bbToPhiMap[BB] = std::move(Phis);
+  }
+  funToEntryChiMap[F] = std::move(Builder.entryChis);
+  funToReturnMuMap[F] = std::move(Builder.returnMus);
+  // The DepGraph expects a function to have these maps as soon as it has an
+  // entry chi or a return mu.
+  if (!Builder.regToEntryChiMap.empty()) {
+    funRegToEntryChiMap[F] = std::move(Builder.regToEntryChiMap);
+  }
+  if (!Builder.regToReturnMuMap.empty()) {
+    funRegToReturnMuMap[F] = std::move(Builder.regToReturnMuMap);
+  }
+  for (auto &[Phi, Preds] : Builder.llvmPhiToPredMap) {
+    llvmPhiToPredMap[Phi] = std::move(Preds);
+  }
+  for (auto &[CB, Chis] : Builder.extCallSiteToCallerRetChi) {
+    extCallSiteToCallerRetChi[CB] = std::move(Chis);
+  }
+  auto AddExtCallSites = [](auto &To, auto &From) {
+    for (auto &[Callee, CallSites] : From) {
+      auto &ToCallSites = To[Callee];
+      for (auto &[CB, Chi] : CallSites) {
+        ToCallSites[CB] = Chi;
+      }
+    }
+  };
+  AddExtCallSites(extCallSiteToCalleeRetChi, Builder.extCallSiteToCalleeRetChi);
+  AddExtCallSites(extCallSiteToVarArgEntryChi,
+                  Builder.extCallSiteToVarArgEntryChi);
+  AddExtCallSites(extCallSiteToVarArgExitChi,
+                  Builder.extCallSiteToVarArgExitChi);
+  AddExtCallSites(extCallSiteToArgEntryChi, Builder.extCallSiteToArgEntryChi);
+  AddExtCallSites(extCallSiteToArgExitChi, Builder.extCallSiteToArgExitChi);
+  for (auto &[Callee, CallSites] : Builder.extFuncToCSMap) {
+    extFuncToCSMap[Callee].insert(CallSites.begin(), CallSites.end());
   }
 }
 
-void MemorySSA::computeMuChi(Function const *F) {
+void MemorySSA::FunctionBuilder::computeMuChi() {
   for (auto I = inst_begin(F), E = inst_end(F); I != E; ++I) {
     Instruction const *Inst = &*I;
 
@@ -163,7 +348,7 @@ void MemorySSA::computeMuChi(Function const *F) {
           continue;
         }
 
-        loadToMuMap[LI].emplace_back(std::make_unique<MSSALoadMu>(R, LI));
+        loadToMuMap[LI].emplace_back(Allocator->create<MSSALoadMu>(R, LI));
         usedRegs.insert(R);
       }
 
@@ -190,7 +375,7 @@ void MemorySSA::computeMuChi(Function const *F) {
           continue;
         }
 
-        storeToChiMap[SI].emplace_back(std::make_unique<MSSAStoreChi>(R, SI));
+        storeToChiMap[SI].emplace_back(Allocator->create<MSSAStoreChi>(R, SI));
         usedRegs.insert(R);
         regDefToBBMap[R].insert(Inst->getParent());
       }
@@ -203,24 +388,22 @@ void MemorySSA::computeMuChi(Function const *F) {
    * function.
    */
   for (auto *R : usedRegs) {
-    auto &Chi =
-        funToEntryChiMap[F].emplace_back(std::make_unique<MSSAEntryChi>(R, F));
+    auto *Chi = entryChis.emplace_back(Allocator->create<MSSAEntryChi>(R, F));
 
-    funRegToEntryChiMap[F][Chi->region] = Chi.get();
+    regToEntryChiMap[Chi->region] = Chi;
     regDefToBBMap[R].insert(&F->getEntryBlock());
   }
 
   if (!functionDoesNotRet(F)) {
     for (auto *R : usedRegs) {
-      auto &Mu =
-          funToReturnMuMap[F].emplace_back(std::make_unique<MSSARetMu>(R, F));
-      funRegToReturnMuMap[F][Mu->region] = Mu.get();
+      auto *Mu = returnMus.emplace_back(Allocator->create<MSSARetMu>(R, F));
+      regToReturnMuMap[Mu->region] = Mu;
     }
   }
 }
 
-void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
-                                              Function *Callee) {
+void MemorySSA::FunctionBuilder::computeMuChiForCalledFunction(
+    CallBase *Inst, Function *Callee) {
 #if defined(PARCOACH_ENABLE_CUDA) || defined(PARCOACH_ENABLE_OPENMP)
   Collective const *Coll = Collective::find(*Callee);
 #endif
@@ -228,11 +411,11 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
   // If the called function is a CUDA synchronization, create an artificial CHI
   // for each shared region.
   if (Coll && isa<CudaCollective>(Coll) && Coll->Name == "llvm.nvvm.barrier0") {
-    for (auto *r : Regions.getCudaSharedRegions()) {
-      callSiteToSyncChiMap[inst].emplace(
-          std::make_unique<MSSASyncChi>(r, inst));
-      regDefToBBMap[r].insert(inst->getParent());
-      usedRegs.insert(r);
+    for (auto *R : Regions.getCudaSharedRegions()) {
+      callSiteToSyncChiMap[Inst].emplace_back(
+          Allocator->create<MSSASyncChi>(R, Inst));
+      regDefToBBMap[R].insert(Inst->getParent());
+      usedRegs.insert(R);
     }
     // NOTE (PV): I removed a return here because we want each arg of the
     // barrier to go through the muchi parameters thingy!
@@ -248,7 +431,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
     for (auto *R :
          getRange(Regions.getOmpSharedRegions(), Inst->getFunction())) {
       callSiteToSyncChiMap[Inst].emplace_back(
-          std::make_unique<MSSASyncChi>(R, Inst));
+          Allocator->create<MSSASyncChi>(R, Inst));
       regDefToBBMap[R].insert(Inst->getParent());
       usedRegs.insert(R);
     }
@@ -276,15 +459,11 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
       }
 
       // Case where argument is a inttoptr cast (e.g. MPI_IN_PLACE)
+      // NOTE: don't materialize the expression as an instruction to check
+      // this, it would add uses to the constants shared by all the functions.
       ConstantExpr *Ce = dyn_cast<ConstantExpr>(Arg);
-      if (Ce) {
-        Instruction *Inst = Ce->getAsInstruction();
-        assert(Inst);
-        bool IsAIntToPtr = isa<IntToPtrInst>(Inst);
-        Inst->deleteValue();
-        if (IsAIntToPtr) {
-          continue;
-        }
+      if (Ce && Ce->getOpcode() == Instruction::IntToPtr) {
+        continue;
       }
 
       std::vector<Value const *> PtsSet;
@@ -306,7 +485,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
         }
 
         callSiteToMuMap[Inst].emplace_back(
-            std::make_unique<MSSAExtCallMu>(R, Callee, I));
+            Allocator->create<MSSAExtCallMu>(R, Callee, I));
         usedRegs.insert(R);
       }
 
@@ -324,7 +503,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
             }
 
             callSiteToChiMap[Inst].emplace_back(
-                std::make_unique<MSSAExtCallChi>(R, Callee, I, Inst));
+                Allocator->create<MSSAExtCallChi>(R, Callee, I, Inst));
             regDefToBBMap[R].insert(Inst->getParent());
           }
         }
@@ -336,7 +515,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
             }
 
             callSiteToChiMap[Inst].emplace_back(
-                std::make_unique<MSSAExtCallChi>(R, Callee, I, Inst));
+                Allocator->create<MSSAExtCallChi>(R, Callee, I, Inst));
             regDefToBBMap[R].insert(Inst->getParent());
           }
         }
@@ -361,7 +540,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
         }
 
         extCallSiteToCallerRetChi[Inst].emplace_back(
-            std::make_unique<MSSAExtRetCallChi>(R, Callee));
+            Allocator->create<MSSAExtRetCallChi>(R, Callee));
         regDefToBBMap[R].insert(Inst->getParent());
         usedRegs.insert(R);
       }
@@ -378,7 +557,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
     for (auto *R : MRA->getFuncRef(Callee)) {
       if (KillSet.find(R) == KillSet.end()) {
         callSiteToMuMap[Inst].emplace_back(
-            std::make_unique<MSSACallMu>(R, Callee));
+            Allocator->create<MSSACallMu>(R, Callee));
         usedRegs.insert(R);
       }
     }
@@ -387,7 +566,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
     for (auto *R : MRA->getFuncMod(Callee)) {
       if (KillSet.find(R) == KillSet.end()) {
         callSiteToChiMap[Inst].emplace_back(
-            std::make_unique<MSSACallChi>(R, Callee, Inst));
+            Allocator->create<MSSACallChi>(R, Callee, Inst));
         regDefToBBMap[R].insert(Inst->getParent());
         usedRegs.insert(R);
       }
@@ -395,7 +574,7 @@ void MemorySSA::computeMuChiForCalledFunction(CallBase *Inst,
   }
 }
 
-void MemorySSA::computePhi(Function const *F) {
+void MemorySSA::FunctionBuilder::computePhi() {
   // For each memory region used, compute basic blocks where phi must be
   // inserted.
   for (auto *R : usedRegs) {
@@ -412,8 +591,8 @@ void MemorySSA::computePhi(Function const *F) {
       BasicBlock const *X = Worklist.back();
       Worklist.pop_back();
 
-      auto It = curDF->find(const_cast<BasicBlock *>(X));
-      if (It == curDF->end()) {
+      auto It = DF.find(const_cast<BasicBlock *>(X));
+      if (It == DF.end()) {
         errs() << "Error: basic block not in the dom frontier !\n";
         exit(EXIT_FAILURE);
         continue;
@@ -425,7 +604,7 @@ void MemorySSA::computePhi(Function const *F) {
           continue;
         }
 
-        bbToPhiMap[Y].emplace_back(std::make_unique<MSSAPhi>(R));
+        bbToPhiMap[Y].emplace_back(Allocator->create<MSSAPhi>(R));
         DomFronPlus.insert(Y);
 
         if (Work.find(Y) != Work.end()) {
@@ -439,7 +618,7 @@ void MemorySSA::computePhi(Function const *F) {
   }
 }
 
-void MemorySSA::rename(Function const *F) {
+void MemorySSA::FunctionBuilder::rename() {
   std::map<MemRegEntry *, unsigned> C;
   std::map<MemRegEntry *, std::vector<MSSAVar *>> S;
 
@@ -451,25 +630,25 @@ void MemorySSA::rename(Function const *F) {
   }
 
   // Compute LHS version for each region.
-  for (auto &Chi : funToEntryChiMap[F]) {
-    Chi->var = std::make_unique<MSSAVar>(Chi.get(), 0, &F->getEntryBlock());
+  for (auto *Chi : entryChis) {
+    Chi->var = Allocator->create<MSSAVar>(Chi, 0, &F->getEntryBlock());
 
-    S[Chi->region].push_back(Chi->var.get());
+    S[Chi->region].push_back(Chi->var);
     C[Chi->region]++;
   }
 
-  renameBB(F, &F->getEntryBlock(), C, S);
+  renameBB(&F->getEntryBlock(), C, S);
 }
 
-void MemorySSA::renameBB(Function const *F, llvm::BasicBlock const *X,
-                         std::map<MemRegEntry *, unsigned> &C,
-                         std::map<MemRegEntry *, std::vector<MSSAVar *>> &S) {
+void MemorySSA::FunctionBuilder::renameBB(
+    llvm::BasicBlock const *X, std::map<MemRegEntry *, unsigned> &C,
+    std::map<MemRegEntry *, std::vector<MSSAVar *>> &S) {
   // Compute LHS for PHI
-  for (auto &Phi : bbToPhiMap[X]) {
+  for (auto *Phi : bbToPhiMap[X]) {
     auto *V = Phi->region;
     unsigned I = C[V];
-    Phi->var = std::make_unique<MSSAVar>(Phi.get(), I, X);
-    S[V].push_back(Phi->var.get());
+    Phi->var = Allocator->create<MSSAVar>(Phi, I, X);
+    S[V].push_back(Phi->var);
     C[V]++;
   }
 
@@ -487,59 +666,59 @@ void MemorySSA::renameBB(Function const *F, llvm::BasicBlock const *X,
     if (isCallSite(Inst)) {
       CallBase *Cs(const_cast<CallBase *>(cast<CallBase>(Inst)));
 
-      for (auto &Mu : callSiteToMuMap[Cs]) {
+      for (auto *Mu : callSiteToMuMap[Cs]) {
         Mu->var = S[Mu->region].back();
       }
 
-      for (auto &Chi : callSiteToSyncChiMap[Cs]) {
+      for (auto *Chi : callSiteToSyncChiMap[Cs]) {
         auto *V = Chi->region;
         unsigned I = C[V];
-        Chi->var = std::make_unique<MSSAVar>(Chi.get(), I, Inst->getParent());
+        Chi->var = Allocator->create<MSSAVar>(Chi, I, Inst->getParent());
         Chi->opVar = S[V].back();
-        S[V].push_back(Chi->var.get());
+        S[V].push_back(Chi->var);
         C[V]++;
       }
 
-      for (auto &Chi : callSiteToChiMap[Cs]) {
+      for (auto *Chi : callSiteToChiMap[Cs]) {
         auto *V = Chi->region;
         unsigned I = C[V];
-        Chi->var = std::make_unique<MSSAVar>(Chi.get(), I, Inst->getParent());
+        Chi->var = Allocator->create<MSSAVar>(Chi, I, Inst->getParent());
         Chi->opVar = S[V].back();
-        S[V].push_back(Chi->var.get());
+        S[V].push_back(Chi->var);
         C[V]++;
       }
 
-      for (auto &Chi : extCallSiteToCallerRetChi[Cs]) {
+      for (auto *Chi : extCallSiteToCallerRetChi[Cs]) {
         auto *V = Chi->region;
         unsigned I = C[V];
-        Chi->var = std::make_unique<MSSAVar>(Chi.get(), I, Inst->getParent());
+        Chi->var = Allocator->create<MSSAVar>(Chi, I, Inst->getParent());
         Chi->opVar = S[V].back();
-        S[V].push_back(Chi->var.get());
+        S[V].push_back(Chi->var);
         C[V]++;
       }
     }
 
     if (isa<StoreInst>(Inst)) {
       StoreInst const *SI = cast<StoreInst>(Inst);
-      for (auto &Chi : storeToChiMap[SI]) {
+      for (auto *Chi : storeToChiMap[SI]) {
         auto *V = Chi->region;
         unsigned I = C[V];
-        Chi->var = std::make_unique<MSSAVar>(Chi.get(), I, Inst->getParent());
+        Chi->var = Allocator->create<MSSAVar>(Chi, I, Inst->getParent());
         Chi->opVar = S[V].back();
-        S[V].push_back(Chi->var.get());
+        S[V].push_back(Chi->var);
         C[V]++;
       }
     }
 
     if (isa<LoadInst>(Inst)) {
       LoadInst const *LI = cast<LoadInst>(Inst);
-      for (auto &Mu : loadToMuMap[LI]) {
+      for (auto *Mu : loadToMuMap[LI]) {
         Mu->var = S[Mu->region].back();
       }
     }
 
     if (isa<ReturnInst>(Inst)) {
-      for (auto &Mu : funToReturnMuMap[F]) {
+      for (auto *Mu : returnMus) {
         Mu->var = S[Mu->region].back();
       }
     }
@@ -550,23 +729,23 @@ void MemorySSA::renameBB(Function const *F, llvm::BasicBlock const *X,
   //     Replace operands V by Vi  where i = Top(S(V))
   for (auto I = succ_begin(X), E = succ_end(X); I != E; ++I) {
     BasicBlock const *Y = *I;
-    for (auto &Phi : bbToPhiMap[Y]) {
+    for (auto *Phi : bbToPhiMap[Y]) {
       unsigned Index = whichPred(X, Y);
       Phi->opsVar[Index] = S[Phi->region].back();
     }
   }
 
   // For each successor of X in the dominator tree
-  DomTreeNode *DTnode = curDT->getNode(const_cast<BasicBlock *>(X));
+  DomTreeNode *DTnode = DT.getNode(const_cast<BasicBlock *>(X));
   assert(DTnode);
   for (auto I = DTnode->begin(), E = DTnode->end(); I != E; ++I) {
     BasicBlock const *Y = (*I)->getBlock();
-    renameBB(F, Y, C, S);
+    renameBB(Y, C, S);
   }
 
   // For each assignment of A in X
   //   pop(S(A))
-  for (auto &Phi : bbToPhiMap[X]) {
+  for (auto *Phi : bbToPhiMap[X]) {
     auto *V = Phi->region;
     S[V].pop_back();
   }
@@ -576,24 +755,24 @@ void MemorySSA::renameBB(Function const *F, llvm::BasicBlock const *X,
     if (isa<CallInst>(Inst)) {
       CallBase *Cs(const_cast<CallBase *>(cast<CallBase>(Inst)));
 
-      for (auto &Chi : callSiteToSyncChiMap[Cs]) {
+      for (auto *Chi : callSiteToSyncChiMap[Cs]) {
         auto *V = Chi->region;
         S[V].pop_back();
       }
 
-      for (auto &Chi : callSiteToChiMap[Cs]) {
+      for (auto *Chi : callSiteToChiMap[Cs]) {
         auto *V = Chi->region;
         S[V].pop_back();
       }
 
-      for (auto &Chi : extCallSiteToCallerRetChi[Cs]) {
+      for (auto *Chi : extCallSiteToCallerRetChi[Cs]) {
         auto *V = Chi->region;
         S[V].pop_back();
       }
     }
 
     if (auto const *SI = dyn_cast<StoreInst>(Inst)) {
-      for (auto &Chi : storeToChiMap[SI]) {
+      for (auto *Chi : storeToChiMap[SI]) {
         auto *V = Chi->region;
         S[V].pop_back();
       }
@@ -601,12 +780,12 @@ void MemorySSA::renameBB(Function const *F, llvm::BasicBlock const *X,
   }
 }
 
-void MemorySSA::computePhiPredicates(llvm::Function const *F) {
+void MemorySSA::FunctionBuilder::computePhiPredicates() {
   ValueSet Preds;
 
   for (BasicBlock const &BB : *F) {
-    for (auto &Phi : bbToPhiMap[&BB]) {
-      computeMSSAPhiPredicates(Phi.get());
+    for (auto *Phi : bbToPhiMap[&BB]) {
+      computeMSSAPhiPredicates(Phi);
     }
 
     for (Instruction const &Inst : BB) {
@@ -619,12 +798,13 @@ void MemorySSA::computePhiPredicates(llvm::Function const *F) {
   }
 }
 
-void MemorySSA::computeLLVMPhiPredicates(llvm::PHINode const *Phi) {
+void MemorySSA::FunctionBuilder::computeLLVMPhiPredicates(
+    llvm::PHINode const *Phi) {
   // For each argument of the PHINode
   for (unsigned I = 0; I < Phi->getNumIncomingValues(); ++I) {
     // Get IPDF
     std::vector<BasicBlock *> IPDF =
-        iterated_postdominance_frontier(*curPDT, Phi->getIncomingBlock(I));
+        iterated_postdominance_frontier(PDT, Phi->getIncomingBlock(I));
 
     for (unsigned N = 0; N < IPDF.size(); ++N) {
       // Push conditions of each BB in the IPDF
@@ -652,13 +832,13 @@ void MemorySSA::computeLLVMPhiPredicates(llvm::PHINode const *Phi) {
   }
 }
 
-void MemorySSA::computeMSSAPhiPredicates(MSSAPhi *Phi) {
+void MemorySSA::FunctionBuilder::computeMSSAPhiPredicates(MSSAPhi *Phi) {
   // For each argument of the PHINode
   for (auto I : Phi->opsVar) {
     MSSAVar *Op = I.second;
     // Get IPDF
     std::vector<BasicBlock *> IPDF = iterated_postdominance_frontier(
-        *curPDT, const_cast<BasicBlock *>(Op->bb));
+        PDT, const_cast<BasicBlock *>(Op->bb));
 
     for (unsigned N = 0; N < IPDF.size(); ++N) {
       // Push conditions of each BB in the IPDF
@@ -686,7 +866,8 @@ void MemorySSA::computeMSSAPhiPredicates(MSSAPhi *Phi) {
   }
 }
 
-unsigned MemorySSA::whichPred(BasicBlock const *Pred, BasicBlock const *Succ) {
+unsigned MemorySSA::FunctionBuilder::whichPred(BasicBlock const *Pred,
+                                               BasicBlock const *Succ) {
   unsigned Index = 0;
   for (auto I = pred_begin(Succ), E = pred_end(Succ); I != E; ++I, ++Index) {
     if (Pred == *I) {
@@ -697,6 +878,58 @@ unsigned MemorySSA::whichPred(BasicBlock const *Pred, BasicBlock const *Succ) {
   return Index;
 }
 
+void MemorySSA::FunctionBuilder::createArtificalChiForCalledFunction(
+    llvm::CallBase *CB, llvm::Function const *Callee) {
+  // Not sure if we need mod/ref info here, we can just create entry/exit chi
+  // for each pointer arguments and then only connect the exit/return chis of
+  // modified arguments in the dep graph.
+
+  // If it is a var arg function, create artificial entry and exit chi for the
+  // var arg.
+  if (Callee->isVarArg()) {
+    auto [ItEntry, _] = extCallSiteToVarArgEntryChi[Callee].emplace(
+        CB, Allocator->create<MSSAExtVarArgChi>(Callee));
+    auto *EntryChi = ItEntry->second;
+    EntryChi->var = Allocator->create<MSSAVar>(EntryChi, 0, nullptr);
+
+    auto [ItOut, __] = extCallSiteToVarArgExitChi[Callee].emplace(
+        CB, Allocator->create<MSSAExtVarArgChi>(Callee));
+    auto *OutChi = ItOut->second;
+    OutChi->var = Allocator->create<MSSAVar>(EntryChi, 1, nullptr);
+    OutChi->opVar = EntryChi->var;
+  }
+
+  // Create artifical entry and exit chi for each pointer argument.
+  unsigned ArgId = 0;
+  for (Argument const &Arg : Callee->args()) {
+    if (!Arg.getType()->isPointerTy()) {
+      ArgId++;
+      continue;
+    }
+
+    auto [ItEntry, _] = extCallSiteToArgEntryChi[Callee][CB].emplace(
+        ArgId, Allocator->create<MSSAExtArgChi>(Callee, ArgId));
+    auto *EntryChi = ItEntry->second;
+    EntryChi->var = Allocator->create<MSSAVar>(EntryChi, 0, nullptr);
+
+    auto [ItOut, __] = extCallSiteToArgExitChi[Callee][CB].emplace(
+        ArgId, Allocator->create<MSSAExtArgChi>(Callee, ArgId));
+    auto *ExitChi = ItOut->second;
+    ExitChi->var = Allocator->create<MSSAVar>(ExitChi, 1, nullptr);
+    ExitChi->opVar = EntryChi->var;
+
+    ArgId++;
+  }
+
+  // Create artifical chi for return value if it is a pointer.
+  if (Callee->getReturnType()->isPointerTy()) {
+    auto [ItRet, _] = extCallSiteToCalleeRetChi[Callee].emplace(
+        CB, Allocator->create<MSSAExtRetChi>(Callee));
+    auto *RetChi = ItRet->second;
+    RetChi->var = Allocator->create<MSSAVar>(RetChi, 0, nullptr);
+  }
+}
+
 void MemorySSA::dumpMSSA(llvm::Function const *F) {
   std::string Filename = F->getName().str();
   Filename.append("-assa.ll");
@@ -713,7 +946,7 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
   Stream << ") {\n";
 
   // Dump entry chi
-  for (auto &Chi : funToEntryChiMap[F]) {
+  for (auto *Chi : funToEntryChiMap[F]) {
     Stream << Chi->region->getName() << Chi->var->version << "\n";
   }
 
@@ -724,7 +957,7 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
     Stream << BB.getName().str() << ":\n";
 
     // Phi functions
-    for (auto &Phi : bbToPhiMap[&BB]) {
+    for (auto *Phi : bbToPhiMap[&BB]) {
       Stream << Phi->region->getName() << Phi->var->version << " = phi( ";
       for (auto I : Phi->opsVar) {
         Stream << Phi->region->getName() << I.second->version << ", ";
@@ -755,7 +988,7 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
       if (LoadInst const *LI = dyn_cast<LoadInst>(&Inst)) {
         Stream << getValueLabel(LI) << " = mu(";
 
-        for (auto &Mu : loadToMuMap[LI]) {
+        for (auto *Mu : loadToMuMap[LI]) {
           Stream << Mu->region->getName() << Mu->var->version << ", ";
         }
 
@@ -765,7 +998,7 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
 
       // Store inst
       if (auto const *SI = dyn_cast<StoreInst>(&Inst)) {
-        for (auto &Chi : storeToChiMap[SI]) {
+        for (auto *Chi : storeToChiMap[SI]) {
           Stream << Chi->region->getName() << Chi->var->version << " = X("
                  << Chi->region->getName() << Chi->opVar->version << ", "
                  << getValueLabel(SI->getValueOperand()) << ", "
@@ -782,24 +1015,24 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
 
         CallInst *Cs(const_cast<CallInst *>(CI));
         Stream << *CI << "\n";
-        for (auto &Mu : callSiteToMuMap[Cs]) {
+        for (auto *Mu : callSiteToMuMap[Cs]) {
           Stream << "  mu(" << Mu->region->getName() << Mu->var->version
                  << ")\n";
         }
 
-        for (auto &Chi : callSiteToChiMap[Cs]) {
+        for (auto *Chi : callSiteToChiMap[Cs]) {
           Stream << Chi->region->getName() << Chi->var->version << " = "
                  << "  X(" << Chi->region->getName() << Chi->opVar->version
                  << ")\n";
         }
 
-        for (auto &Chi : callSiteToSyncChiMap[Cs]) {
+        for (auto *Chi : callSiteToSyncChiMap[Cs]) {
           Stream << Chi->region->getName() << Chi->var->version << " = "
                  << "  X(" << Chi->region->getName() << Chi->opVar->version
                  << ")\n";
         }
 
-        for (auto &Chi : extCallSiteToCallerRetChi[Cs]) {
+        for (auto *Chi : extCallSiteToCallerRetChi[Cs]) {
           Stream << Chi->region->getName() << Chi->var->version << " = "
                  << "  X(" << Chi->region->getName() << Chi->opVar->version
                  << ")\n";
@@ -812,73 +1045,13 @@ void MemorySSA::dumpMSSA(llvm::Function const *F) {
   }
 
   // Dump return mu
-  for (auto &Mu : funToReturnMuMap[F]) {
+  for (auto *Mu : funToReturnMuMap[F]) {
     Stream << "  mu(" << Mu->region->getName() << Mu->var->version << ")\n";
   }
 
   Stream << "}\n";
 }
 
-void MemorySSA::createArtificalChiForCalledFunction(
-    llvm::CallBase *CB, llvm::Function const *Callee) {
-  // Not sure if we need mod/ref info here, we can just create entry/exit chi
-  // for each pointer arguments and then only connect the exit/return chis of
-  // modified arguments in the dep graph.
-
-  // If it is a var arg function, create artificial entry and exit chi for the
-  // var arg.
-  if (Callee->isVarArg()) {
-    auto [ItEntry, _] = extCallSiteToVarArgEntryChi[Callee].emplace(
-        CB, std::make_unique<MSSAExtVarArgChi>(Callee));
-    auto &EntryChi = ItEntry->second;
-    EntryChi->var = std::make_unique<MSSAVar>(EntryChi.get(), 0, nullptr);
-
-    auto [ItOut, __] = extCallSiteToVarArgExitChi[Callee].emplace(
-        CB, std::make_unique<MSSAExtVarArgChi>(Callee));
-    auto &OutChi = ItOut->second;
-    OutChi->var = std::make_unique<MSSAVar>(EntryChi.get(), 1, nullptr);
-    OutChi->opVar = EntryChi->var.get();
-  }
-
-  // Create artifical entry and exit chi for each pointer argument.
-  unsigned ArgId = 0;
-  for (Argument const &Arg : Callee->args()) {
-    if (!Arg.getType()->isPointerTy()) {
-      ArgId++;
-      continue;
-    }
-
-    auto Chi = std::make_unique<MSSAExtArgChi>(Callee, ArgId);
-    auto [ItEntry, EntryInserted] =
-        extCallSiteToArgEntryChi[Callee][CB].emplace(ArgId, Chi.get());
-    if (EntryInserted) {
-      AllocatedArgChi.emplace_back(std::move(Chi));
-    }
-    auto &EntryChi = ItEntry->second;
-    EntryChi->var = std::make_unique<MSSAVar>(EntryChi, 0, nullptr);
-
-    auto ChiOut = std::make_unique<MSSAExtArgChi>(Callee, ArgId);
-    auto [ItOut, OutInserted] =
-        extCallSiteToArgExitChi[Callee][CB].emplace(ArgId, ChiOut.get());
-    if (OutInserted) {
-      AllocatedArgChi.emplace_back(std::move(ChiOut));
-    }
-    auto &ExitChi = ItOut->second;
-    ExitChi->var = std::make_unique<MSSAVar>(ExitChi, 1, nullptr);
-    ExitChi->opVar = EntryChi->var.get();
-
-    ArgId++;
-  }
-
-  // Create artifical chi for return value if it is a pointer.
-  if (Callee->getReturnType()->isPointerTy()) {
-    auto [ItRet, _] = extCallSiteToCalleeRetChi[Callee].emplace(
-        CB, std::make_unique<MSSAExtRetChi>(Callee));
-    auto &RetChi = ItRet->second;
-    RetChi->var = std::make_unique<MSSAVar>(RetChi.get(), 0, nullptr);
-  }
-}
-
 AnalysisKey MemorySSAAnalysis::Key;
 MemorySSAAnalysis::Result MemorySSAAnalysis::run(Module &M,
                                                  ModuleAnalysisManager &AM) {
@@ -0,0 +1,585 @@
+#include "parcoach/ModuleSummary.h"
+
+#include "parcoach/Collectives.h"
+#include "parcoach/DepGraphDCF.h"
+#include "parcoach/MemoryRegion.h"
+#include "parcoach/MemorySSA.h"
+#include "parcoach/ModRefAnalysis.h"
+#include "parcoach/Options.h"
+#include "parcoach/Warning.h"
+
+#include "Config.h"
+#include "PTACallGraph.h"
+#include "Utils.h"
+
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+
+using namespace llvm;
+
+namespace parcoach {
+namespace {
+cl::opt<std::string>
+    SummaryFile("emit-summary",
+                cl::desc("File where to write the summary of the module, to "
+                         "be combined by -link-summaries"),
+                cl::cat(ParcoachCategory));
+
+cl::opt<std::string> ImportSummariesFile(
+    "import-summaries",
+    cl::desc("Summary index (see -summary-index) describing the functions "
+             "defined in the other modules of the program"),
+    cl::value_desc("filename"), cl::cat(ParcoachCategory));
+
+summary::Location toSummaryLocation(DebugLoc const &DL) {
+  parcoach::Location Loc(DL);
+  return {Loc.Filename.str(), Loc.Line};
+}
+
+std::vector<std::string> getGlobalNames(MemRegSet const &Regions) {
+  std::set<std::string> Names;
+  for (MemRegEntry const *R : Regions) {
+    // Only the globals visible from the other modules are worth mentioning.
+    if (auto const *GV = dyn_cast_or_null<GlobalVariable>(R->Val)) {
+      if (!GV->hasLocalLinkage()) {
+        Names.insert(GV->getName().str());
+      }
+    }
+  }
+  return {Names.begin(), Names.end()};
+}
+
+// Compute the collectives each function may execute, visiting the callees
+// before their callers.
+DenseMap<Function const *, std::set<std::string>>
+getFunctionsCollectives(PTACallGraph const &PTACG) {
+  DenseMap<Function const *, std::set<std::string>> Result;
+  for (auto SccIter = scc_begin(&PTACG); !SccIter.isAtEnd(); ++SccIter) {
+    std::set<std::string> SccCollectives;
+    for (PTACallGraphNode const *Node : *SccIter) {
+      for (auto const &[_, Callee] : *Node) {
+        Function const *F = Callee->getFunction();
+        if (!F) {
+          continue;
+        }
+        if (Collective const *Coll = Collective::find(*F)) {
+          SccCollectives.insert(Coll->Name);
+        } else if (auto It = Result.find(F); It != Result.end()) {
+          SccCollectives.insert(It->second.begin(), It->second.end());
+        }
+      }
+    }
+    for (PTACallGraphNode const *Node : *SccIter) {
+      if (Function const *F = Node->getFunction()) {
+        Result[F] = SccCollectives;
+      }
+    }
+  }
+  return Result;
+}
+
+summary::ModuleSummary buildSummary(Module &M, ModuleAnalysisManager &AM) {
+  PTACallGraph const &PTACG = *AM.getResult<PTACallGraphAnalysis>(M);
+  DepGraphDCF &DG = *AM.getResult<DepGraphDCFAnalysis>(M);
+  ModRefAnalysisResult const &MRA = *AM.getResult<ModRefAnalysis>(M);
+  auto Collectives = getFunctionsCollectives(PTACG);
+
+  // The summaries hold whatever the context the functions are called in,
+  // while the context-sensitive flood only keeps the taint of the
+  // conditionals: the rank-dependent values are looked up in a
+  // context-insensitive graph.
+  auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  std::unique_ptr<DepGraphDCF> CIGraph;
+  if (!DG.isContextInsensitive()) {
+    CIGraph = std::make_unique<DepGraphDCF>(
+        AM.getResult<MemorySSAAnalysis>(M).get(), PTACG, FAM, M,
+        /*ContextInsensitive=*/true);
+  }
+  DepGraphDCF &CIDG = CIGraph ? *CIGraph : DG;
+
+  auto ExecutesCollectives = [&](CallInst const &CI) {
+    auto Executes = [&](Function const *Callee) {
+      if (Collective::isCollective(*Callee)) {
+        return true;
+      }
+      auto It = Collectives.find(Callee);
+      return It != Collectives.end() && !It->second.empty();
+    };
+    if (Function const *Callee = CI.getCalledFunction()) {
+      return Executes(Callee);
+    }
+    return any_of(getRange(PTACG.getIndirectCallMap(), &CI), Executes);
+  };
+
+  summary::ModuleSummary Summary;
+  for (Function &F : M) {
+    // Local functions can't be called from the other modules, what they do
+    // is accounted for in the summary of their callers.
+    if (F.isDeclaration() || F.hasLocalLinkage()) {
+      continue;
+    }
+    summary::FunctionSummary &FS = Summary.Functions[F.getName().str()];
+    auto const &FuncCollectives = Collectives[&F];
+    FS.Collectives.assign(FuncCollectives.begin(), FuncCollectives.end());
+    FS.Mod = getGlobalNames(MRA.getFuncMod(&F));
+    FS.Ref = getGlobalNames(MRA.getFuncRef(&F));
+    for (Argument const &Arg : F.args()) {
+      if (CIDG.isTaintedValue(&Arg)) {
+        FS.RankDependentArgs.push_back(Arg.getArgNo());
+      }
+    }
+
+    // The parameters the conditionals deciding whether a block is executed
+    // depend on.
+    PostDominatorTree &PDT = FAM.getResult<PostDominatorTreeAnalysis>(F);
+    std::map<BasicBlock *, std::set<int>> BlockArgs;
+    auto GetConditionalArgs = [&](BasicBlock *BB) -> std::set<int> const & {
+      auto [It, Inserted] = BlockArgs.try_emplace(BB);
+      if (Inserted) {
+        std::vector<Value const *> Conds;
+        for (BasicBlock *Pdf : iterated_postdominance_frontier(PDT, BB)) {
+          if (Value const *Cond = getBasicBlockCond(Pdf)) {
+            Conds.push_back(Cond);
+          }
+        }
+        CIDG.getArgumentDependencies(F, Conds, It->second);
+      }
+      return It->second;
+    };
+
+    std::set<int> CollectiveArgs;
+    for (Instruction &I : instructions(F)) {
+      if (auto const *RI = dyn_cast<ReturnInst>(&I)) {
+        Value const *RV = RI->getReturnValue();
+        FS.RankDependentReturn |= RV && CIDG.isTaintedValue(RV);
+        continue;
+      }
+      auto *CI = dyn_cast<CallInst>(&I);
+      if (!CI) {
+        continue;
+      }
+      if (ExecutesCollectives(*CI)) {
+        auto const &Args = GetConditionalArgs(CI->getParent());
+        CollectiveArgs.insert(Args.begin(), Args.end());
+      }
+      Function const *Callee = CI->getCalledFunction();
+      if (!Callee || !Callee->isDeclaration() || Callee->isIntrinsic() ||
+          Collective::isCollective(*Callee)) {
+        continue;
+      }
+      summary::ExternalCall Call{Callee->getName().str(),
+                                 toSummaryLocation(CI->getDebugLoc())};
+      std::set<BasicBlock const *> CallIpdf;
+      DG.getCallInterIPDF(CI, CallIpdf);
+      for (BasicBlock const *BB : CallIpdf) {
+        Value const *Cond = getBasicBlockCond(BB);
+        if (Cond && DG.isTaintedValue(Cond)) {
+          Call.Conditionals.push_back(
+              toSummaryLocation(BB->getTerminator()->getDebugLoc()));
+        }
+      }
+      auto const &Args = GetConditionalArgs(CI->getParent());
+      Call.ConditionalArgs.assign(Args.begin(), Args.end());
+      for (unsigned ArgNo = 0; ArgNo < CI->arg_size(); ArgNo++) {
+        if (CIDG.isTaintedValue(CI->getArgOperand(ArgNo))) {
+          Call.RankDependentArgs.push_back(ArgNo);
+        }
+      }
+      FS.ExternalCalls.push_back(std::move(Call));
+    }
+    FS.CollectiveArgs.assign(CollectiveArgs.begin(), CollectiveArgs.end());
+  }
+  return Summary;
+}
+
+// Whole-program view of the summaries, used by the link step.
+class SummaryLinker {
+  std::map<std::string, summary::FunctionSummary> Functions;
+  // The collectives each function may execute, computed on the first query
+  // once all the summaries are added.
+  StringMap<std::set<std::string>> Collectives;
+  bool CollectivesComputed = false;
+
+  struct SccNode {
+    unsigned Index;
+    unsigned LowLink;
+    bool OnStack;
+  };
+
+  // Tarjan's algorithm over the linked call graph. A SCC is completed after
+  // the SCCs it calls, so their collectives are known when it gets its own,
+  // shared by all its functions.
+  void visitScc(StringRef Name, StringMap<SccNode> &Nodes,
+                std::vector<StringRef> &Stack) {
+    unsigned Index = Nodes.size();
+    Nodes[Name] = {Index, Index, true};
+    Stack.push_back(Name);
+    auto FSIt = Functions.find(Name.str());
+    if (FSIt != Functions.end()) {
+      for (summary::ExternalCall const &Call : FSIt->second.ExternalCalls) {
+        auto It = Nodes.find(Call.Callee);
+        if (It == Nodes.end()) {
+          visitScc(Call.Callee, Nodes, Stack);
+          Nodes[Name].LowLink =
+              std::min(Nodes[Name].LowLink, Nodes[Call.Callee].LowLink);
+        } else if (It->second.OnStack) {
+          Nodes[Name].LowLink = std::min(Nodes[Name].LowLink, It->second.Index);
+        }
+      }
+    }
+    if (Nodes[Name].LowLink != Index) {
+      return;
+    }
+    auto SccBegin = std::find(Stack.rbegin(), Stack.rend(), Name).base() - 1;
+    std::set<std::string> SccCollectives;
+    for (auto It = SccBegin; It != Stack.end(); ++It) {
+      auto MemberIt = Functions.find(It->str());
+      if (MemberIt == Functions.end()) {
+        continue;
+      }
+      summary::FunctionSummary const &FS = MemberIt->second;
+      SccCollectives.insert(FS.Collectives.begin(), FS.Collectives.end());
+      // The callees in this SCC have no entry yet, the other ones are done.
+      for (summary::ExternalCall const &Call : FS.ExternalCalls) {
+        auto CalleeIt = Collectives.find(Call.Callee);
+        if (CalleeIt != Collectives.end()) {
+          SccCollectives.insert(CalleeIt->second.begin(),
+                                CalleeIt->second.end());
+        }
+      }
+    }
+    for (auto It = SccBegin; It != Stack.end(); ++It) {
+      Nodes[*It].OnStack = false;
+      Collectives[*It] = SccCollectives;
+    }
+    Stack.erase(SccBegin, Stack.end());
+  }
+
+  void computeCollectives() {
+    StringMap<SccNode> Nodes;
+    std::vector<StringRef> Stack;
+    for (auto const &[Name, _] : Functions) {
+      if (!Nodes.count(Name)) {
+        visitScc(Name, Nodes, Stack);
+      }
+    }
+    CollectivesComputed = true;
+  }
+
+public:
+  void add(summary::ModuleSummary &&Summary) {
+    for (auto &[Name, FS] : Summary.Functions) {
+      // With several definitions (eg: weak ones), keep the first one.
+      Functions.try_emplace(Name, std::move(FS));
+    }
+  }
+
+  // The collectives a function may execute, whichever module they are in.
+  std::set<std::string> const &getCollectives(StringRef Name) {
+    if (!CollectivesComputed) {
+      computeCollectives();
+    }
+    // Unknown functions execute no collective.
+    return Collectives[Name];
+  }
+
+  bool executesCollectives(StringRef Name) {
+    return !getCollectives(Name).empty();
+  }
+
+  // The parameters deciding whether a function executes its collectives,
+  // whichever module they are in.
+  std::set<int> getCollectiveArgs(StringRef Name) {
+    std::set<int> Args;
+    auto It = Functions.find(Name.str());
+    if (It == Functions.end()) {
+      return Args;
+    }
+    summary::FunctionSummary const &FS = It->second;
+    Args.insert(FS.CollectiveArgs.begin(), FS.CollectiveArgs.end());
+    for (summary::ExternalCall const &Call : FS.ExternalCalls) {
+      if (executesCollectives(Call.Callee)) {
+        Args.insert(Call.ConditionalArgs.begin(), Call.ConditionalArgs.end());
+      }
+    }
+    return Args;
+  }
+
+  // The combined summaries, to be imported by the per-module analyses.
+  summary::ModuleSummary buildIndex() {
+    // The parameters the calls from the other modules may pass a
+    // rank-dependent value to.
+    StringMap<std::set<int>> RankDependentArgs;
+    for (auto const &[_, FS] : Functions) {
+      for (summary::ExternalCall const &Call : FS.ExternalCalls) {
+        RankDependentArgs[Call.Callee].insert(Call.RankDependentArgs.begin(),
+                                              Call.RankDependentArgs.end());
+      }
+    }
+
+    summary::ModuleSummary Index;
+    for (auto const &[Name, FS] : Functions) {
+      summary::FunctionSummary &IndexFS = Index.Functions[Name];
+      IndexFS = FS;
+      auto const &FuncCollectives = getCollectives(Name);
+      IndexFS.Collectives.assign(FuncCollectives.begin(),
+                                 FuncCollectives.end());
+      std::set<int> &FuncRankDependentArgs = RankDependentArgs[Name];
+      FuncRankDependentArgs.insert(FS.RankDependentArgs.begin(),
+                                   FS.RankDependentArgs.end());
+      IndexFS.RankDependentArgs.assign(FuncRankDependentArgs.begin(),
+                                       FuncRankDependentArgs.end());
+      auto CollectiveArgs = getCollectiveArgs(Name);
+      IndexFS.CollectiveArgs.assign(CollectiveArgs.begin(),
+                                    CollectiveArgs.end());
+    }
+    return Index;
+  }
+
+  // Report the calls executing collectives in another module, which depend
+  // on a rank-dependent conditional or pass a rank-dependent value to a
+  // parameter deciding whether the collectives are executed. Return the
+  // number of warnings.
+  unsigned reportWarnings() {
+    unsigned NumWarnings = 0;
+    auto Warn = [&](summary::ExternalCall const &Call, StringRef Reason) {
+      std::string Msg;
+      raw_string_ostream OS(Msg);
+      OS << Call.Callee << " line " << Call.Where.Line << Reason
+         << " (Call Ordering Error)";
+      SMDiagnostic(Call.Where.Filename, SourceMgr::DK_Warning, OS.str())
+          .print(ProgName, errs(), true, true);
+      ++NumWarnings;
+    };
+    for (auto const &[_, FS] : Functions) {
+      for (summary::ExternalCall const &Call : FS.ExternalCalls) {
+        if (!executesCollectives(Call.Callee)) {
+          continue;
+        }
+        if (!Call.Conditionals.empty()) {
+          std::string Reason;
+          raw_string_ostream OS(Reason);
+          OS << " possibly not called by all processes because of "
+                "conditional(s) line(s) ";
+          for (auto const &Loc : Call.Conditionals) {
+            OS << " " << Loc.Line;
+            OS << " (" << Loc.Filename << ")";
+          }
+          Warn(Call, OS.str());
+        }
+        auto CollectiveArgs = getCollectiveArgs(Call.Callee);
+        std::string Args;
+        raw_string_ostream OS(Args);
+        for (int ArgNo : Call.RankDependentArgs) {
+          if (CollectiveArgs.count(ArgNo)) {
+            OS << " " << ArgNo + 1;
+          }
+        }
+        if (!OS.str().empty()) {
+          Warn(Call, " possibly not executing its collectives on all "
+                     "processes because of rank-dependent argument(s) " +
+                         OS.str());
+        }
+      }
+    }
+    return NumWarnings;
+  }
+};
+
+summary::ModuleSummary loadImportedSummaries() {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
+      MemoryBuffer::getFile(ImportSummariesFile, /*IsText=*/true);
+  if (std::error_code EC = FileOrErr.getError()) {
+    errs() << "Error: could not read the imported summaries "
+           << ImportSummariesFile << ": " << EC.message() << "\n";
+    exit(EXIT_FAILURE);
+  }
+  auto Summary = summary::ModuleSummary::load((*FileOrErr)->getBuffer());
+  if (auto E = Summary.takeError()) {
+    errs() << "Error: could not load the imported summaries "
+           << ImportSummariesFile << ": " << toString(std::move(E)) << "\n";
+    exit(EXIT_FAILURE);
+  }
+  return std::move(*Summary);
+}
+
+summary::FunctionSummary const *findIndexedSummary(Function const &F) {
+  // Loaded once, by the first analysis looking at a function.
+  static summary::ModuleSummary const Imported = loadImportedSummaries();
+  auto It = Imported.Functions.find(F.getName().str());
+  return It != Imported.Functions.end() ? &It->second : nullptr;
+}
+
+} // namespace
+
+namespace summary {
+
+bool fromJSON(json::Value const &E, Location &L, json::Path P) {
+  json::ObjectMapper O(E, P);
+  return O && O.map("file", L.Filename) && O.map("line", L.Line);
+}
+
+json::Value toJSON(Location const &L) {
+  return json::Object{{"file", L.Filename}, {"line", L.Line}};
+}
+
+bool fromJSON(json::Value const &E, ExternalCall &C, json::Path P) {
+  json::ObjectMapper O(E, P);
+  return O && O.map("callee", C.Callee) && O.map("location", C.Where) &&
+         O.map("conditionals", C.Conditionals) &&
+         O.mapOptional("conditionalArgs", C.ConditionalArgs) &&
+         O.mapOptional("rankDependentArgs", C.RankDependentArgs);
+}
+
+json::Value toJSON(ExternalCall const &C) {
+  return json::Object{
+      {"callee", C.Callee},
+      {"location", C.Where},
+      {"conditionals", C.Conditionals},
+      {"conditionalArgs", C.ConditionalArgs},
+      {"rankDependentArgs", C.RankDependentArgs},
+  };
+}
+
+bool fromJSON(json::Value const &E, FunctionSummary &FS, json::Path P) {
+  json::ObjectMapper O(E, P);
+  return O && O.map("collectives", FS.Collectives) && O.map("mod", FS.Mod) &&
+         O.map("ref", FS.Ref) &&
+         O.map("rankDependentArgs", FS.RankDependentArgs) &&
+         O.mapOptional("collectiveArgs", FS.CollectiveArgs) &&
+         O.map("rankDependentReturn", FS.RankDependentReturn) &&
+         O.map("externalCalls", FS.ExternalCalls);
+}
+
+json::Value toJSON(FunctionSummary const &FS) {
+  return json::Object{
+      {"collectives", FS.Collectives},
+      {"mod", FS.Mod},
+      {"ref", FS.Ref},
+      {"rankDependentArgs", FS.RankDependentArgs},
+      {"collectiveArgs", FS.CollectiveArgs},
+      {"rankDependentReturn", FS.RankDependentReturn},
+      {"externalCalls", FS.ExternalCalls},
+  };
+}
+
+bool fromJSON(json::Value const &E, ModuleSummary &S, json::Path P) {
+  json::ObjectMapper O(E, P);
+  int Version = 0;
+  if (!O || !O.map("version", Version)) {
+    return false;
+  }
+  if (Version != ModuleSummary::Version) {
+    P.field("version").report("unsupported summary version");
+    return false;
+  }
+  return O.map("functions", S.Functions);
+}
+
+json::Value toJSON(ModuleSummary const &S) {
+  json::Object Functions;
+  for (auto const &[Name, FS] : S.Functions) {
+    Functions[Name] = toJSON(FS);
+  }
+  return json::Object{
+      {"version", ModuleSummary::Version},
+      {"functions", std::move(Functions)},
+  };
+}
+
+void ModuleSummary::write(raw_ostream &Os) const {
+  Os << formatv("{0:2}", json::Value(*this));
+}
+
+Expected<ModuleSummary> ModuleSummary::load(StringRef Json) {
+  return json::parse<ModuleSummary>(Json);
+}
+
+bool linkSummaries(ArrayRef<std::string> Files, StringRef IndexFile) {
+  SummaryLinker Linker;
+  for (std::string const &File : Files) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
+        MemoryBuffer::getFile(File, /*IsText=*/true);
+    if (std::error_code EC = FileOrErr.getError()) {
+      SMDiagnostic(File, SourceMgr::DK_Error, EC.message())
+          .print(ProgName, errs(), true, true);
+      return false;
+    }
+    auto Summary = ModuleSummary::load((*FileOrErr)->getBuffer());
+    if (auto E = Summary.takeError()) {
+      SMDiagnostic(File, SourceMgr::DK_Error,
+                   "Could not load the module summary: " +
+                       toString(std::move(E)))
+          .print(ProgName, errs(), true, true);
+      return false;
+    }
+    Linker.add(std::move(*Summary));
+  }
+  if (Linker.reportWarnings() == 0) {
+    SMDiagnostic("", SourceMgr::DK_Remark, "No issues found.")
+        .print(ProgName, errs(), true, true);
+  }
+  if (IndexFile.empty()) {
+    return true;
+  }
+  std::error_code EC;
+  raw_fd_ostream Os{IndexFile, EC, sys::fs::OF_Text};
+  if (EC) {
+    errs() << "Could not open file: " << EC.message() << ", " << IndexFile
+           << "\n";
+    return false;
+  }
+  Linker.buildIndex().write(Os);
+  return true;
+}
+
+FunctionSummary const *findImportedSummary(Function const &F) {
+  if (ImportSummariesFile.empty() || !F.isDeclaration()) {
+    return nullptr;
+  }
+  return findIndexedSummary(F);
+}
+
+ArrayRef<int> getImportedRankDependentArgs(Function const &F) {
+  if (ImportSummariesFile.empty() || F.isDeclaration()) {
+    return {};
+  }
+  FunctionSummary const *FS = findIndexedSummary(F);
+  return FS ? ArrayRef<int>(FS->RankDependentArgs) : ArrayRef<int>();
+}
+
+} // namespace summary
+
+PreservedAnalyses ModuleSummaryPass::run(Module &M,
+                                         ModuleAnalysisManager &AM) {
+  if (SummaryFile.empty()) {
+    return PreservedAnalyses::all();
+  }
+  TimeTraceScope TTS("ModuleSummaryPass");
+  summary::ModuleSummary Summary = buildSummary(M, AM);
+
+  std::error_code EC;
+  raw_fd_ostream Os{SummaryFile, EC, sys::fs::OF_Text};
+  if (EC) {
+    errs() << "Could not open file: " << EC.message() << ", " << SummaryFile
+           << "\n";
+    return PreservedAnalyses::all();
+  }
+  Summary.write(Os);
+  return PreservedAnalyses::all();
+}
+
+} // namespace parcoach
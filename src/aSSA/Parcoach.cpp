@@ -17,6 +17,7 @@ The project is licensed under the LGPL 2.1 license
 #include "parcoach/MemoryRegion.h"
 #include "parcoach/MemorySSA.h"
 #include "parcoach/ModRefAnalysis.h"
+#include "parcoach/ModuleSummary.h"
 #include "parcoach/Options.h"
 #include "parcoach/Passes.h"
 #include "parcoach/RMAPasses.h"
@@ -60,6 +61,13 @@ cl::opt<bool> OptContextInsensitive("context-insensitive",
                                              "flooding."),
                                     cl::cat(ParcoachCategory));
 
+cl::opt<bool> OptDemandDriven(
+    "demand-driven",
+    cl::desc("Only build the part of the dependency graph needed to check "
+             "the conditionals of the collectives, with the results of the "
+             "context insensitive version."),
+    cl::cat(ParcoachCategory));
+
 cl::opt<bool> OptDotGraph("dot-depgraph",
                           cl::desc("Dot the dependency graph to dg.dot"),
                           cl::cat(ParcoachCategory));
@@ -90,6 +98,11 @@ void RegisterPasses(ModulePassManager &MPM) {
            << "sensitive mode.\n";
     exit(EXIT_FAILURE);
   }
+  if (OptDemandDriven && (OptDotTaintPaths || OptDotGraph)) {
+    errs() << "Error: you cannot use -dot-taint-paths or -dot-depgraph options "
+           << "in demand-driven mode.\n";
+    exit(EXIT_FAILURE);
+  }
 
   // Let's make sure we have a single exit node in all our functions.
   MPM.addPass(createModuleToFunctionPassAdaptor(UnifyFunctionExitNodesPass()));
@@ -117,6 +130,7 @@ void RegisterPasses(ModulePassManager &MPM) {
   }
   MPM.addPass(ShowPAInterResult());
   MPM.addPass(SonarSerializationPass());
+  MPM.addPass(ModuleSummaryPass());
   if (OptInstrumInter) {
     MPM.addPass(ParcoachInstrumentationPass());
   }
@@ -134,14 +148,17 @@ void RegisterModuleAnalyses(ModuleAnalysisManager &MAM) {
   MAM.registerPass([&]() { return AndersenAA(); });
   MAM.registerPass([&]() { return CollectiveAnalysis(OptDotTaintPaths); });
   MAM.registerPass([&]() { return CollListFunctionAnalysis(); });
-  MAM.registerPass(
-      [&]() { return DepGraphDCFAnalysis(OptContextInsensitive); });
+  MAM.registerPass([&]() {
+    return DepGraphDCFAnalysis(OptContextInsensitive, OptDemandDriven);
+  });
   MAM.registerPass([&]() { return ExtInfoAnalysis(); });
   MAM.registerPass([&]() { return MemorySSAAnalysis(); });
   MAM.registerPass([&]() { return MemRegAnalysis(); });
   MAM.registerPass([&]() { return ModRefAnalysis(); });
   MAM.registerPass([&]() { return MPICommAnalysis(); });
   MAM.registerPass([&]() { return PTACallGraphAnalysis(); });
+  MAM.registerPass([&]() { return rma::RMAEpochAnalysis(); });
+  MAM.registerPass([&]() { return rma::RMAExposedMemoryAnalysis(); });
   MAM.registerPass([&]() { return StatisticsAnalysis(); });
 }
 
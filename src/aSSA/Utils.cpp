@@ -11,6 +11,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <map>
+#include <mutex>
 
 #define DEBUG_TYPE "hello"
 
@@ -48,18 +49,39 @@ std::string getCallValueLabel(llvm::Value const *V) {
  * POSTDOMINANCE
  */
 
-static std::map<BasicBlock *, std::unique_ptr<std::set<BasicBlock *>>> PdfCache;
+using FrontierCache =
+    std::map<BasicBlock *, std::unique_ptr<std::set<BasicBlock *>>>;
+static FrontierCache PdfCache;
+static FrontierCache IpdfCache;
+// The memory SSA of the functions may be built concurrently; the lock is only
+// held to access the caches, not while computing a frontier.
+static std::mutex PdfCacheMutex;
+
+// Return the cached frontier of BB, or false if it hasn't been computed.
+static bool getCachedFrontier(FrontierCache const &Cache, BasicBlock *BB,
+                              std::vector<BasicBlock *> &Frontier) {
+  std::lock_guard<std::mutex> Lock(PdfCacheMutex);
+  auto It = Cache.find(BB);
+  if (It == Cache.end() || !It->second) {
+    return false;
+  }
+  Frontier.assign(It->second->begin(), It->second->end());
+  return true;
+}
+
+static void setCachedFrontier(FrontierCache &Cache, BasicBlock *BB,
+                              std::vector<BasicBlock *> const &Frontier) {
+  std::lock_guard<std::mutex> Lock(PdfCacheMutex);
+  Cache[BB] = std::make_unique<std::set<BasicBlock *>>(Frontier.begin(),
+                                                       Frontier.end());
+}
 
 // PDF computation
 std::vector<BasicBlock *> postdominanceFrontier(PostDominatorTree &PDT,
                                                 BasicBlock *BB) {
   std::vector<BasicBlock *> PDF;
 
-  auto &Cache = PdfCache[BB];
-  if (Cache) {
-    for (BasicBlock *B : *Cache) {
-      PDF.push_back(B);
-    }
+  if (getCachedFrontier(PdfCache, BB, PDF)) {
     return PDF;
   }
 
@@ -87,25 +109,17 @@ std::vector<BasicBlock *> postdominanceFrontier(PostDominatorTree &PDT,
     }
   }
 
-  PdfCache[BB] = std::make_unique<std::set<BasicBlock *>>();
-  PdfCache[BB]->insert(PDF.begin(), PDF.end());
+  setCachedFrontier(PdfCache, BB, PDF);
 
   return PDF;
 }
 
-static std::map<BasicBlock *, std::unique_ptr<std::set<BasicBlock *>>>
-    IpdfCache;
-
 // PDF+ computation
 std::vector<BasicBlock *>
 iterated_postdominance_frontier(PostDominatorTree &PDT, BasicBlock *BB) {
   std::vector<BasicBlock *> IPDF;
 
-  auto &Cache = IpdfCache[BB];
-  if (Cache) {
-    for (BasicBlock *B : *Cache) {
-      IPDF.push_back(B);
-    }
+  if (getCachedFrontier(IpdfCache, BB, IPDF)) {
     return IPDF;
   }
 
@@ -141,8 +155,7 @@ iterated_postdominance_frontier(PostDominatorTree &PDT, BasicBlock *BB) {
 
   IPDF.insert(IPDF.end(), S.begin(), S.end());
 
-  IpdfCache[BB] = std::make_unique<std::set<BasicBlock *>>();
-  IpdfCache[BB]->insert(IPDF.begin(), IPDF.end());
+  setCachedFrontier(IpdfCache, BB, IPDF);
 
   return IPDF;
 }
@@ -1,8 +1,11 @@
 #include "parcoach/andersen/Andersen.h"
+#include "parcoach/andersen/Stats.h"
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 #define DEBUG_TYPE "andersen"
 
@@ -20,6 +23,42 @@ cl::opt<bool> DumpConstraintInfo("dump-cons",
                                  cl::init(false), cl::Hidden);
 #endif
 
+cl::opt<bool> AndersenStats(
+    "andersen-stats",
+    cl::desc("Report the time and memory spent in each phase of the Andersen "
+             "analysis"),
+    cl::init(false));
+
+namespace {
+double toMB(size_t bytes) { return bytes / (1024. * 1024.); }
+} // namespace
+
+AndersPhaseStats::AndersPhaseStats(StringRef name) : name(name) {
+  if (!AndersenStats)
+    return;
+  start = std::chrono::steady_clock::now();
+  startMemory = sys::Process::GetMallocUsage();
+}
+
+AndersPhaseStats::~AndersPhaseStats() {
+  if (!AndersenStats)
+    return;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  size_t memory = sys::Process::GetMallocUsage();
+  double delta = toMB(memory) - toMB(startMemory);
+  errs() << "andersen: " << name << ": "
+         << format("%.3f s, %+.1f MB (%.1f MB in use)\n", elapsed.count(),
+                   delta, toMB(memory));
+}
+
+void reportAndersSize(StringRef name, size_t count, size_t bytes) {
+  if (!AndersenStats)
+    return;
+  errs() << "andersen: " << count << " " << name << " ("
+         << format("%.1f MB", toMB(bytes)) << ")\n";
+}
+
 AnalysisKey AndersenAA::Key;
 
 Andersen AndersenAA::run(Module &M, ModuleAnalysisManager &) {
@@ -64,24 +103,92 @@ bool Andersen::getPointsToSet(llvm::Value const *v,
   return true;
 }
 
+AndersPtsSet const *Andersen::findPtsSet(NodeIndex n) const {
+  auto ptsItr = ptsGraph.find(nodeFactory.getMergeTarget(n));
+  if (ptsItr == ptsGraph.end())
+    return nullptr;
+  return &ptsItr->second;
+}
+
+bool Andersen::getPointsToNodes(llvm::Value const *v, AndersPtsSet &pts) const {
+  NodeIndex ptrIndex = nodeFactory.getValueNodeFor(v);
+  if (ptrIndex == AndersNodeFactory::InvalidIndex ||
+      ptrIndex == nodeFactory.getUniversalPtrNode())
+    return false;
+
+  getPointsToNodes(ptrIndex, pts);
+  return true;
+}
+
+void Andersen::getPointsToNodes(NodeIndex n, AndersPtsSet &pts) const {
+  pts.clear();
+  if (AndersPtsSet const *nodePts = findPtsSet(n))
+    pts = *nodePts;
+}
+
+bool Andersen::mayPointToAny(llvm::Value const *v,
+                             AndersPtsSet const &objs) const {
+  NodeIndex ptrIndex = nodeFactory.getValueNodeFor(v);
+  if (ptrIndex == AndersNodeFactory::InvalidIndex ||
+      ptrIndex == nodeFactory.getUniversalPtrNode())
+    return true;
+
+  AndersPtsSet const *pts = findPtsSet(ptrIndex);
+  return !pts || pts->isEmpty() || pts->intersectWith(objs);
+}
+
 bool Andersen::runOnModule(Module const &M) {
-  collectConstraints(M);
+  {
+    AndersPhaseStats stats("constraint collection");
+    collectConstraints(M);
+  }
+  reportAndersSize("nodes", nodeFactory.getNumNodes(),
+                   nodeFactory.getNumNodes() * sizeof(AndersNode));
+  reportAndersSize("constraints", constraints.size(),
+                   constraints.capacity() * sizeof(AndersConstraint));
 
 #ifndef NDEBUG
   if (DumpDebugInfo)
     dumpConstraintsPlainVanilla();
 #endif
 
+  std::string cachePath = getResultCachePath(M);
+  bool cached = false;
+  if (!cachePath.empty()) {
+    AndersPhaseStats stats("cache loading");
+    cached = loadResults(cachePath);
+  }
+  if (cached) {
+    constraints.clear();
+    if (AndersenStats)
+      errs() << "andersen: loaded the results from " << cachePath << "\n";
+  } else {
 #ifdef ANDERSEN_ENABLE_OPTIMIZATIONS
-  optimizeConstraints();
+    {
+      AndersPhaseStats stats("constraint optimization");
+      optimizeConstraints();
+    }
 #endif
 
 #ifndef NDEBUG
-  if (DumpConstraintInfo)
-    dumpConstraints();
+    if (DumpConstraintInfo)
+      dumpConstraints();
 #endif
 
-  solveConstraints();
+    {
+      AndersPhaseStats stats("constraint solving");
+      solveConstraints();
+    }
+    if (!cachePath.empty())
+      saveResults(cachePath);
+  }
+  if (AndersenStats) {
+    reportAndersSize("points-to sets", ptsGraph.size(),
+                     ptsGraph.size() * sizeof(decltype(ptsGraph)::value_type));
+    size_t ptsMemory;
+    size_t numDistinct = AndersPtsSet::getNumDistinctSets(ptsMemory);
+    reportAndersSize("distinct points-to sets", numDistinct, ptsMemory);
+  }
 
 #ifndef NDEBUG
   if (DumpDebugInfo) {
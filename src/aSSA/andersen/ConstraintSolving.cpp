@@ -1,14 +1,19 @@
 #include "parcoach/andersen/Andersen.h"
 #include "parcoach/andersen/CycleDetector.h"
 #include "parcoach/andersen/SparseBitVectorGraph.h"
+#include "parcoach/andersen/Stats.h"
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
-#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
 #include <map>
 #include <queue>
 
@@ -20,6 +25,16 @@ cl::opt<bool> EnableHCD("enable-hcd",
 cl::opt<bool> EnableLCD("enable-lcd",
                         cl::desc("Enable the lazy cycle detection algorithm"),
                         cl::init(true));
+cl::opt<unsigned> AndersenThreads(
+    "andersen-threads",
+    cl::desc("Number of threads used to solve the Andersen constraints (0 "
+             "uses all the cores, 1 uses the sequential solver)"),
+    cl::init(1));
+cl::opt<bool> AndersenCheckParallel(
+    "andersen-check-parallel",
+    cl::desc("Check that the parallel Andersen solver gives the same results "
+             "as the sequential one"),
+    cl::init(false), cl::Hidden);
 
 namespace {
 
@@ -27,31 +42,71 @@ namespace {
 class ConstraintGraphNode {
 private:
   NodeIndex idx;
+  // Whether the node is part of the graph, nodes without any edge may still
+  // be examined by the solver as long as they haven't been merged.
+  bool present = false;
 
-  // We use set rather than SmallSet because we need the capability of iteration
-  typedef std::set<NodeIndex> NodeSet;
+  // The edges are kept sorted, so that looking one up is a binary search and
+  // merging the edges of two nodes is linear.
+  typedef llvm::SmallVector<NodeIndex, 4> NodeSet;
   NodeSet copyEdges, loadEdges, storeEdges;
 
-  bool insertCopyEdge(NodeIndex dst) { return copyEdges.insert(dst).second; }
-  bool removeCopyEdge(NodeIndex dst) { return copyEdges.erase(dst); }
-  bool insertLoadEdge(NodeIndex dst) { return loadEdges.insert(dst).second; }
-  bool removeLoadEdge(NodeIndex dst) { return loadEdges.erase(dst); }
-  bool insertStoreEdge(NodeIndex dst) { return storeEdges.insert(dst).second; }
-  bool removeStoreEdge(NodeIndex dst) { return storeEdges.erase(dst); }
+  static bool insertEdge(NodeSet &edges, NodeIndex dst) {
+    auto itr = std::lower_bound(edges.begin(), edges.end(), dst);
+    if (itr != edges.end() && *itr == dst)
+      return false;
+    edges.insert(itr, dst);
+    return true;
+  }
+  static bool removeEdge(NodeSet &edges, NodeIndex dst) {
+    auto itr = std::lower_bound(edges.begin(), edges.end(), dst);
+    if (itr == edges.end() || *itr != dst)
+      return false;
+    edges.erase(itr);
+    return true;
+  }
+  static void mergeEdges(NodeSet &edges, NodeSet const &other) {
+    NodeSet merged;
+    merged.reserve(edges.size() + other.size());
+    std::set_union(edges.begin(), edges.end(), other.begin(), other.end(),
+                   std::back_inserter(merged));
+    edges = std::move(merged);
+  }
+
+  bool insertCopyEdge(NodeIndex dst) { return insertEdge(copyEdges, dst); }
+  bool removeCopyEdge(NodeIndex dst) { return removeEdge(copyEdges, dst); }
+  bool insertLoadEdge(NodeIndex dst) { return insertEdge(loadEdges, dst); }
+  bool removeLoadEdge(NodeIndex dst) { return removeEdge(loadEdges, dst); }
+  bool insertStoreEdge(NodeIndex dst) { return insertEdge(storeEdges, dst); }
+  bool removeStoreEdge(NodeIndex dst) { return removeEdge(storeEdges, dst); }
   bool isEmpty() const {
     return copyEdges.empty() && loadEdges.empty() && storeEdges.empty();
   }
 
   void mergeEdges(ConstraintGraphNode const &other) {
-    copyEdges.insert(other.copyEdges.begin(), other.copyEdges.end());
-    loadEdges.insert(other.loadEdges.begin(), other.loadEdges.end());
-    storeEdges.insert(other.storeEdges.begin(), other.storeEdges.end());
+    mergeEdges(copyEdges, other.copyEdges);
+    mergeEdges(loadEdges, other.loadEdges);
+    mergeEdges(storeEdges, other.storeEdges);
   }
 
-  ConstraintGraphNode(NodeIndex i) : idx(i) {}
+  void clear() {
+    present = false;
+    // Release the memory as well, the node won't be used anymore.
+    NodeSet().swap(copyEdges);
+    NodeSet().swap(loadEdges);
+    NodeSet().swap(storeEdges);
+  }
+
+  // This slightly overestimates, as it counts the inline storage twice.
+  size_t getMemoryUsage() const {
+    return sizeof(*this) + capacity_in_bytes(copyEdges) +
+           capacity_in_bytes(loadEdges) + capacity_in_bytes(storeEdges);
+  }
 
 public:
-  typedef NodeSet::iterator iterator;
+  ConstraintGraphNode(NodeIndex i) : idx(i) {}
+
+  typedef NodeSet::const_iterator iterator;
   typedef NodeSet::const_iterator const_iterator;
 
   NodeIndex getNodeIndex() const { return idx; }
@@ -66,8 +121,6 @@ public:
     return removeStoreEdge(oldIdx) && insertStoreEdge(newIdx);
   }
 
-  iterator begin() { return copyEdges.begin(); }
-  iterator end() { return copyEdges.end(); }
   const_iterator begin() const { return copyEdges.begin(); }
   const_iterator end() const { return copyEdges.end(); }
 
@@ -86,81 +139,70 @@ public:
   friend class ConstraintGraph;
 };
 
+// The nodes are stored in a vector indexed by NodeIndex, which is never
+// resized once the graph is built: pointers to nodes stay valid during the
+// whole solving.
 class ConstraintGraph {
 private:
-  typedef std::map<NodeIndex, ConstraintGraphNode> NodeMapTy;
-  NodeMapTy graph;
+  typedef std::vector<ConstraintGraphNode> NodeVecTy;
+  NodeVecTy graph;
+
+  ConstraintGraphNode &getNode(NodeIndex idx) {
+    ConstraintGraphNode &node = graph[idx];
+    node.present = true;
+    return node;
+  }
 
 public:
-  typedef NodeMapTy::iterator iterator;
-  typedef NodeMapTy::const_iterator const_iterator;
+  typedef NodeVecTy::iterator iterator;
+  typedef NodeVecTy::const_iterator const_iterator;
 
-  ConstraintGraph() {}
+  ConstraintGraph(unsigned numNodes) {
+    graph.reserve(numNodes);
+    for (NodeIndex i = 0; i < numNodes; ++i)
+      graph.emplace_back(i);
+  }
 
   bool insertCopyEdge(NodeIndex src, NodeIndex dst) {
-    auto itr = graph.find(src);
-    if (itr == graph.end()) {
-      ConstraintGraphNode srcNode(src);
-      srcNode.insertCopyEdge(dst);
-      graph.insert(std::make_pair(src, std::move(srcNode)));
-      return true;
-    } else
-      return (itr->second).insertCopyEdge(dst);
+    return getNode(src).insertCopyEdge(dst);
   }
 
   bool insertLoadEdge(NodeIndex src, NodeIndex dst) {
-    auto itr = graph.find(src);
-    if (itr == graph.end()) {
-      ConstraintGraphNode srcNode(src);
-      srcNode.insertLoadEdge(dst);
-      graph.insert(std::make_pair(src, std::move(srcNode)));
-      return true;
-    } else
-      return (itr->second).insertLoadEdge(dst);
+    return getNode(src).insertLoadEdge(dst);
   }
 
   bool insertStoreEdge(NodeIndex src, NodeIndex dst) {
-    auto itr = graph.find(src);
-    if (itr == graph.end()) {
-      ConstraintGraphNode srcNode(src);
-      srcNode.insertStoreEdge(dst);
-      graph.insert(std::make_pair(src, std::move(srcNode)));
-      return true;
-    } else
-      return (itr->second).insertStoreEdge(dst);
+    return getNode(src).insertStoreEdge(dst);
   }
 
   void mergeNodes(NodeIndex dst, NodeIndex src) {
-    auto itr = graph.find(src);
-    if (itr == graph.end())
+    ConstraintGraphNode const &srcNode = graph[src];
+    if (!srcNode.present)
       return;
-
-    ConstraintGraphNode const &srcNode = itr->second;
-    itr = graph.find(dst);
-    if (itr == graph.end()) {
-      ConstraintGraphNode dstNode(dst);
-      graph.insert(std::make_pair(dst, srcNode));
-    } else
-      (itr->second).mergeEdges(srcNode);
+    getNode(dst).mergeEdges(srcNode);
   }
 
-  void deleteNode(NodeIndex idx) { graph.erase(idx); }
+  void deleteNode(NodeIndex idx) { graph[idx].clear(); }
 
   ConstraintGraphNode *getNodeWithIndex(NodeIndex idx) {
-    auto itr = graph.find(idx);
-    if (itr == graph.end())
-      return nullptr;
-    else
-      return &(itr->second);
+    ConstraintGraphNode &node = graph[idx];
+    return node.present ? &node : nullptr;
   }
 
-  ConstraintGraphNode *getOrInsertNode(NodeIndex idx) {
-    auto itr = graph.find(idx);
-    if (itr == graph.end()) {
-      ConstraintGraphNode newNode(idx);
-      itr = graph.insert(std::make_pair(idx, newNode)).first;
-    }
-    return &(itr->second);
+  ConstraintGraphNode *getOrInsertNode(NodeIndex idx) { return &getNode(idx); }
+
+  size_t getNumEdges() const {
+    size_t numEdges = 0;
+    for (auto const &node : graph)
+      numEdges += node.copyEdges.size() + node.loadEdges.size() +
+                  node.storeEdges.size();
+    return numEdges;
+  }
+  size_t getMemoryUsage() const {
+    size_t memory = 0;
+    for (auto const &node : graph)
+      memory += node.getMemoryUsage();
+    return memory;
   }
 
   iterator begin() { return graph.begin(); }
@@ -175,7 +217,7 @@ public:
 template <> class AndersGraphTraits<ConstraintGraph> {
 public:
   typedef ConstraintGraphNode NodeType;
-  typedef MapValueIterator<ConstraintGraph::const_iterator> NodeIterator;
+  typedef ConstraintGraph::const_iterator NodeIterator;
   typedef ConstraintGraphNode::iterator ChildIterator;
 
   static inline ChildIterator child_begin(NodeType const *n) {
@@ -184,18 +226,21 @@ public:
   static inline ChildIterator child_end(NodeType const *n) { return n->end(); }
 
   static inline NodeIterator node_begin(ConstraintGraph const *g) {
-    return NodeIterator(g->begin());
+    return g->begin();
   }
   static inline NodeIterator node_end(ConstraintGraph const *g) {
-    return NodeIterator(g->end());
+    return g->end();
   }
 };
 
 namespace {
 
+// propagated[n] is the part of the points-to set of n which has already been
+// processed along the edges of n.
 void collapseNodes(NodeIndex dst, NodeIndex src, AndersNodeFactory &nodeFactory,
                    std::map<NodeIndex, AndersPtsSet> &ptsGraph,
-                   ConstraintGraph &constraintGraph) {
+                   ConstraintGraph &constraintGraph,
+                   std::vector<AndersPtsSet> &propagated) {
   if (dst == src)
     return;
 
@@ -204,6 +249,10 @@ void collapseNodes(NodeIndex dst, NodeIndex src, AndersNodeFactory &nodeFactory,
   if (ptsGraph.count(src))
     ptsGraph[dst].unionWith(ptsGraph[src]);
   constraintGraph.mergeNodes(dst, src);
+  // The edges of src haven't seen what dst has propagated and vice versa, so
+  // the whole points-to set of dst will be processed again.
+  propagated[dst].clear();
+  propagated[src].clear();
 
   // We don't need the node cycleIdx any more
   ptsGraph.erase(src);
@@ -216,21 +265,21 @@ private:
   // The FIFO queue
   std::queue<NodeIndex> list;
   // Avoid duplicate entries in FIFO queue
-  llvm::SmallSet<NodeIndex, 16> set;
+  llvm::BitVector set;
 
 public:
-  AndersWorkList() {}
+  AndersWorkList(unsigned numNodes) : set(numNodes) {}
   void enqueue(NodeIndex elem) {
-    if (!set.count(elem)) {
+    if (!set.test(elem)) {
       list.push(elem);
-      set.insert(elem);
+      set.set(elem);
     }
   }
   NodeIndex dequeue() {
     assert(!list.empty() && "Trying to dequeue an empty queue!");
     NodeIndex ret = list.front();
     list.pop();
-    set.erase(ret);
+    set.reset(ret);
     return ret;
   }
   bool isEmpty() const { return list.empty(); }
@@ -361,6 +410,9 @@ void buildConstraintGraph(ConstraintGraph &cGraph,
                           std::vector<AndersConstraint> const &constraints,
                           AndersNodeFactory &nodeFactory,
                           std::map<NodeIndex, AndersPtsSet> &ptsGraph) {
+  // The address-of constraints are grouped by node, so that each points-to
+  // set is built at once rather than one element at a time.
+  std::vector<std::pair<NodeIndex, NodeIndex>> addrOfs;
   for (auto const &c : constraints) {
     NodeIndex srcTgt = nodeFactory.getMergeTarget(c.getSrc());
     NodeIndex dstTgt = nodeFactory.getMergeTarget(c.getDest());
@@ -369,7 +421,7 @@ void buildConstraintGraph(ConstraintGraph &cGraph,
       // We don't want to replace src with srcTgt because, after all, the
       // address of a variable is NOT the same as the address of another
       // variable
-      ptsGraph[dstTgt].insert(c.getSrc());
+      addrOfs.emplace_back(dstTgt, c.getSrc());
       break;
     }
     case AndersConstraint::LOAD: {
@@ -386,6 +438,15 @@ void buildConstraintGraph(ConstraintGraph &cGraph,
     }
     }
   }
+  std::sort(addrOfs.begin(), addrOfs.end());
+  std::vector<unsigned> elements;
+  for (auto itr = addrOfs.begin(), end = addrOfs.end(); itr != end;) {
+    NodeIndex dst = itr->first;
+    elements.clear();
+    for (; itr != end && itr->first == dst; ++itr)
+      elements.push_back(itr->second);
+    ptsGraph[dst].insert(elements);
+  }
 }
 
 class OnlineCycleDetector : public CycleDetector<ConstraintGraph> {
@@ -393,6 +454,7 @@ private:
   AndersNodeFactory &nodeFactory;
   ConstraintGraph &constraintGraph;
   std::map<NodeIndex, AndersPtsSet> &ptsGraph;
+  std::vector<AndersPtsSet> &propagated;
   DenseSet<NodeIndex> const &candidates;
 
   NodeType *getRep(NodeIndex idx) override {
@@ -406,7 +468,8 @@ private:
     // errs() << "Collapse node " << cycleIdx << " with node " << repIdx <<
     // "\n";
 
-    collapseNodes(repIdx, cycleIdx, nodeFactory, ptsGraph, constraintGraph);
+    collapseNodes(repIdx, cycleIdx, nodeFactory, ptsGraph, constraintGraph,
+                  propagated);
   }
   // Specify how to process the rep nodes if a cycle is found
   void processCycleRepNode(NodeType const *node) override {
@@ -416,8 +479,10 @@ private:
 public:
   OnlineCycleDetector(AndersNodeFactory &n, ConstraintGraph &co,
                       std::map<NodeIndex, AndersPtsSet> &p,
+                      std::vector<AndersPtsSet> &pr,
                       DenseSet<NodeIndex> const &ca)
-      : nodeFactory(n), constraintGraph(co), ptsGraph(p), candidates(ca) {}
+      : nodeFactory(n), constraintGraph(co), ptsGraph(p), propagated(pr),
+        candidates(ca) {}
 
   void run() override {
     // Perform cycle detection on for nodes on the candidate list
@@ -428,9 +493,53 @@ public:
 
 } // end of anonymous namespace
 
-/// solveConstraints - This stage iteratively processes the constraints list
-/// propagating constraints (adding edges to the Nodes in the points-to graph)
-/// until a fixed point is reached.
+/// solveConstraints - This stage computes the points-to sets from the
+/// constraints list, using either the sequential solver or the parallel one
+/// (see WavePropagation.cpp).
+/// In the differential mode, both solvers are run and their results must be
+/// the same: as cycle collapsing doesn't lose any precision, they both
+/// compute the least solution of the constraints.
+void Andersen::solveConstraints() {
+  if (!AndersenCheckParallel) {
+    if (AndersenThreads == 1)
+      solveConstraintsSequential();
+    else
+      solveConstraintsParallel(AndersenThreads);
+    return;
+  }
+
+  Andersen Reference(*this);
+  Reference.solveConstraintsSequential();
+  solveConstraintsParallel(AndersenThreads);
+
+  unsigned NumMismatches = 0;
+  for (NodeIndex N = 0, E = nodeFactory.getNumNodes(); N < E; ++N) {
+    AndersPtsSet const *Expected = Reference.findPtsSet(N);
+    AndersPtsSet const *Actual = findPtsSet(N);
+    bool ExpectedEmpty = !Expected || Expected->isEmpty();
+    bool ActualEmpty = !Actual || Actual->isEmpty();
+    if (ExpectedEmpty && ActualEmpty)
+      continue;
+    if (ExpectedEmpty != ActualEmpty || !(*Expected == *Actual)) {
+      errs() << "Error: the parallel Andersen solver found a different "
+             << "points-to set for node " << N << "\n";
+      NumMismatches++;
+    }
+  }
+  if (NumMismatches) {
+    errs() << "Error: " << NumMismatches << " points-to sets differ between "
+           << "the sequential and the parallel Andersen solvers\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+/// solveConstraintsSequential - This stage iteratively processes the
+/// constraints list propagating constraints (adding edges to the Nodes in the
+/// points-to graph) until a fixed point is reached.
+///
+/// Points-to sets are propagated by difference: when a node is processed, only
+/// the elements it got since it was last processed are handled by its complex
+/// constraints and flow along its copy edges.
 ///
 /// We use a variant of the technique called "Lazy Cycle Detection", which is
 /// described in "The Ant and the Grasshopper: Fast and Accurate Pointer
@@ -444,26 +553,51 @@ public:
 /// cycle detect them all at the same time to do this more cheaply.  This
 /// catches cycles slightly later than the original technique did, but does it
 /// make significantly cheaper.
-void Andersen::solveConstraints() {
+void Andersen::solveConstraintsSequential() {
   // We'll do offline HCD first
   OfflineCycleDetector offlineInfo(constraints, nodeFactory);
-  if (EnableHCD)
+  if (EnableHCD) {
+    AndersPhaseStats stats("offline cycle detection");
     offlineInfo.run();
+  }
 
   // Now build the constraint graph
-  ConstraintGraph constraintGraph;
-  buildConstraintGraph(constraintGraph, constraints, nodeFactory, ptsGraph);
-  // The constraint vector is useless now
-  constraints.clear();
+  ConstraintGraph constraintGraph(nodeFactory.getNumNodes());
+  {
+    AndersPhaseStats stats("constraint graph construction");
+    buildConstraintGraph(constraintGraph, constraints, nodeFactory, ptsGraph);
+    // The constraint vector is useless now
+    constraints.clear();
+  }
+  if (AndersenStats)
+    reportAndersSize("constraint graph edges", constraintGraph.getNumEdges(),
+                     constraintGraph.getMemoryUsage());
+
+  AndersPhaseStats stats("propagation");
 
   // We switch between two work lists instead of relying on only one work list
-  AndersWorkList workList1, workList2;
+  AndersWorkList workList1(nodeFactory.getNumNodes()),
+      workList2(nodeFactory.getNumNodes());
   // The "current" and the "next" work list
   AndersWorkList *currWorkList = &workList1, *nextWorkList = &workList2;
   // The set of nodes that LCD believes might be on a cycle
   DenseSet<NodeIndex> cycleCandidates;
   // The set of edges that LCD believes not on a cycle
   DenseSet<std::pair<NodeIndex, NodeIndex>> checkedEdges;
+  // We do difference propagation: only the elements which were added to a
+  // points-to set since the node was last processed flow along its edges.
+  std::vector<AndersPtsSet> propagated(nodeFactory.getNumNodes());
+
+  // A new copy edge only gets the elements that its source will propagate
+  // from now on, so it has to be given the ones propagated so far.
+  auto insertCopyEdge = [&](NodeIndex src, NodeIndex dst) {
+    if (!constraintGraph.insertCopyEdge(src, dst))
+      return;
+    nextWorkList->enqueue(src);
+    AndersPtsSet const &done = propagated[src];
+    if (!done.isEmpty() && ptsGraph[dst].unionWith(done))
+      nextWorkList->enqueue(dst);
+  };
 
   // Scan the node list, add it to work list if the node a representative and
   // can contribute to the calculation right now.
@@ -482,7 +616,7 @@ void Andersen::solveConstraints() {
     if (EnableLCD && !cycleCandidates.empty()) {
       // Detect and collapse cycles online
       OnlineCycleDetector cycleDetector(nodeFactory, constraintGraph, ptsGraph,
-                                        cycleCandidates);
+                                        propagated, cycleCandidates);
       cycleDetector.run();
       cycleCandidates.clear();
     }
@@ -497,122 +631,125 @@ void Andersen::solveConstraints() {
         continue;
 
       auto ptsItr = ptsGraph.find(node);
-      if (ptsItr != ptsGraph.end()) {
-        // Check indirect constraints and add copy edge to the constraint graph
-        // if necessary
-        AndersPtsSet const &ptsSet = ptsItr->second;
-
-        // This is where we perform HCD: check if node has a collapse target,
-        // and if it does, merge them immediately
-        if (EnableHCD) {
-          NodeIndex collapseTarget = offlineInfo.getCollapseTarget(node);
-          if (collapseTarget != AndersNodeFactory::InvalidIndex) {
-            // errs() << "node = " << node << ", collapseTgt = " <<
-            // collapseTarget << "\n";
-            NodeIndex ctRep = nodeFactory.getMergeTarget(collapseTarget);
-            // Here we have to pay special attention to whether the node
-            // points-to itself.
-            bool mergeSelf = false;
-            for (auto v : ptsSet) {
-              NodeIndex vRep = nodeFactory.getMergeTarget(v);
-              if (vRep == node) {
-                mergeSelf = true;
-                continue;
-              }
-              collapseNodes(ctRep, vRep, nodeFactory, ptsGraph,
-                            constraintGraph);
-            }
+      if (ptsItr == ptsGraph.end())
+        continue;
+      // The elements not processed yet. This is a copy, which is cheap and
+      // isn't affected by the collapses below.
+      AndersPtsSet delta = ptsItr->second;
+      delta.subtract(propagated[node]);
+      if (delta.isEmpty())
+        continue;
 
-            if (mergeSelf) {
-              collapseNodes(ctRep, node, nodeFactory, ptsGraph,
-                            constraintGraph);
-              // If the node collapsing succeeds, we can't proceed here because
-              // node no longer exists. Push ctRep to the worklist and proceed
-              if (ctRep != node) {
-                nextWorkList->enqueue(ctRep);
-                continue;
-              }
+      // This is where we perform HCD: check if node has a collapse target,
+      // and if it does, merge them immediately. The elements already
+      // processed have been collapsed then.
+      if (EnableHCD) {
+        NodeIndex collapseTarget = offlineInfo.getCollapseTarget(node);
+        if (collapseTarget != AndersNodeFactory::InvalidIndex) {
+          // errs() << "node = " << node << ", collapseTgt = " <<
+          // collapseTarget << "\n";
+          NodeIndex ctRep = nodeFactory.getMergeTarget(collapseTarget);
+          // Here we have to pay special attention to whether the node
+          // points-to itself.
+          bool mergeSelf = false;
+          for (auto v : delta) {
+            NodeIndex vRep = nodeFactory.getMergeTarget(v);
+            if (vRep == node) {
+              mergeSelf = true;
+              continue;
             }
+            collapseNodes(ctRep, vRep, nodeFactory, ptsGraph, constraintGraph,
+                          propagated);
           }
-        }
 
-        for (auto v : ptsSet) {
-          DenseMap<NodeIndex, NodeIndex> updateMap;
-
-          NodeIndex vRep = nodeFactory.getMergeTarget(v);
-          for (auto const &dst : cNode->loads()) {
-            NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
-            // errs() << "Examining load edge " << node << " -> " << tgtNode <<
-            // "\n";
-            if (constraintGraph.insertCopyEdge(vRep, tgtNode)) {
-              // errs() << "\tInsert copy edge " << v << " -> " << tgtNode <<
-              // "\n";
-              nextWorkList->enqueue(vRep);
+          if (mergeSelf) {
+            collapseNodes(ctRep, node, nodeFactory, ptsGraph, constraintGraph,
+                          propagated);
+            // If the node collapsing succeeds, we can't proceed here because
+            // node no longer exists. Push ctRep to the worklist and proceed
+            if (ctRep != node) {
+              nextWorkList->enqueue(ctRep);
+              continue;
             }
-
-            // If we find that dst has been merged to elsewhere, remember this
-            // fact to update the constraint graph later
-            if (tgtNode != dst)
-              updateMap[dst] = tgtNode;
           }
+          // The collapses may have grown the set of node, or forgotten what
+          // it has propagated.
+          delta = ptsItr->second;
+          delta.subtract(propagated[node]);
+        }
+      }
+      propagated[node] = ptsItr->second;
 
-          // Now perform the load edge updates
-          for (auto const &mapping : updateMap)
-            cNode->replaceLoadEdge(mapping.first, mapping.second);
-          updateMap.clear();
-
-          for (auto const &dst : cNode->stores()) {
-            NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
-            if (constraintGraph.insertCopyEdge(tgtNode, vRep)) {
-              // errs() << "\tInsert copy edge " << tgtNode << " -> " << v <<
-              // "\n";
-              nextWorkList->enqueue(tgtNode);
-            }
+      // Check indirect constraints and add copy edge to the constraint graph
+      // if necessary
+      for (auto v : delta) {
+        DenseMap<NodeIndex, NodeIndex> updateMap;
 
-            // If we find that dst has been merged to elsewhere, remember this
-            // fact to update the constraint graph later
-            if (tgtNode != dst)
-              updateMap[dst] = tgtNode;
-          }
+        NodeIndex vRep = nodeFactory.getMergeTarget(v);
+        for (auto const &dst : cNode->loads()) {
+          NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
+          // errs() << "Examining load edge " << node << " -> " << tgtNode <<
+          // "\n";
+          insertCopyEdge(vRep, tgtNode);
 
-          // Now perform the store edge updates
-          for (auto const &mapping : updateMap)
-            cNode->replaceStoreEdge(mapping.first, mapping.second);
+          // If we find that dst has been merged to elsewhere, remember this
+          // fact to update the constraint graph later
+          if (tgtNode != dst)
+            updateMap[dst] = tgtNode;
         }
 
-        DenseMap<NodeIndex, NodeIndex> updateMap;
-        // Finally, it's time to propagate pts-to info along the copy edges
-        for (auto const &dst : *cNode) {
+        // Now perform the load edge updates
+        for (auto const &mapping : updateMap)
+          cNode->replaceLoadEdge(mapping.first, mapping.second);
+        updateMap.clear();
+
+        for (auto const &dst : cNode->stores()) {
           NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
-          if (node == tgtNode)
-            continue;
-          AndersPtsSet &tgtPtsSet = ptsGraph[tgtNode];
-
-          // errs() << "pts[" << tgtNode << "] |= pts[" << node << "]\n";
-          bool isChanged = tgtPtsSet.unionWith(ptsSet);
-
-          if (isChanged) {
-            nextWorkList->enqueue(tgtNode);
-          } else if (EnableLCD) {
-            // This is where we do lazy cycle detection.
-            // If this is a cycle candidate (equal points-to sets and this
-            // particular edge has not been cycle-checked previously), add to
-            // the list to check for cycles on the next iteration
-            auto edgePair = std::make_pair(node, tgtNode);
-            if (!checkedEdges.count(edgePair) && ptsSet == tgtPtsSet) {
-              checkedEdges.insert(edgePair);
-              cycleCandidates.insert(tgtNode);
-            }
-          }
+          insertCopyEdge(tgtNode, vRep);
 
+          // If we find that dst has been merged to elsewhere, remember this
+          // fact to update the constraint graph later
           if (tgtNode != dst)
             updateMap[dst] = tgtNode;
         }
 
-        // Now perform the copy edge updates
+        // Now perform the store edge updates
         for (auto const &mapping : updateMap)
-          cNode->replaceCopyEdge(mapping.first, mapping.second);
+          cNode->replaceStoreEdge(mapping.first, mapping.second);
       }
+
+      DenseMap<NodeIndex, NodeIndex> updateMap;
+      // Finally, it's time to propagate pts-to info along the copy edges
+      for (auto const &dst : *cNode) {
+        NodeIndex tgtNode = nodeFactory.getMergeTarget(dst);
+        if (node == tgtNode)
+          continue;
+        AndersPtsSet &tgtPtsSet = ptsGraph[tgtNode];
+
+        // errs() << "pts[" << tgtNode << "] |= delta[" << node << "]\n";
+        bool isChanged = tgtPtsSet.unionWith(delta);
+
+        if (isChanged) {
+          nextWorkList->enqueue(tgtNode);
+        } else if (EnableLCD) {
+          // This is where we do lazy cycle detection.
+          // If this is a cycle candidate (equal points-to sets and this
+          // particular edge has not been cycle-checked previously), add to
+          // the list to check for cycles on the next iteration
+          auto edgePair = std::make_pair(node, tgtNode);
+          if (!checkedEdges.count(edgePair) && ptsItr->second == tgtPtsSet) {
+            checkedEdges.insert(edgePair);
+            cycleCandidates.insert(tgtNode);
+          }
+        }
+
+        if (tgtNode != dst)
+          updateMap[dst] = tgtNode;
+      }
+
+      // Now perform the copy edge updates
+      for (auto const &mapping : updateMap)
+        cNode->replaceCopyEdge(mapping.first, mapping.second);
     }
     // Swap the current and the next worklist
     std::swap(currWorkList, nextWorkList);
@@ -1,6 +1,7 @@
 #include "parcoach/andersen/Andersen.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
@@ -59,6 +60,9 @@ static char const *mallocFuncs[] = {"malloc",
                                     "getenv",
                                     "memalign",
                                     "posix_memalign",
+                                    "MPI_Alloc_mem",
+                                    "MPI_Win_allocate",
+                                    "MPI_Win_allocate_shared",
                                     nullptr};
 
 static char const *reallocFuncs[] = {"realloc", "strtok", "strtok_r", nullptr};
@@ -130,12 +134,23 @@ bool Andersen::addConstraintForExternalLibrary(CallBase const &cs,
     // Get the pointer node
     NodeIndex ptrIndex = nodeFactory.getValueNodeFor(inst);
     if (ptrIndex == AndersNodeFactory::InvalidIndex) {
-      // Must be something like posix_memalign()
-      if (f->getName() == "posix_memalign") {
-        ptrIndex = nodeFactory.getValueNodeFor(cs.getArgOperand(0));
+      // Must be something like posix_memalign(), which returns the memory
+      // through a pointer argument
+      int argPos = StringSwitch<int>(f->getName())
+                       .Case("posix_memalign", 0)
+                       .Case("MPI_Alloc_mem", 2)
+                       .Cases("MPI_Win_allocate", "MPI_Win_allocate_shared", 4)
+                       .Default(-1);
+      if (argPos >= 0) {
+        ptrIndex = nodeFactory.getValueNodeFor(cs.getArgOperand(argPos));
         assert(ptrIndex != AndersNodeFactory::InvalidIndex &&
-               "Failed to find arg0 node");
-        constraints.emplace_back(AndersConstraint::STORE, ptrIndex, objIndex);
+               "Failed to find the allocated pointer's node");
+        // The address of the object is stored, through a value pointing to
+        // it.
+        NodeIndex addrIndex = nodeFactory.createValueNode();
+        constraints.emplace_back(AndersConstraint::ADDR_OF, addrIndex,
+                                 objIndex);
+        constraints.emplace_back(AndersConstraint::STORE, ptrIndex, addrIndex);
       } else {
         errs() << f->getName() << '\n';
         assert(false && "unrecognized malloc call");
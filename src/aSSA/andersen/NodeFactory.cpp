@@ -192,16 +192,16 @@ void AndersNodeFactory::mergeNode(NodeIndex N0, NodeIndex N1) {
 
 NodeIndex AndersNodeFactory::getMergeTarget(NodeIndex N) {
   assert(N < nodes.size());
-  NodeIndex Ret = nodes[N].mergeTarget;
-  if (Ret != N) {
-    std::vector<NodeIndex> Path(1, N);
-    while (Ret != nodes[Ret].mergeTarget) {
-      Path.push_back(Ret);
-      Ret = nodes[Ret].mergeTarget;
-    }
-    for (auto Idx : Path) {
-      nodes[Idx].mergeTarget = Ret;
-    }
+  NodeIndex Ret = N;
+  while (Ret != nodes[Ret].mergeTarget) {
+    Ret = nodes[Ret].mergeTarget;
+  }
+  // Compress the path, without any allocation as this is called for every
+  // edge the solver looks at.
+  while (N != Ret) {
+    NodeIndex Next = nodes[N].mergeTarget;
+    nodes[N].mergeTarget = Ret;
+    N = Next;
   }
   assert(Ret < nodes.size());
   return Ret;
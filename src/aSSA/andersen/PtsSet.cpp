@@ -0,0 +1,269 @@
+#include "parcoach/andersen/PtsSet.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <mutex>
+#include <utility>
+
+using namespace llvm;
+
+// The store hash-consing the contents of all the points-to sets.
+// Contents are interned in shards selected by their hash, and memoised unions
+// in shards selected by their operands, each shard having its own lock: this
+// way threads working on distinct sets rarely contend. Computing a union is
+// done outside of any lock.
+class AndersPtsSetStore {
+private:
+  using Data = AndersPtsSetData;
+  using Block = Data::Block;
+  using BlockVector = Data::BlockVector;
+
+  static constexpr unsigned NumShards = 64;
+  // Memoised unions keep their result alive. Past this number of entries, a
+  // shard forgets the unions whose result isn't used anywhere else, and all
+  // of them if that doesn't free half of the shard.
+  static constexpr unsigned MaxMemoisedUnions = 1 << 12;
+
+  struct SetShard {
+    std::mutex mutex;
+    DenseMap<size_t, SmallVector<Data *, 1>> sets;
+  };
+  struct UnionShard {
+    std::mutex mutex;
+    DenseMap<std::pair<uint64_t, uint64_t>, AndersPtsSet> unions;
+  };
+
+  SetShard setShards[NumShards];
+  UnionShard unionShards[NumShards];
+  std::atomic<uint64_t> nextId{1};
+
+  static size_t hashBlocks(BlockVector const &blocks) {
+    hash_code hash = hash_value(blocks.size());
+    for (Block const &b : blocks)
+      hash = hash_combine(hash, b.index, b.bits);
+    return hash;
+  }
+
+  Data *create(size_t hash, BlockVector &&blocks) {
+    unsigned size = 0;
+    for (Block const &b : blocks)
+      size += countPopulation(b.bits);
+    Data *d = new Data(nextId++, hash, size, std::move(blocks));
+    d->refCount.store(1, std::memory_order_relaxed);
+    return d;
+  }
+
+public:
+  static AndersPtsSetStore &get() {
+    // Never destroyed, so that sets may outlive any other static object.
+    static AndersPtsSetStore *store = new AndersPtsSetStore;
+    return *store;
+  }
+
+  // Return the set made of the given blocks, which must be sorted and must
+  // not contain any empty block.
+  AndersPtsSet intern(BlockVector &&blocks) {
+    if (blocks.empty())
+      return AndersPtsSet();
+    size_t hash = hashBlocks(blocks);
+    SetShard &shard = setShards[hash % NumShards];
+    std::scoped_lock lock(shard.mutex);
+    auto &candidates = shard.sets[hash];
+    for (Data *&d : candidates) {
+      if (d->blocks != blocks)
+        continue;
+      // A content whose last reference is being released can't be revived,
+      // it's replaced by a new one instead.
+      unsigned count = d->refCount.load(std::memory_order_relaxed);
+      while (count && !d->refCount.compare_exchange_weak(
+                          count, count + 1, std::memory_order_relaxed))
+        ;
+      if (!count)
+        d = create(hash, std::move(blocks));
+      return AndersPtsSet(d);
+    }
+    Data *d = create(hash, std::move(blocks));
+    candidates.push_back(d);
+    return AndersPtsSet(d);
+  }
+
+  void release(Data const *d) {
+    if (d->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+    SetShard &shard = setShards[d->hash % NumShards];
+    std::scoped_lock lock(shard.mutex);
+    auto itr = shard.sets.find(d->hash);
+    if (itr != shard.sets.end()) {
+      auto &candidates = itr->second;
+      auto pos = llvm::find(candidates, d);
+      if (pos != candidates.end())
+        candidates.erase(pos);
+      if (candidates.empty())
+        shard.sets.erase(itr);
+    }
+    delete d;
+  }
+
+  AndersPtsSet unionOf(AndersPtsSet const &a, AndersPtsSet const &b) {
+    if (b.isEmpty() || a == b)
+      return a;
+    if (a.isEmpty())
+      return b;
+
+    auto key = std::minmax(a.data->id, b.data->id);
+    UnionShard &shard =
+        unionShards[hash_combine(key.first, key.second) % NumShards];
+    {
+      std::scoped_lock lock(shard.mutex);
+      auto itr = shard.unions.find(key);
+      if (itr != shard.unions.end())
+        return itr->second;
+    }
+
+    BlockVector blocks;
+    blocks.reserve(a.data->blocks.size() + b.data->blocks.size());
+    Block const *i = a.blocksBegin(), *ie = a.blocksEnd();
+    Block const *j = b.blocksBegin(), *je = b.blocksEnd();
+    while (i != ie || j != je) {
+      if (j == je || (i != ie && i->index < j->index))
+        blocks.push_back(*i++);
+      else if (i == ie || j->index < i->index)
+        blocks.push_back(*j++);
+      else
+        blocks.push_back({i->index, (i++)->bits | (j++)->bits});
+    }
+    AndersPtsSet result = intern(std::move(blocks));
+
+    // The forgotten unions must be released without holding the lock, as it
+    // may free their results.
+    std::vector<AndersPtsSet> forgotten;
+    DenseMap<std::pair<uint64_t, uint64_t>, AndersPtsSet> forgottenAll;
+    {
+      std::scoped_lock lock(shard.mutex);
+      if (shard.unions.size() >= MaxMemoisedUnions) {
+        for (auto itr = shard.unions.begin(), end = shard.unions.end();
+             itr != end; ++itr) {
+          if (itr->second.data->refCount.load(std::memory_order_relaxed) == 1) {
+            forgotten.push_back(std::move(itr->second));
+            shard.unions.erase(itr);
+          }
+        }
+        if (shard.unions.size() >= MaxMemoisedUnions / 2)
+          std::swap(forgottenAll, shard.unions);
+      }
+      shard.unions.try_emplace(key, result);
+    }
+    return result;
+  }
+
+  size_t getNumDistinctSets(size_t &memory) {
+    size_t count = 0;
+    memory = 0;
+    for (SetShard &shard : setShards) {
+      std::scoped_lock lock(shard.mutex);
+      for (auto const &mapping : shard.sets) {
+        for (Data const *d : mapping.second) {
+          ++count;
+          memory += sizeof(Data) + d->blocks.capacity() * sizeof(Block);
+        }
+      }
+    }
+    return count;
+  }
+};
+
+void AndersPtsSet::reset(Data const *d) {
+  Data const *old = data;
+  data = d;
+  if (old)
+    AndersPtsSetStore::get().release(old);
+}
+
+bool AndersPtsSet::insert(unsigned idx) {
+  if (has(idx))
+    return false;
+  Data::BlockVector blocks(blocksBegin(), blocksEnd());
+  auto pos = llvm::lower_bound(blocks, idx / 64, [](Block const &b, unsigned i) {
+    return b.index < i;
+  });
+  if (pos == blocks.end() || pos->index != idx / 64)
+    pos = blocks.insert(pos, {idx / 64, 0});
+  pos->bits |= uint64_t(1) << (idx % 64);
+  *this = AndersPtsSetStore::get().intern(std::move(blocks));
+  return true;
+}
+
+bool AndersPtsSet::insert(ArrayRef<unsigned> idxs) {
+  SmallVector<unsigned, 16> sorted(idxs.begin(), idxs.end());
+  llvm::sort(sorted);
+  Data::BlockVector blocks;
+  for (unsigned idx : sorted) {
+    if (blocks.empty() || blocks.back().index != idx / 64)
+      blocks.push_back({idx / 64, 0});
+    blocks.back().bits |= uint64_t(1) << (idx % 64);
+  }
+  return unionWith(AndersPtsSetStore::get().intern(std::move(blocks)));
+}
+
+bool AndersPtsSet::contains(AndersPtsSet const &other) const {
+  if (data == other.data)
+    return true;
+  Block const *i = blocksBegin(), *ie = blocksEnd();
+  for (Block const *j = other.blocksBegin(), *je = other.blocksEnd(); j != je;
+       ++j) {
+    while (i != ie && i->index < j->index)
+      ++i;
+    if (i == ie || i->index != j->index || (j->bits & ~i->bits))
+      return false;
+  }
+  return true;
+}
+
+bool AndersPtsSet::intersectWith(AndersPtsSet const &other) const {
+  if (data == other.data)
+    return !isEmpty();
+  Block const *i = blocksBegin(), *ie = blocksEnd();
+  Block const *j = other.blocksBegin(), *je = other.blocksEnd();
+  while (i != ie && j != je) {
+    if (i->index < j->index)
+      ++i;
+    else if (j->index < i->index)
+      ++j;
+    else if ((i++)->bits & (j++)->bits)
+      return true;
+  }
+  return false;
+}
+
+bool AndersPtsSet::unionWith(AndersPtsSet const &other) {
+  AndersPtsSet result = AndersPtsSetStore::get().unionOf(*this, other);
+  if (result == *this)
+    return false;
+  *this = std::move(result);
+  return true;
+}
+
+bool AndersPtsSet::subtract(AndersPtsSet const &other) {
+  if (!intersectWith(other))
+    return false;
+  Data::BlockVector blocks;
+  Block const *j = other.blocksBegin(), *je = other.blocksEnd();
+  for (Block const *i = blocksBegin(), *ie = blocksEnd(); i != ie; ++i) {
+    while (j != je && j->index < i->index)
+      ++j;
+    uint64_t bits = i->bits;
+    if (j != je && j->index == i->index)
+      bits &= ~j->bits;
+    if (bits)
+      blocks.push_back({i->index, bits});
+  }
+  *this = AndersPtsSetStore::get().intern(std::move(blocks));
+  return true;
+}
+
+size_t AndersPtsSet::getNumDistinctSets(size_t &memory) {
+  return AndersPtsSetStore::get().getNumDistinctSets(memory);
+}
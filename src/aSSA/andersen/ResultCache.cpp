@@ -0,0 +1,186 @@
+// This file implements an on-disk cache of the Andersen results.
+//
+// The constraint collection is cheap and deterministic: given the same module
+// it creates the same nodes in the same order. Solving the constraints is the
+// expensive part, so the cache only stores what the solver computes (the node
+// merges and the points-to graph), in a file named after a hash of the module
+// and of the options changing the constraints.
+
+#include "parcoach/andersen/Andersen.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_sha1_ostream.h"
+
+using namespace llvm;
+
+cl::opt<std::string> AndersenCacheDir(
+    "andersen-cache-dir",
+    cl::desc("Directory where the results of the Andersen analysis are cached, "
+             "keyed by a hash of the module"),
+    cl::init(""));
+
+// The offline optimizations and the cycle detections may merge different
+// nodes, which are stored in the cache. The number of threads doesn't change
+// the solution.
+#ifdef ANDERSEN_ENABLE_OPTIMIZATIONS
+extern cl::opt<bool> EnableHVN;
+extern cl::opt<bool> EnableHU;
+#endif
+extern cl::opt<bool> EnableHCD;
+extern cl::opt<bool> EnableLCD;
+
+namespace {
+
+// "ANDS" in little endian.
+constexpr uint32_t CacheMagic = 0x53444e41;
+// Bump this whenever the constraint collection or the solver change what the
+// analysis computes, so that stale results aren't reused.
+constexpr uint32_t CacheVersion = 1;
+
+// Reads the little-endian words of a cache file, failing instead of reading
+// past its end.
+class CacheReader {
+private:
+  char const *cur;
+  char const *end;
+
+public:
+  CacheReader(StringRef buffer) : cur(buffer.begin()), end(buffer.end()) {}
+
+  bool read(uint32_t &value) {
+    if (end - cur < 4)
+      return false;
+    value = support::endian::read32le(cur);
+    cur += 4;
+    return true;
+  }
+  size_t getNumRemainingWords() const { return (end - cur) / 4; }
+  bool atEnd() const { return cur == end; }
+};
+
+void warnCache(StringRef path, std::error_code ec) {
+  errs() << "Warning: could not write the Andersen cache " << path << ": "
+         << ec.message() << "\n";
+}
+
+} // namespace
+
+std::string Andersen::getResultCachePath(Module const &M) {
+  if (AndersenCacheDir.empty())
+    return "";
+  raw_sha1_ostream hash;
+  hash << "andersen-v" << CacheVersion << "\n";
+#ifdef ANDERSEN_ENABLE_OPTIMIZATIONS
+  hash << EnableHVN << EnableHU;
+#endif
+  hash << EnableHCD << EnableLCD << "\n";
+  // Unlike the textual IR, the bitcode doesn't hold the module identifier,
+  // which is the path of the file the module was read from.
+  WriteBitcodeToFile(M, hash);
+  SmallString<128> path(AndersenCacheDir);
+  sys::path::append(path, toHex(hash.sha1(), /*LowerCase=*/true) + ".anders");
+  return std::string(path);
+}
+
+// The file is made of 32-bit little-endian words:
+//   magic, version, number of nodes N,
+//   N merge targets,
+//   number of points-to sets, then for each of them:
+//     node, number of elements, elements.
+bool Andersen::loadResults(StringRef path) {
+  auto bufferOrErr = MemoryBuffer::getFile(path, /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+  if (!bufferOrErr)
+    return false;
+  CacheReader reader((*bufferOrErr)->getBuffer());
+
+  uint32_t magic, version, numNodes;
+  if (!reader.read(magic) || magic != CacheMagic || !reader.read(version) ||
+      version != CacheVersion || !reader.read(numNodes) ||
+      numNodes != nodeFactory.getNumNodes())
+    return false;
+
+  // Nothing is changed until the whole file has been validated.
+  std::vector<NodeIndex> mergeTargets(numNodes);
+  for (NodeIndex &target : mergeTargets)
+    if (!reader.read(target) || target >= numNodes)
+      return false;
+
+  uint32_t numSets;
+  if (!reader.read(numSets))
+    return false;
+  std::map<NodeIndex, AndersPtsSet> sets;
+  std::vector<unsigned> elements;
+  for (uint32_t i = 0; i < numSets; ++i) {
+    uint32_t node, size;
+    if (!reader.read(node) || node >= numNodes || !reader.read(size) ||
+        size > reader.getNumRemainingWords())
+      return false;
+    elements.resize(size);
+    for (unsigned &element : elements)
+      if (!reader.read(element) || element >= numNodes)
+        return false;
+    sets[node].insert(elements);
+  }
+  if (!reader.atEnd())
+    return false;
+
+  for (NodeIndex n = 0; n < numNodes; ++n)
+    if (mergeTargets[n] != n)
+      nodeFactory.mergeNode(mergeTargets[n], n);
+  ptsGraph = std::move(sets);
+  return true;
+}
+
+void Andersen::saveResults(StringRef path) const {
+  if (std::error_code ec = sys::fs::create_directories(AndersenCacheDir)) {
+    warnCache(path, ec);
+    return;
+  }
+
+  // Write to a temporary file renamed once complete, so that concurrent runs
+  // never see a partial file.
+  SmallString<128> tmpPath;
+  int fd;
+  if (std::error_code ec =
+          sys::fs::createUniqueFile(path + ".tmp-%%%%%%", fd, tmpPath)) {
+    warnCache(path, ec);
+    return;
+  }
+  {
+    raw_fd_ostream os(fd, /*shouldClose=*/true);
+    support::endian::Writer writer(os, support::little);
+    unsigned numNodes = nodeFactory.getNumNodes();
+    writer.write<uint32_t>(CacheMagic);
+    writer.write<uint32_t>(CacheVersion);
+    writer.write<uint32_t>(numNodes);
+    for (NodeIndex n = 0; n < numNodes; ++n)
+      writer.write<uint32_t>(nodeFactory.getMergeTarget(n));
+    writer.write<uint32_t>(ptsGraph.size());
+    for (auto const &mapping : ptsGraph) {
+      writer.write<uint32_t>(mapping.first);
+      writer.write<uint32_t>(mapping.second.getSize());
+      for (auto v : mapping.second)
+        writer.write<uint32_t>(v);
+    }
+    os.close();
+    if (os.has_error()) {
+      warnCache(path, os.error());
+      os.clear_error();
+      sys::fs::remove(tmpPath);
+      return;
+    }
+  }
+  if (std::error_code ec = sys::fs::rename(tmpPath, path)) {
+    warnCache(path, ec);
+    sys::fs::remove(tmpPath);
+  }
+}
@@ -0,0 +1,361 @@
+#include "parcoach/andersen/Andersen.h"
+#include "parcoach/andersen/Stats.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace llvm;
+
+namespace {
+
+// A parallel constraint solver, based on the technique described in "Wave
+// Propagation and Deep Propagation for Pointer Analysis. In Code Generation
+// and Optimization (CGO), March 2009."
+// Each round collapses the cycles of the copy graph, propagates the points-to
+// sets along the (now acyclic) copy edges in topological order, and then adds
+// the copy edges implied by the load and store constraints. The solver stops
+// once a round doesn't add any new edge.
+// The nodes at the same depth of the acyclic copy graph don't depend on each
+// other: each of them pulls the points-to sets of its predecessors, which are
+// all at a lower depth, and only writes its own points-to set, so that they
+// can be processed concurrently without any lock. The load and store
+// constraints are processed concurrently as well, the copy edges they imply
+// being collected per task and merged into the graph afterwards.
+class WavePropagationSolver {
+  using EdgeList = SmallVector<NodeIndex, 4>;
+
+  static constexpr unsigned Unvisited = std::numeric_limits<unsigned>::max();
+  // Below this number of nodes, a batch of work isn't worth being split.
+  static constexpr size_t MinChunkSize = 256;
+
+  AndersNodeFactory &nodeFactory;
+  ThreadPool Pool;
+  unsigned NumNodes;
+
+  // The representative of each node. Only representatives have points-to
+  // sets and edges, and each entry directly refers to a representative
+  // outside of cycle collapsing.
+  std::vector<NodeIndex> Rep;
+  std::vector<AndersPtsSet> Pts;
+  // The part of each points-to set its load and store constraints have
+  // already been processed for.
+  std::vector<AndersPtsSet> Handled;
+  // The copy edges, sorted.
+  std::vector<EdgeList> Succs, Preds;
+  // For each node n, the nodes d such that d = *n.
+  std::vector<EdgeList> Loads;
+  // For each node n, the nodes s such that *n = s.
+  std::vector<EdgeList> Stores;
+  // Set if the points-to set changed since the successors last pulled it.
+  // These are bytes rather than a vector<bool>, so that distinct nodes can be
+  // written concurrently.
+  std::vector<uint8_t> Dirty;
+  // Set if the node has new incoming edges, and must pull all its
+  // predecessors.
+  std::vector<uint8_t> NewIn;
+  // The representatives having predecessors, grouped by depth.
+  std::vector<std::vector<NodeIndex>> Levels;
+
+  NodeIndex find(NodeIndex N) const {
+    while (Rep[N] != N)
+      N = Rep[N];
+    return N;
+  }
+
+  // Call F(Begin, End, Chunk) on chunks of [0, Size), concurrently when it's
+  // worth it, and return the number of chunks.
+  template <typename Fn> size_t forEachChunk(size_t Size, Fn &&F) {
+    size_t NumChunks =
+        std::min<size_t>(Pool.getThreadCount() * 4,
+                         (Size + MinChunkSize - 1) / MinChunkSize);
+    if (NumChunks <= 1) {
+      F(0, Size, 0);
+      return 1;
+    }
+    size_t ChunkSize = (Size + NumChunks - 1) / NumChunks;
+    for (size_t Chunk = 0; Chunk < NumChunks; Chunk++) {
+      size_t Begin = Chunk * ChunkSize;
+      size_t End = std::min(Size, Begin + ChunkSize);
+      Pool.async([&F, Begin, End, Chunk] { F(Begin, End, Chunk); });
+    }
+    Pool.wait();
+    return NumChunks;
+  }
+
+  static bool insertEdge(EdgeList &Edges, NodeIndex N) {
+    auto It = std::lower_bound(Edges.begin(), Edges.end(), N);
+    if (It != Edges.end() && *It == N)
+      return false;
+    Edges.insert(It, N);
+    return true;
+  }
+
+  // Map the edges to the current representatives, and remove the duplicates
+  // and the self loops.
+  void normalizeEdges(NodeIndex N, EdgeList &Edges, bool RemoveSelf) {
+    for (auto &Dst : Edges)
+      Dst = Rep[Dst];
+    llvm::sort(Edges);
+    Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+    if (RemoveSelf) {
+      auto It = std::lower_bound(Edges.begin(), Edges.end(), N);
+      if (It != Edges.end() && *It == N)
+        Edges.erase(It);
+    }
+  }
+
+  void collapse(NodeIndex Dst, NodeIndex Src) {
+    nodeFactory.mergeNode(Dst, Src);
+    Rep[Src] = Dst;
+    Pts[Dst].unionWith(Pts[Src]);
+    Pts[Src].clear();
+    // The load and store constraints coming from Src haven't been processed
+    // for the points-to set of Dst.
+    Handled[Dst].clear();
+    Handled[Src].clear();
+    auto Append = [](EdgeList &To, EdgeList &From) {
+      To.append(From.begin(), From.end());
+      From.clear();
+    };
+    Append(Succs[Dst], Succs[Src]);
+    Append(Loads[Dst], Loads[Src]);
+    Append(Stores[Dst], Stores[Src]);
+    // Dst has both new predecessors and new successors.
+    NewIn[Dst] = true;
+    Dirty[Dst] = true;
+  }
+
+  // Collapse the cycles of the copy graph, and group the remaining nodes by
+  // depth in the acyclic graph.
+  void collapseCycles() {
+    // This is Tarjan's algorithm, made iterative because the copy chains can
+    // be very long. It finds the SCCs in reverse topological order.
+    std::vector<unsigned> Index(NumNodes, Unvisited), Low(NumNodes);
+    std::vector<uint8_t> OnStack(NumNodes);
+    std::vector<NodeIndex> Stack, Order;
+    std::vector<std::pair<NodeIndex, unsigned>> Visit;
+    unsigned Timestamp = 0;
+    for (NodeIndex Root = 0; Root < NumNodes; Root++) {
+      if (Rep[Root] != Root || Index[Root] != Unvisited)
+        continue;
+      Visit.emplace_back(Root, 0);
+      while (!Visit.empty()) {
+        auto &[N, NextSucc] = Visit.back();
+        if (NextSucc == 0) {
+          Index[N] = Low[N] = Timestamp++;
+          Stack.push_back(N);
+          OnStack[N] = true;
+        }
+        if (NextSucc < Succs[N].size()) {
+          NodeIndex S = Succs[N][NextSucc++];
+          if (Index[S] == Unvisited)
+            Visit.emplace_back(S, 0);
+          else if (OnStack[S])
+            Low[N] = std::min(Low[N], Index[S]);
+          continue;
+        }
+        NodeIndex Done = N;
+        Visit.pop_back();
+        if (!Visit.empty())
+          Low[Visit.back().first] =
+              std::min(Low[Visit.back().first], Low[Done]);
+        if (Low[Done] != Index[Done])
+          continue;
+        // Done is the root of an SCC: merge it into its smallest node, so
+        // that the result doesn't depend on the visit order.
+        auto SCCBegin =
+            std::find(Stack.rbegin(), Stack.rend(), Done).base() - 1;
+        NodeIndex SCCRep = *std::min_element(SCCBegin, Stack.end());
+        for (auto It = SCCBegin; It != Stack.end(); ++It) {
+          OnStack[*It] = false;
+          if (*It != SCCRep)
+            collapse(SCCRep, *It);
+        }
+        Stack.erase(SCCBegin, Stack.end());
+        Order.push_back(SCCRep);
+      }
+    }
+
+    for (NodeIndex N = 0; N < NumNodes; N++)
+      Rep[N] = find(N);
+    for (NodeIndex N = 0; N < NumNodes; N++) {
+      Preds[N].clear();
+      if (Rep[N] != N)
+        continue;
+      normalizeEdges(N, Succs[N], true);
+      normalizeEdges(N, Loads[N], false);
+      normalizeEdges(N, Stores[N], false);
+    }
+    for (NodeIndex N = 0; N < NumNodes; N++)
+      for (NodeIndex S : Succs[N])
+        Preds[S].push_back(N);
+
+    // Order holds the SCCs in reverse topological order.
+    std::vector<unsigned> Depth(NumNodes);
+    Levels.clear();
+    for (auto It = Order.rbegin(); It != Order.rend(); ++It) {
+      NodeIndex N = *It;
+      if (!Preds[N].empty()) {
+        if (Levels.size() < Depth[N])
+          Levels.resize(Depth[N]);
+        Levels[Depth[N] - 1].push_back(N);
+      }
+      for (NodeIndex S : Succs[N])
+        Depth[S] = std::max(Depth[S], Depth[N] + 1);
+    }
+  }
+
+  // Propagate the points-to sets along the copy edges, one depth at a time.
+  void propagate() {
+    for (auto const &Level : Levels) {
+      forEachChunk(Level.size(), [&](size_t Begin, size_t End, size_t) {
+        for (size_t I = Begin; I < End; I++) {
+          NodeIndex N = Level[I];
+          bool Changed = false;
+          for (NodeIndex P : Preds[N])
+            if (NewIn[N] || Dirty[P])
+              Changed |= Pts[N].unionWith(Pts[P]);
+          if (Changed)
+            Dirty[N] = true;
+        }
+      });
+    }
+    std::fill(Dirty.begin(), Dirty.end(), false);
+    std::fill(NewIn.begin(), NewIn.end(), false);
+  }
+
+  // Add the copy edges implied by the load and store constraints, and return
+  // true if there was any new one.
+  bool addComplexEdges() {
+    std::vector<NodeIndex> Todo;
+    for (NodeIndex N = 0; N < NumNodes; N++)
+      if (Rep[N] == N && (!Loads[N].empty() || !Stores[N].empty()) &&
+          !Handled[N].contains(Pts[N]))
+        Todo.push_back(N);
+
+    std::vector<std::vector<std::pair<NodeIndex, NodeIndex>>> NewEdges(
+        Pool.getThreadCount() * 4);
+    size_t NumChunks =
+        forEachChunk(Todo.size(), [&](size_t Begin, size_t End, size_t Chunk) {
+          auto &Edges = NewEdges[Chunk];
+          for (size_t I = Begin; I < End; I++) {
+            NodeIndex N = Todo[I];
+            AndersPtsSet Delta = Pts[N];
+            Delta.subtract(Handled[N]);
+            Handled[N] = Pts[N];
+            for (NodeIndex V : Delta) {
+              NodeIndex VRep = Rep[V];
+              for (NodeIndex Dst : Loads[N])
+                Edges.emplace_back(VRep, Dst);
+              for (NodeIndex Src : Stores[N])
+                Edges.emplace_back(Src, VRep);
+            }
+          }
+        });
+
+    bool Added = false;
+    for (size_t Chunk = 0; Chunk < NumChunks; Chunk++) {
+      for (auto [Src, Dst] : NewEdges[Chunk]) {
+        if (Src != Dst && insertEdge(Succs[Src], Dst)) {
+          NewIn[Dst] = true;
+          Added = true;
+        }
+      }
+    }
+    return Added;
+  }
+
+public:
+  WavePropagationSolver(AndersNodeFactory &nodeFactory, unsigned Threads)
+      : nodeFactory(nodeFactory), Pool(hardware_concurrency(Threads)),
+        NumNodes(nodeFactory.getNumNodes()), Rep(NumNodes), Pts(NumNodes),
+        Handled(NumNodes), Succs(NumNodes), Preds(NumNodes), Loads(NumNodes),
+        Stores(NumNodes), Dirty(NumNodes), NewIn(NumNodes) {
+    for (NodeIndex N = 0; N < NumNodes; N++)
+      Rep[N] = nodeFactory.getMergeTarget(N);
+  }
+
+  void addConstraints(std::vector<AndersConstraint> const &constraints) {
+    // The address-of constraints are grouped by node, so that each points-to
+    // set is built at once rather than one element at a time.
+    std::vector<std::pair<NodeIndex, NodeIndex>> AddrOfs;
+    for (auto const &c : constraints)
+      addConstraint(c, AddrOfs);
+    std::sort(AddrOfs.begin(), AddrOfs.end());
+    std::vector<unsigned> Elements;
+    for (auto It = AddrOfs.begin(), End = AddrOfs.end(); It != End;) {
+      NodeIndex Dst = It->first;
+      Elements.clear();
+      for (; It != End && It->first == Dst; ++It)
+        Elements.push_back(It->second);
+      Pts[Dst].insert(Elements);
+      Dirty[Dst] = true;
+    }
+  }
+
+  void addConstraint(AndersConstraint const &c,
+                     std::vector<std::pair<NodeIndex, NodeIndex>> &AddrOfs) {
+    NodeIndex srcTgt = Rep[c.getSrc()];
+    NodeIndex dstTgt = Rep[c.getDest()];
+    switch (c.getType()) {
+    case AndersConstraint::ADDR_OF:
+      // As in the sequential solver, the address of a variable is not the
+      // address of its merge target.
+      AddrOfs.emplace_back(dstTgt, c.getSrc());
+      break;
+    case AndersConstraint::LOAD:
+      Loads[srcTgt].push_back(dstTgt);
+      break;
+    case AndersConstraint::STORE:
+      Stores[dstTgt].push_back(srcTgt);
+      break;
+    case AndersConstraint::COPY:
+      if (srcTgt != dstTgt)
+        Succs[srcTgt].push_back(dstTgt);
+      break;
+    }
+  }
+
+  void solve() {
+    unsigned Rounds = 0;
+    do {
+      collapseCycles();
+      propagate();
+      Rounds++;
+    } while (addComplexEdges());
+    if (AndersenStats) {
+      size_t NumEdges = 0, Memory = 0;
+      for (auto const *Edges : {&Succs, &Preds, &Loads, &Stores}) {
+        for (EdgeList const &List : *Edges) {
+          NumEdges += List.size();
+          Memory += sizeof(List) + capacity_in_bytes(List);
+        }
+      }
+      reportAndersSize("constraint graph edges", NumEdges, Memory);
+      errs() << "andersen: " << Rounds << " wave propagation rounds\n";
+    }
+  }
+
+  void getResults(std::map<NodeIndex, AndersPtsSet> &ptsGraph) {
+    ptsGraph.clear();
+    for (NodeIndex N = 0; N < NumNodes; N++)
+      if (Rep[N] == N && !Pts[N].isEmpty())
+        ptsGraph.emplace(N, std::move(Pts[N]));
+  }
+};
+
+} // end of anonymous namespace
+
+void Andersen::solveConstraintsParallel(unsigned Threads) {
+  WavePropagationSolver Solver(nodeFactory, Threads);
+  Solver.addConstraints(constraints);
+  // The constraint vector is useless now
+  constraints.clear();
+  Solver.solve();
+  Solver.getResults(ptsGraph);
+}
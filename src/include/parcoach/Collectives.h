@@ -42,6 +42,7 @@ struct Collective {
   Paradigm getParadigm() const { return P_; }
   static bool isCollective(llvm::Function const &);
   static Collective const *find(llvm::Function const &);
+  static Collective const *find(llvm::StringRef Name);
   Collective(Collective const &) = default;
 
 protected:
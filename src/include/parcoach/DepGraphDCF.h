@@ -2,8 +2,12 @@
 
 #include "parcoach/MemorySSA.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/InstVisitor.h"
 
+#include <algorithm>
 #include <optional>
 
 class PTACallGraphNode;
@@ -21,8 +25,9 @@ public:
 
   DepGraphDCF(parcoach::MemorySSA *mssa, PTACallGraph const &CG,
               llvm::FunctionAnalysisManager &AM, llvm::Module &M,
-              bool ContextInsensitive, bool noPtrDep = false,
-              bool noPred = false, bool disablePhiElim = false);
+              bool ContextInsensitive, bool DemandDriven = false,
+              bool noPtrDep = false, bool noPred = false,
+              bool disablePhiElim = false);
   virtual ~DepGraphDCF();
 
   void toDot(llvm::StringRef filename) const;
@@ -53,11 +58,25 @@ public:
   void visitTerminator(llvm::Instruction &I);
   static void visitInstruction(llvm::Instruction &I);
 
-  bool isTaintedValue(llvm::Value const *v) const;
+  // In the demand-driven mode, the query builds the part of the graph it
+  // needs.
+  bool isTaintedValue(llvm::Value const *v);
+  // Whether the whole graph is built and flooded regardless of the calling
+  // contexts, in which case the taint of any value is known.
+  bool isContextInsensitive() const {
+    return ContextInsensitive && !DemandDriven;
+  }
 
   void getCallInterIPDF(llvm::CallInst const *call,
                         std::set<llvm::BasicBlock const *> &ipdf) const;
 
+  // Add to ArgNos the parameters of F the given values depend on, through the
+  // edges the taint flows along. Not available in the demand-driven mode, in
+  // which the graph is partial.
+  void getArgumentDependencies(llvm::Function const &F,
+                               llvm::ArrayRef<llvm::Value const *> Values,
+                               std::set<int> &ArgNos) const;
+
 private:
   void build();
   void buildFunction(llvm::Function const *F);
@@ -71,11 +90,29 @@ private:
   // else
   //   a = 0;
   void phiElimination();
+  void eliminatePhis(llvm::Function const &F);
 
   void computeTaintedValuesContextInsensitive();
+  // Flood the whole graph from the sources, in the context-insensitive mode.
+  void floodSequentially();
+  void floodInParallel();
   void computeTaintedValuesContextSensitive();
   void computeTaintedValuesCSForEntry(PTACallGraphNode const *entry);
 
+  // Demand-driven mode: instead of flooding the whole graph from the sources,
+  // a query walks the graph backward from the value to a source, with the
+  // result of the context-insensitive mode. The graph of a function is only
+  // built once the walk reaches its nodes, along with the graph of its
+  // callers which connect them to the call sites.
+  void computeCallSites();
+  void buildFunctionOnDemand(llvm::Function const *F);
+  void eliminatePhisOnDemand(llvm::Function const *F);
+  void prepareParents(llvm::Function const *F);
+  void prepareParents(MSSAVar const *V);
+  bool computeTaintOnDemand(llvm::Value const *V);
+  static llvm::Function const *getNodeFunction(llvm::Value const *V);
+  static llvm::Function const *getNodeFunction(MSSAVar const *V);
+
   parcoach::MemorySSA *mssa;
   PTACallGraph const &CG;
 
@@ -83,6 +120,7 @@ private:
   llvm::FunctionAnalysisManager &FAM;
   llvm::Module const &M;
   bool const ContextInsensitive;
+  bool const DemandDriven;
   llvm::PostDominatorTree *PDT;
 
   /* Graph nodes */
@@ -138,13 +176,63 @@ private:
   // map from a callsite to all its conditions.
   llvm::ValueMap<llvm::Value const *, ValueSet> callsiteToConds;
 
+  /* Frozen graph */
+
+  // Once built, the graph is frozen into a compressed sparse row layout in
+  // which the taint is propagated. The nodes get dense ids, and the children of
+  // node I are childIds[childOffsets[I]..childOffsets[I + 1]).
+  void freezeGraph();
+
+  // The nodes which belong to a function. The nodes which only belong to this
+  // function have contiguous ids, the ones shared with other functions (e.g.
+  // globals) are listed apart.
+  struct FunctionNodes {
+    unsigned Begin{};
+    unsigned End{};
+    std::vector<unsigned> Shared; // Sorted.
+
+    bool contains(unsigned Id) const {
+      return (Id >= Begin && Id < End) ||
+             std::binary_search(Shared.begin(), Shared.end(), Id);
+    }
+
+    template <typename FnTy> void forEach(FnTy Fn) const {
+      for (unsigned Id = Begin; Id < End; Id++) {
+        Fn(Id);
+      }
+      for (unsigned Id : Shared) {
+        Fn(Id);
+      }
+    }
+  };
+  FunctionNodes const &getFunctionNodes(llvm::Function const *F) const;
+
+  llvm::DenseMap<llvm::Value const *, unsigned> llvmNodeIds;
+  llvm::DenseMap<MSSAVar const *, unsigned> ssaNodeIds;
+  // The value of each node, nullptr for the address-taken ssa nodes.
+  std::vector<llvm::Value const *> idToLLVMNode;
+  std::vector<unsigned> childOffsets;
+  std::vector<unsigned> childIds;
+  llvm::DenseMap<llvm::Function const *, FunctionNodes> funcToNodes;
+
+  llvm::ArrayRef<unsigned> getChildren(unsigned Id) const {
+    return llvm::ArrayRef<unsigned>(childIds).slice(
+        childOffsets[Id], childOffsets[Id + 1] - childOffsets[Id]);
+  }
+  bool isSSANode(unsigned Id) const { return !idToLLVMNode[Id]; }
+
   /* tainted nodes */
-  ValueSet taintedLLVMNodes;
-  ConstVarSet taintedSSANodes;
+  llvm::BitVector taintedNodes;
+  bool isTainted(llvm::Value const *V) const;
+  bool isTainted(MSSAVar const *V) const;
 
   ConstVarSet taintResetSSANodes;
   ConstVarSet ssaSources;
   ValueSet valueSources;
+  // The same nodes in the frozen graph.
+  llvm::BitVector taintResetNodes;
+  std::vector<unsigned> ssaSourceIds;
+  std::vector<unsigned> valueSourceIds;
 
   void floodFunction(llvm::Function const *F);
   void floodFunctionFromFunction(llvm::Function const *to,
@@ -153,6 +241,17 @@ private:
   void computeFunctionCSTaintedConds(llvm::Function const *F);
   ValueSet taintedConditions;
 
+  // Flooding a function only reads and writes the taint of its own nodes: its
+  // result is summarized for each taint of these nodes it starts from. The
+  // context-sensitive traversal floods a function each time it enters or
+  // returns to it, and most of these floods start from a taint seen before.
+  using TaintSummaryMap = llvm::DenseMap<llvm::BitVector, llvm::BitVector>;
+  llvm::DenseMap<llvm::Function const *, TaintSummaryMap> taintSummaries;
+  llvm::BitVector getFunctionTaint(FunctionNodes const &Nodes) const;
+  void setFunctionTaint(FunctionNodes const &Nodes,
+                        llvm::BitVector const &Taint);
+  void floodFunctionWithSummary(llvm::Function const *F);
+
   /* Graph construction for call sites*/
   void connectCSMus(llvm::CallInst &I);
   void connectCSChis(llvm::CallInst &I);
@@ -164,7 +263,7 @@ private:
 
   // Two nodes are equivalent if they have exactly the same incoming and
   // outgoing edges and if none of them are phi nodes.
-  bool areSSANodesEquivalent(MSSAVar *var1, MSSAVar *var2);
+  bool areSSANodesEquivalent(MSSAVar *var1, MSSAVar *var2) const;
 
   // This function replaces phi with op1 and removes op2.
   void eliminatePhi(MSSAPhi *phi, std::vector<MSSAVar *> ops);
@@ -197,6 +296,18 @@ private:
   bool noPtrDep;
   bool noPred;
   bool disablePhiElim;
+
+  /* demand-driven mode */
+  llvm::DenseMap<llvm::Function const *, unsigned> funcToModuleIndex;
+  // The caller of the call site of each node of an external function.
+  llvm::DenseMap<MSSAVar const *, llvm::Function const *> extNodeToCaller;
+  llvm::DenseSet<llvm::Function const *> builtFunctions;
+  llvm::DenseSet<llvm::Function const *> phiEliminatedFunctions;
+  // The functions whose nodes have all their parents in the graph.
+  llvm::DenseSet<llvm::Function const *> preparedFunctions;
+  llvm::DenseMap<llvm::Value const *, bool> demandedValues;
+  llvm::DenseSet<llvm::Value const *> untaintedLLVMNodes;
+  llvm::DenseSet<MSSAVar const *> untaintedSSANodes;
 };
 
 class DepGraphDCFAnalysis
@@ -204,10 +315,11 @@ class DepGraphDCFAnalysis
   friend llvm::AnalysisInfoMixin<DepGraphDCFAnalysis>;
   static llvm::AnalysisKey Key;
   bool ContextInsensitive_;
+  bool DemandDriven_;
 
 public:
-  DepGraphDCFAnalysis(bool ContextInsensitive)
-      : ContextInsensitive_(ContextInsensitive){};
+  DepGraphDCFAnalysis(bool ContextInsensitive, bool DemandDriven = false)
+      : ContextInsensitive_(ContextInsensitive), DemandDriven_(DemandDriven){};
   // We return a unique_ptr to ensure stability of the analysis' internal state.
   using Result = std::unique_ptr<DepGraphDCF>;
   Result run(llvm::Module &M, llvm::ModuleAnalysisManager &);
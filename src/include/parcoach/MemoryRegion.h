@@ -3,6 +3,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Allocator.h"
 
 #include <map>
 #include <set>
@@ -30,8 +31,9 @@ using FunctionToValueSetMap =
     llvm::ValueMap<llvm::Function const *, std::set<llvm::Value const *>>;
 
 class MemReg {
-  llvm::ValueMap<llvm::Value const *, std::unique_ptr<MemRegEntry>>
-      valueToRegMap;
+  // Owns the regions, which are freed together with the MemReg.
+  llvm::SpecificBumpPtrAllocator<MemRegEntry> regionAllocator;
+  llvm::ValueMap<llvm::Value const *, MemRegEntry *> valueToRegMap;
   MemRegSet sharedCudaRegions;
   FunctionToMemRegSetMap func2SharedOmpRegs;
 
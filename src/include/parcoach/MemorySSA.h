@@ -12,6 +12,7 @@
 
 class DepGraphDCF;
 class PTACallGraph;
+class MSSAAllocator;
 class MSSAMu;
 class MSSAChi;
 class MSSAPhi;
@@ -26,9 +27,9 @@ class ModRefAnalysisResult;
 class MemorySSA {
 
   // Containers for Mu,Chi,Phi,BB and Values
-  using MuOwnerSet = std::vector<std::unique_ptr<MSSAMu>>;
-  using ChiOwnerSet = std::vector<std::unique_ptr<MSSAChi>>;
-  using PhiOwnerSet = std::vector<std::unique_ptr<MSSAPhi>>;
+  using MuList = std::vector<MSSAMu *>;
+  using ChiList = std::vector<MSSAChi *>;
+  using PhiList = std::vector<MSSAPhi *>;
   using MuSet = std::set<MSSAMu *>;
   using ChiSet = std::set<MSSAChi *>;
   using PhiSet = std::set<MSSAPhi *>;
@@ -36,25 +37,25 @@ class MemorySSA {
   using ValueSet = std::set<llvm::Value const *>;
 
   // Chi and Mu annotations
-  using LoadToMuMap = llvm::ValueMap<llvm::LoadInst const *, MuOwnerSet>;
-  using StoreToChiMap = llvm::ValueMap<llvm::StoreInst const *, ChiOwnerSet>;
-  using CallSiteToMuSetMap = llvm::ValueMap<llvm::CallBase const *, MuOwnerSet>;
-  using CallSiteToChiSetMap = llvm::ValueMap<llvm::CallBase *, ChiOwnerSet>;
+  using LoadToMuMap = llvm::ValueMap<llvm::LoadInst const *, MuList>;
+  using StoreToChiMap = llvm::ValueMap<llvm::StoreInst const *, ChiList>;
+  using CallSiteToMuSetMap = llvm::ValueMap<llvm::CallBase const *, MuList>;
+  using CallSiteToChiSetMap = llvm::ValueMap<llvm::CallBase *, ChiList>;
   using FuncCallSiteToChiMap =
       llvm::ValueMap<llvm::Function const *,
-                     std::map<llvm::CallBase *, std::unique_ptr<MSSAChi>>>;
+                     std::map<llvm::CallBase *, MSSAChi *>>;
   using FuncCallSiteToArgChiMap =
       llvm::ValueMap<llvm::Function const *,
                      std::map<llvm::CallBase *, std::map<unsigned, MSSAChi *>>>;
 
   // Phis
-  using BBToPhiMap = llvm::ValueMap<llvm::BasicBlock const *, PhiOwnerSet>;
+  using BBToPhiMap = llvm::ValueMap<llvm::BasicBlock const *, PhiList>;
   using MemRegToBBMap = std::map<MemRegEntry *, BBSet>;
   using LLVMPhiToPredMap = llvm::ValueMap<llvm::PHINode const *, ValueSet>;
 
   // Map functions to entry Chi set and return Mu set
-  using FunToEntryChiMap = llvm::ValueMap<llvm::Function const *, ChiOwnerSet>;
-  using FunToReturnMuMap = llvm::ValueMap<llvm::Function const *, MuOwnerSet>;
+  using FunToEntryChiMap = llvm::ValueMap<llvm::Function const *, ChiList>;
+  using FunToReturnMuMap = llvm::ValueMap<llvm::Function const *, MuList>;
 
   using FunRegToEntryChiMap =
       llvm::ValueMap<llvm::Function const *,
@@ -75,39 +76,14 @@ public:
   virtual ~MemorySSA();
 
 private:
+  // Builds the memory SSA of a single function, see MemorySSA.cpp.
+  class FunctionBuilder;
+
   void dumpMSSA(llvm::Function const *F);
 
   void buildSSA(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
-  void buildSSA(llvm::Function const *F, llvm::DominatorTree &DT,
-                llvm::DominanceFrontier &DF, llvm::PostDominatorTree &PDT);
-
-  void createArtificalChiForCalledFunction(llvm::CallBase *CB,
-                                           llvm::Function const *callee);
-
-  void computeMuChi(llvm::Function const *F);
-
-  void computeMuChiForCalledFunction(llvm::CallBase *inst,
-                                     llvm::Function *callee);
-
-  // The three following functions generate SSA from mu/chi by implementing the
-  // algorithm from the paper:
-  // R. Cytron, J. Ferrante, B. K. Rosen, M. N. Wegman, and F. K.
-  // Zadeck, “Efficiently computing static single assignment form and
-  // the control dependence graph,” ACM Trans. Program. Lang. Syst.,
-  // vol. 13, no. 4, pp. 451–490, Oct. 1991.
-  // http://doi.acm.org/10.1145/115372.115320
-  void computePhi(llvm::Function const *F);
-  void rename(llvm::Function const *F);
-  void renameBB(llvm::Function const *F, llvm::BasicBlock const *X,
-                std::map<MemRegEntry *, unsigned> &C,
-                std::map<MemRegEntry *, std::vector<MSSAVar *>> &S);
-
-  void computePhiPredicates(llvm::Function const *F);
-  void computeLLVMPhiPredicates(llvm::PHINode const *phi);
-  void computeMSSAPhiPredicates(MSSAPhi *phi);
-
-  static unsigned whichPred(llvm::BasicBlock const *pred,
-                            llvm::BasicBlock const *succ);
+  // Add the mus, chis and phis created by the builder.
+  void addFunction(FunctionBuilder &Builder);
 
 protected:
   Andersen const &PTA;
@@ -116,12 +92,6 @@ protected:
   ModRefAnalysisResult *MRA;
   ExtInfo const &extInfo;
 
-  llvm::DominanceFrontier *curDF;
-  llvm::DominatorTree *curDT;
-  llvm::PostDominatorTree *curPDT;
-  MemRegSet usedRegs;
-  MemRegToBBMap regDefToBBMap;
-
   LoadToMuMap loadToMuMap;
   StoreToChiMap storeToChiMap;
   CallSiteToMuSetMap callSiteToMuMap;
@@ -141,10 +111,10 @@ protected:
   FuncCallSiteToChiMap extCallSiteToVarArgExitChi;
   FuncCallSiteToArgChiMap extCallSiteToArgEntryChi;
   FuncCallSiteToArgChiMap extCallSiteToArgExitChi;
-  // Owner of chis allocated in the 2 ArgChi maps above; the data structure
-  // makes it impossible to hold the unique_ptr in a map in a map in a map...
-  ChiOwnerSet AllocatedArgChi;
   FuncToCallBaseSet extFuncToCSMap;
+  // Own all the mus, chis, phis and variables above, one allocator per thread
+  // which built some functions.
+  std::vector<std::unique_ptr<MSSAAllocator>> Allocators;
 
 public:
   auto const &getLoadToMuMap() const { return loadToMuMap; }
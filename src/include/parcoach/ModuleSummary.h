@@ -0,0 +1,95 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Error.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Function;
+class raw_ostream;
+} // namespace llvm
+
+namespace parcoach {
+
+// Module summaries let the collective checking cross translation units: each
+// compilation describes the functions it defines, and a link step combines
+// these descriptions without going back to the IR.
+namespace summary {
+
+struct Location {
+  std::string Filename{};
+  int Line{};
+};
+
+// A call to a function which isn't defined in the module.
+struct ExternalCall {
+  std::string Callee{};
+  Location Where{};
+  // The rank-dependent conditionals deciding whether the call is executed.
+  std::vector<Location> Conditionals{};
+  // The parameters of the caller on which the conditionals of the caller
+  // deciding whether the call is executed depend.
+  std::vector<int> ConditionalArgs{};
+  // The arguments of the call which may be rank-dependent.
+  std::vector<int> RankDependentArgs{};
+};
+
+struct FunctionSummary {
+  // The collectives the function may execute, directly or through the
+  // functions defined in the same module.
+  std::vector<std::string> Collectives{};
+  // The global variables the function may modify and read.
+  std::vector<std::string> Mod{};
+  std::vector<std::string> Ref{};
+  // The parameters which may be rank-dependent. In a summary index, they
+  // include the ones the other modules may pass a rank-dependent value to.
+  std::vector<int> RankDependentArgs{};
+  // The parameters on which the conditionals of the function deciding
+  // whether its collectives are executed depend. The conditionals of the
+  // functions it calls aren't taken into account.
+  std::vector<int> CollectiveArgs{};
+  bool RankDependentReturn{};
+  std::vector<ExternalCall> ExternalCalls{};
+};
+
+struct ModuleSummary {
+  static constexpr int Version = 1;
+  std::map<std::string, FunctionSummary> Functions{};
+
+  void write(llvm::raw_ostream &Os) const;
+  static llvm::Expected<ModuleSummary> load(llvm::StringRef Json);
+};
+
+// Combine the summaries stored in the given files and report the calls which
+// may not be executed by all processes because of a collective executed in
+// another module, and the calls passing a rank-dependent value to a parameter
+// deciding whether the callee executes its collectives. Return false if a
+// summary couldn't be loaded.
+// If IndexFile isn't empty, the combined summaries are also written there,
+// with the collectives of each function including the ones executed in the
+// other modules, so that each module can then be analyzed on its own with
+// -import-summaries.
+bool linkSummaries(llvm::ArrayRef<std::string> Files,
+                   llvm::StringRef IndexFile = "");
+
+// Return the summary imported with -import-summaries for a function which is
+// only declared in the analyzed module, or nullptr if there is none.
+FunctionSummary const *findImportedSummary(llvm::Function const &F);
+
+// Return the parameters of a function defined in the analyzed module which
+// may be rank-dependent according to the summaries imported with
+// -import-summaries, because of the values the other modules call it with.
+llvm::ArrayRef<int> getImportedRankDependentArgs(llvm::Function const &F);
+
+} // namespace summary
+
+struct ModuleSummaryPass : public llvm::PassInfoMixin<ModuleSummaryPass> {
+  static llvm::PreservedAnalyses run(llvm::Module &M,
+                                     llvm::ModuleAnalysisManager &AM);
+};
+
+} // namespace parcoach
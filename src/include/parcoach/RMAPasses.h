@@ -1,8 +1,16 @@
 #pragma once
 
+#include "parcoach/andersen/Andersen.h"
+
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/Passes/PassBuilder.h"
 
+#include <array>
+#include <cstdint>
+
+class PTACallGraph;
+
 namespace parcoach::rma {
 struct RMAInstrumentationPass
     : public llvm::PassInfoMixin<RMAInstrumentationPass> {
@@ -41,4 +49,66 @@ public:
   Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
 };
 
+// The memory which may be accessed by one-sided communications: the buffers
+// exposed through windows, and the origin buffers of RMA operations.
+// Loads and stores which can't access this memory can't conflict with any
+// RMA operation, so they don't need to be instrumented.
+class ExposedMemory {
+  friend class RMAExposedMemoryAnalysis;
+  Andersen const &AA;
+  AndersPtsSet Objects;
+  // Set if some exposed buffer is unknown to the points-to analysis, in which
+  // case any memory may be exposed.
+  bool Unknown{};
+
+public:
+  explicit ExposedMemory(Andersen const &AA) : AA(AA) {}
+  bool mayBeExposed(llvm::Value const *Ptr) const;
+};
+
+class RMAExposedMemoryAnalysis
+    : public llvm::AnalysisInfoMixin<RMAExposedMemoryAnalysis> {
+  friend llvm::AnalysisInfoMixin<RMAExposedMemoryAnalysis>;
+  static llvm::AnalysisKey Key;
+
+public:
+  using Result = ExposedMemory;
+  static Result run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
+// Whether each instruction may execute outside of any epoch, and whether it
+// may execute within an epoch. This is computed interprocedurally over the
+// PTACallGraph, so that functions only called within epochs are known to be
+// in an epoch, and functions never called within an epoch are known not to
+// be.
+// Epochs on different windows are assumed not to be nested: closing an epoch
+// is considered to close all of them.
+class EpochInfo {
+public:
+  enum State : uint8_t { None = 0, Out = 1, In = 2, Any = Out | In };
+
+  explicit EpochInfo(PTACallGraph const &CG) : CG(CG) {}
+  // Return the states the program may be in when entering BB.
+  State getEntryState(llvm::BasicBlock const &BB) const;
+  // Return the states the program may be in after executing I from S.
+  State transfer(llvm::Instruction const &I, State S) const;
+
+private:
+  friend class EpochSolver;
+  PTACallGraph const &CG;
+  llvm::DenseMap<llvm::BasicBlock const *, State> EntryStates;
+  // For every function, the states it may return in when called while out of
+  // any epoch, and when called within an epoch.
+  llvm::DenseMap<llvm::Function const *, std::array<State, 2>> Summaries;
+};
+
+class RMAEpochAnalysis : public llvm::AnalysisInfoMixin<RMAEpochAnalysis> {
+  friend llvm::AnalysisInfoMixin<RMAEpochAnalysis>;
+  static llvm::AnalysisKey Key;
+
+public:
+  using Result = EpochInfo;
+  static Result run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
 } // namespace parcoach::rma
@@ -55,6 +55,7 @@
 #include "llvm/Passes/PassBuilder.h"
 
 #include <map>
+#include <string>
 #include <vector>
 
 class Andersen {
@@ -75,6 +76,8 @@ private:
   void optimizeConstraints();
 #endif
   void solveConstraints();
+  void solveConstraintsSequential();
+  void solveConstraintsParallel(unsigned Threads);
 
   // Helper functions for constraint collection
   void collectConstraintsForGlobals(llvm::Module const &);
@@ -86,6 +89,18 @@ private:
   void addArgumentConstraintForCall(llvm::CallBase const &CB,
                                     llvm::Function const *f);
 
+  // Persistent cache of the solver results (see ResultCache.cpp).
+  // Return the path of the cache file for the module, or an empty string if
+  // the cache is disabled.
+  static std::string getResultCachePath(llvm::Module const &M);
+  // Must be called after the constraint collection, return false if the
+  // file doesn't exist or doesn't match the collected nodes.
+  bool loadResults(llvm::StringRef path);
+  void saveResults(llvm::StringRef path) const;
+
+  // Return the points-to set of node n, or nullptr if it doesn't have any.
+  AndersPtsSet const *findPtsSet(NodeIndex n) const;
+
   // Helper functions for constraint optimization
   NodeIndex getRefNodeIndex(NodeIndex n) const;
   NodeIndex getAdrNodeIndex(NodeIndex n) const;
@@ -110,6 +125,22 @@ public:
   // argument.
   bool getPointsToSet(llvm::Value const *v,
                       std::vector<llvm::Value const *> &ptsSet) const;
+  // Same as getPointsToSet, but the points-to set of v is given as analysis
+  // nodes. Unlike getPointsToSet, this keeps the objects which don't
+  // correspond to any llvm value (e.g. the universal object, standing for the
+  // memory the analysis knows nothing about).
+  bool getPointsToNodes(llvm::Value const *v, AndersPtsSet &pts) const;
+  // Put the points-to set of the object node n (i.e. the objects its content
+  // may point to) into the second argument.
+  void getPointsToNodes(NodeIndex n, AndersPtsSet &pts) const;
+  // Return false if the analysis proves that the llvm pointer v can't point
+  // to any of the given objects, and true otherwise.
+  // An empty points-to set is not considered as a proof, as it usually
+  // stands for a pointer set by some code the analysis doesn't model.
+  bool mayPointToAny(llvm::Value const *v, AndersPtsSet const &objs) const;
+  NodeIndex getUniversalObjNode() const {
+    return nodeFactory.getUniversalObjNode();
+  }
   // Put all allocation sites (i.e. all memory objects identified by the
   // analysis) into the first arugment
   void
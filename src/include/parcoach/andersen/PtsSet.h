@@ -1,63 +1,191 @@
 #ifndef ANDERSEN_PTSSET_H
 #define ANDERSEN_PTSSET_H
 
-#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// The content of a points-to set: its elements are stored as a sorted array of
+// 64-bit blocks, which is compact for the clustered indices we usually get,
+// and lets membership be tested with a binary search.
+// The contents are hash-consed by AndersPtsSetStore: they are immutable, and
+// all the AndersPtsSet with the same elements share the same content.
+class AndersPtsSetData {
+public:
+  struct Block {
+    unsigned index;
+    uint64_t bits;
+
+    bool operator==(Block const &other) const {
+      return index == other.index && bits == other.bits;
+    }
+  };
+  using BlockVector = std::vector<Block>;
+
+private:
+  // Unique across the whole execution, unlike the address of the data, so
+  // that memoised operations can use it as a key.
+  uint64_t id;
+  size_t hash;
+  unsigned size;
+  BlockVector blocks;
+  mutable std::atomic<unsigned> refCount{0};
+
+  AndersPtsSetData(uint64_t id, size_t hash, unsigned size, BlockVector &&b)
+      : id(id), hash(hash), size(size), blocks(std::move(b)) {}
+
+  friend class AndersPtsSet;
+  friend class AndersPtsSetStore;
+};
 
 // We move the points-to set representation here into a separate class
 // The intention is to let us try out different internal implementation of this
 // data-structure (e.g. vectors/bitvecs/sets, ref-counted/non-refcounted) easily
+// A set is a reference-counted handle on its hash-consed content: copying a
+// set is constant time, comparing two sets is a pointer comparison, and the
+// memory used by identical sets is shared. Modifying a set makes it refer to
+// another content, and unions are memoised.
+// Sets can be used concurrently from several threads, as long as a given set
+// isn't modified by one of them while being accessed by another.
 class AndersPtsSet {
 private:
-  llvm::SparseBitVector<> bitvec;
+  using Data = AndersPtsSetData;
+  using Block = Data::Block;
+
+  // nullptr stands for the empty set.
+  Data const *data = nullptr;
+
+  explicit AndersPtsSet(Data const *d) : data(d) {}
+  void reset(Data const *d);
+
+  Block const *blocksBegin() const {
+    return data ? data->blocks.data() : nullptr;
+  }
+  Block const *blocksEnd() const {
+    return data ? data->blocks.data() + data->blocks.size() : nullptr;
+  }
+
+  friend class AndersPtsSetStore;
 
 public:
-  using iterator = llvm::SparseBitVector<>::iterator;
+  // Iterates over the elements in increasing order.
+  class iterator {
+    Block const *block = nullptr;
+    Block const *blockEnd = nullptr;
+    uint64_t remaining = 0;
+
+    void skipEmptyBlocks() {
+      while (!remaining && ++block != blockEnd)
+        remaining = block->bits;
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = unsigned;
+    using difference_type = std::ptrdiff_t;
+    using pointer = unsigned const *;
+    using reference = unsigned;
+
+    iterator() = default;
+    iterator(Block const *begin, Block const *end)
+        : block(begin), blockEnd(end),
+          remaining(begin != end ? begin->bits : 0) {}
+
+    unsigned operator*() const {
+      return block->index * 64 + llvm::countTrailingZeros(remaining);
+    }
+    iterator &operator++() {
+      remaining &= remaining - 1;
+      skipEmptyBlocks();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+    bool operator==(iterator const &other) const {
+      return block == other.block && remaining == other.remaining;
+    }
+    bool operator!=(iterator const &other) const { return !(*this == other); }
+  };
+
+  AndersPtsSet() = default;
+  AndersPtsSet(AndersPtsSet const &other) : data(other.data) {
+    if (data)
+      data->refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  AndersPtsSet(AndersPtsSet &&other) : data(other.data) {
+    other.data = nullptr;
+  }
+  AndersPtsSet &operator=(AndersPtsSet const &other) {
+    if (other.data)
+      other.data->refCount.fetch_add(1, std::memory_order_relaxed);
+    reset(other.data);
+    return *this;
+  }
+  AndersPtsSet &operator=(AndersPtsSet &&other) {
+    if (this != &other) {
+      reset(other.data);
+      other.data = nullptr;
+    }
+    return *this;
+  }
+  ~AndersPtsSet() { reset(nullptr); }
 
   // Return true if *this has idx as an element
-  // This function should be marked const, but we cannot do it because
-  // SparseBitVector::test() is not marked const. WHY???
-  bool has(unsigned idx) { return bitvec.test(idx); }
   bool has(unsigned idx) const {
-    // Since llvm::SparseBitVector::test() does not have a const quantifier, we
-    // have to use this ugly workaround to implement has()
-    llvm::SparseBitVector<> idVec;
-    idVec.set(idx);
-    return bitvec.contains(idVec);
+    Block const *end = blocksEnd();
+    Block const *b = std::lower_bound(
+        blocksBegin(), end, idx / 64,
+        [](Block const &block, unsigned index) { return block.index < index; });
+    return b != end && b->index == idx / 64 && (b->bits >> (idx % 64)) & 1;
   }
 
   // Return true if the ptsset changes
-  bool insert(unsigned idx) { return bitvec.test_and_set(idx); }
+  bool insert(unsigned idx);
+  // Same as above for several elements at once, return true if the ptsset
+  // changes
+  bool insert(llvm::ArrayRef<unsigned> idxs);
 
   // Return true if *this is a superset of other
-  bool contains(AndersPtsSet const &other) const {
-    return bitvec.contains(other.bitvec);
-  }
+  bool contains(AndersPtsSet const &other) const;
 
   // intersectWith: return true if *this and other share points-to elements
-  bool intersectWith(AndersPtsSet const &other) const {
-    return bitvec.intersects(other.bitvec);
-  }
+  bool intersectWith(AndersPtsSet const &other) const;
 
   // Return true if the ptsset changes
-  bool unionWith(AndersPtsSet const &other) { return bitvec |= other.bitvec; }
+  bool unionWith(AndersPtsSet const &other);
 
-  void clear() { bitvec.clear(); }
+  // Remove the elements of other, return true if the ptsset changes
+  bool subtract(AndersPtsSet const &other);
 
-  unsigned getSize() const {
-    return bitvec.count(); // NOT a constant time operation!
-  }
+  void clear() { reset(nullptr); }
+
+  unsigned getSize() const { return data ? data->size : 0; }
   bool
   isEmpty() const // Always prefer using this function to perform empty test
   {
-    return bitvec.empty();
+    return data == nullptr;
   }
 
+  // Thanks to hash-consing, equal sets share the same content.
   bool operator==(AndersPtsSet const &other) const {
-    return bitvec == other.bitvec;
+    return data == other.data;
   }
 
-  iterator begin() const { return bitvec.begin(); }
-  iterator end() const { return bitvec.end(); }
+  iterator begin() const { return iterator(blocksBegin(), blocksEnd()); }
+  iterator end() const { return iterator(blocksEnd(), blocksEnd()); }
+
+  // Return the number of distinct non-empty sets currently alive, and put the
+  // memory they use (in bytes) into the argument.
+  static size_t getNumDistinctSets(size_t &memory);
 };
 
 #endif
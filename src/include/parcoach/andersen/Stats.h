@@ -0,0 +1,31 @@
+#ifndef ANDERSEN_STATS_H
+#define ANDERSEN_STATS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <chrono>
+#include <cstddef>
+
+extern llvm::cl::opt<bool> AndersenStats;
+
+// Measure the time and memory spent in a phase of the analysis, and report
+// them on stderr when it ends if -andersen-stats is given.
+class AndersPhaseStats {
+private:
+  llvm::StringRef name;
+  std::chrono::steady_clock::time_point start;
+  size_t startMemory = 0;
+
+public:
+  explicit AndersPhaseStats(llvm::StringRef name);
+  ~AndersPhaseStats();
+  AndersPhaseStats(AndersPhaseStats const &) = delete;
+  AndersPhaseStats &operator=(AndersPhaseStats const &) = delete;
+};
+
+// Report the size of a data structure used by the analysis, if -andersen-stats
+// is given.
+void reportAndersSize(llvm::StringRef name, size_t count, size_t bytes);
+
+#endif
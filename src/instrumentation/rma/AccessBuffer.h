@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Interval.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace parcoach::rma {
+
+// A bounded ring buffer of accesses with a single producer.
+// The owning thread pushes accesses without taking any lock, while draining
+// may happen from any thread (eg: the one closing an epoch) and is serialized
+// by DrainMutex.
+class AccessBuffer {
+  std::unique_ptr<Access[]> Slots;
+  size_t const Capacity;
+  std::atomic<size_t> Head{};
+  std::atomic<size_t> Tail{};
+  std::mutex DrainMutex;
+
+public:
+  explicit AccessBuffer(size_t Capacity)
+      : Slots(std::make_unique<Access[]>(Capacity)), Capacity(Capacity) {}
+
+  // Must only be called by the owning thread.
+  // Returns false if the buffer is full and the access wasn't recorded.
+  bool push(Access const &A) {
+    size_t H = Head.load(std::memory_order_relaxed);
+    if (H - Tail.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    Slots[H % Capacity] = A;
+    Head.store(H + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Call F on every contiguous chunk of recorded accesses, as a
+  // (Access const *Begin, Access const *End) pair, then forget them.
+  template <typename Fn> void drain(Fn &&F) {
+    std::scoped_lock Lock(DrainMutex);
+    size_t T = Tail.load(std::memory_order_relaxed);
+    size_t H = Head.load(std::memory_order_acquire);
+    while (T != H) {
+      size_t Begin = T % Capacity;
+      size_t Count = std::min(H - T, Capacity - Begin);
+      F(&Slots[Begin], &Slots[Begin + Count]);
+      T += Count;
+    }
+    Tail.store(T, std::memory_order_release);
+  }
+};
+
+} // namespace parcoach::rma
@@ -1,10 +1,67 @@
 #include "Interval.h"
 
 #include <cstring>
+#include <deque>
+#include <mutex>
 #include <tuple>
+#include <unordered_map>
 
 namespace parcoach::rma {
 
+namespace {
+struct FilenameTable {
+  std::mutex Mutex;
+  // A deque keeps references to existing names valid when inserting.
+  std::deque<std::string> Names{"unknown_file"};
+  std::unordered_map<std::string, uint32_t> Ids{{"unknown_file", 0}};
+  std::unordered_map<char const *, uint32_t> PointerIds;
+
+  uint32_t intern(std::string const &Filename) {
+    auto [It, Inserted] = Ids.try_emplace(Filename, Names.size());
+    if (Inserted) {
+      Names.emplace_back(Filename);
+    }
+    return It->second;
+  }
+};
+
+FilenameTable &getFilenameTable() {
+  static FilenameTable Table;
+  return Table;
+}
+} // namespace
+
+uint32_t internFilename(char const *Filename) {
+  // Instrumented code uses the same constant for a given file, remembering
+  // the last one avoids any lookup in loops.
+  thread_local char const *LastFilename{};
+  thread_local uint32_t LastId{};
+  if (Filename == LastFilename) {
+    return LastId;
+  }
+  FilenameTable &Table = getFilenameTable();
+  std::scoped_lock Lock(Table.Mutex);
+  auto [It, Inserted] = Table.PointerIds.try_emplace(Filename, 0);
+  if (Inserted) {
+    It->second = Table.intern(Filename);
+  }
+  LastFilename = Filename;
+  LastId = It->second;
+  return LastId;
+}
+
+uint32_t internFilename(std::string const &Filename) {
+  FilenameTable &Table = getFilenameTable();
+  std::scoped_lock Lock(Table.Mutex);
+  return Table.intern(Filename);
+}
+
+std::string const &getFilename(uint32_t FileId) {
+  FilenameTable &Table = getFilenameTable();
+  std::scoped_lock Lock(Table.Mutex);
+  return Table.Names[FileId];
+}
+
 std::ostream &operator<<(std::ostream &Os, AccessType const &T) {
   Os << to_string(T);
   return Os;
@@ -21,7 +78,7 @@ std::ostream &operator<<(std::ostream &Os, Access const &A) {
 }
 
 std::ostream &operator<<(std::ostream &Os, DebugInfo const &Dbg) {
-  Os << Dbg.Filename << ":" << Dbg.Line;
+  Os << getFilename(Dbg.FileId) << ":" << Dbg.Line;
   return Os;
 }
 
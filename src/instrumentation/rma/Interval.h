@@ -1,11 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <iostream>
-#include <set>
+#include <string>
 #include <tuple>
+#include <type_traits>
 
 namespace parcoach::rma {
 
@@ -64,31 +66,39 @@ struct MemoryAccess {
   uint64_t Size;
 };
 
+// Filenames are interned in a process-wide table, so that debug information
+// only holds a fixed-size id: accesses are then trivially copyable and can be
+// sent as-is through MPI.
+// Interning a pointer is cheap when the same constant string is passed
+// repeatedly, which is what the instrumentation does. The pointer is cached,
+// so the string it points to must live until the end of the program (eg: a
+// string literal).
+uint32_t internFilename(char const *Filename);
+uint32_t internFilename(std::string const &Filename);
+std::string const &getFilename(uint32_t FileId);
+
 struct DebugInfo {
-  uint64_t Line{};
-  // It's absolutely essential that this field is the *last* member of that
-  // struct. It gets sent separately through MPI, and we don't include it
-  // in the MPI committed type.
-  std::string Filename{"unknown_file"};
+  uint32_t Line{};
+  // Id of "unknown_file" by default.
+  uint32_t FileId{};
   DebugInfo() = default;
+  // Filename_ is interned by its address, see internFilename.
   DebugInfo(int Line_, char const *Filename_)
-      : Line(static_cast<uint64_t>(Line_)) {
-    // Only construct the filename if it's actually containing something.
+      : Line(static_cast<uint32_t>(Line_)) {
+    // Only intern the filename if it's actually containing something.
     if (Filename_) {
-      Filename = Filename_;
+      FileId = internFilename(Filename_);
     }
   }
 
   inline bool operator==(DebugInfo const &Other) const {
-    return std::tie(Line, Filename) == std::tie(Other.Line, Other.Filename);
+    return std::tie(Line, FileId) == std::tie(Other.Line, Other.FileId);
   }
 };
 
 struct Access {
   Interval Itv;
   AccessType Type;
-  // It's absolutely essential that this field is the *last* member of that
-  // struct.
   DebugInfo Dbg;
 
   Access() = default;
@@ -113,6 +123,24 @@ struct Access {
     return ((int)Type | (int)Other.Type) == (int)AccessType::RMA_WRITE;
   }
 
+  // Extend this access to also cover Other if they have the same type and
+  // debug information, and if their union is contiguous. Overlapping accesses
+  // are only merged if they don't conflict with each other, so that merging
+  // never hides a conflict.
+  inline bool tryMerge(Access const &Other) {
+    if (Type != Other.Type || !(Dbg == Other.Dbg)) {
+      return false;
+    }
+    bool Adjacent = (Itv.Up + 1 == Other.Itv.Low) ||
+                    (Other.Itv.Up + 1 == Itv.Low);
+    if (!Adjacent && (!Itv.intersects(Other.Itv) || conflictsWith(Other))) {
+      return false;
+    }
+    Itv.Low = std::min(Itv.Low, Other.Itv.Low);
+    Itv.Up = std::max(Itv.Up, Other.Itv.Up);
+    return true;
+  }
+
   friend inline bool operator==(std::reference_wrapper<Access const> A,
                                 std::reference_wrapper<Access const> B) {
     return A.get() == B.get();
@@ -124,17 +152,8 @@ struct Access {
   }
 };
 
-// This is a comparator specifically designed for our multiset: we just
-// want to compare the Intervals' ranges.
-struct AccessComp {
-  inline bool operator()(Access const &lhs, Access const &rhs) const {
-    return lhs.Itv < rhs.Itv;
-  }
-};
-
-using IntervalContainer = std::multiset<Access, AccessComp>;
-using IntervalViewContainer =
-    std::multiset<std::reference_wrapper<Access const>, AccessComp>;
+// Accesses are sent through MPI as raw bytes.
+static_assert(std::is_trivially_copyable_v<Access>);
 
 std::ostream &operator<<(std::ostream &Os, AccessType const &T);
 std::ostream &operator<<(std::ostream &Os, Interval const &I);
@@ -0,0 +1,76 @@
+#include "IntervalTree.h"
+
+#include <algorithm>
+
+namespace parcoach::rma {
+
+void IntervalTree::update(NodeIndex N) {
+  Node &Cur = Nodes[N];
+  Cur.Height = 1 + std::max(height(Cur.Left), height(Cur.Right));
+  Cur.MaxUp = std::max({Cur.Acc.Itv.Up, maxUp(Cur.Left), maxUp(Cur.Right)});
+}
+
+IntervalTree::NodeIndex IntervalTree::rotateLeft(NodeIndex N) {
+  NodeIndex R = Nodes[N].Right;
+  Nodes[N].Right = Nodes[R].Left;
+  Nodes[R].Left = N;
+  update(N);
+  update(R);
+  return R;
+}
+
+IntervalTree::NodeIndex IntervalTree::rotateRight(NodeIndex N) {
+  NodeIndex L = Nodes[N].Left;
+  Nodes[N].Left = Nodes[L].Right;
+  Nodes[L].Right = N;
+  update(N);
+  update(L);
+  return L;
+}
+
+IntervalTree::NodeIndex IntervalTree::rebalance(NodeIndex N) {
+  update(N);
+  Node &Cur = Nodes[N];
+  int Balance = height(Cur.Left) - height(Cur.Right);
+  if (Balance > 1) {
+    if (height(Nodes[Cur.Left].Left) < height(Nodes[Cur.Left].Right)) {
+      Cur.Left = rotateLeft(Cur.Left);
+    }
+    return rotateRight(N);
+  }
+  if (Balance < -1) {
+    if (height(Nodes[Cur.Right].Right) < height(Nodes[Cur.Right].Left)) {
+      Cur.Right = rotateRight(Cur.Right);
+    }
+    return rotateLeft(N);
+  }
+  return N;
+}
+
+IntervalTree::NodeIndex IntervalTree::insert(NodeIndex N, NodeIndex New) {
+  if (N == None) {
+    return New;
+  }
+  // Equal intervals go to the right, so that they are visited in insertion
+  // order.
+  if (Nodes[New].Acc.Itv < Nodes[N].Acc.Itv) {
+    NodeIndex Left = insert(Nodes[N].Left, New);
+    Nodes[N].Left = Left;
+  } else {
+    NodeIndex Right = insert(Nodes[N].Right, New);
+    Nodes[N].Right = Right;
+  }
+  return rebalance(N);
+}
+
+void IntervalTree::insert(Access const &A) {
+  Nodes.push_back(Node{A, A.Itv.Up});
+  Root = insert(Root, Nodes.size() - 1);
+}
+
+void IntervalTree::clear() {
+  Nodes.clear();
+  Root = None;
+}
+
+} // namespace parcoach::rma
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Interval.h"
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace parcoach::rma {
+
+using IntervalViewContainer = std::vector<std::reference_wrapper<Access const>>;
+
+// An augmented AVL tree of accesses, ordered on their interval, where every
+// node also records the highest upper bound found in its subtree.
+// This lets overlap queries prune whole subtrees: finding the k accesses
+// intersecting a given interval costs O(log n + k) in practice, and it
+// correctly finds long intervals starting well before the queried one.
+// Nodes are stored in a single vector and refer to each other by index, so
+// that inserting only allocates when the storage has to grow, and clearing
+// the tree at the end of an epoch keeps the storage for the next one.
+class IntervalTree {
+  using NodeIndex = uint32_t;
+  static constexpr NodeIndex None = std::numeric_limits<NodeIndex>::max();
+
+  struct Node {
+    Access Acc;
+    uint64_t MaxUp;
+    NodeIndex Left{None};
+    NodeIndex Right{None};
+    int Height{1};
+  };
+
+  std::vector<Node> Nodes;
+  NodeIndex Root{None};
+
+  int height(NodeIndex N) const { return N == None ? 0 : Nodes[N].Height; }
+  uint64_t maxUp(NodeIndex N) const { return N == None ? 0 : Nodes[N].MaxUp; }
+  void update(NodeIndex N);
+  NodeIndex rotateLeft(NodeIndex N);
+  NodeIndex rotateRight(NodeIndex N);
+  NodeIndex rebalance(NodeIndex N);
+  NodeIndex insert(NodeIndex N, NodeIndex New);
+
+  template <typename Fn>
+  void visitIntersecting(NodeIndex N, Interval const &Itv, Fn &F) const {
+    // Nothing in a subtree can intersect if all its intervals end before Itv.
+    while (N != None && Nodes[N].MaxUp >= Itv.Low) {
+      Node const &Cur = Nodes[N];
+      visitIntersecting(Cur.Left, Itv, F);
+      // The right subtree only has intervals starting after this one.
+      if (Cur.Acc.Itv.Low > Itv.Up) {
+        return;
+      }
+      if (Cur.Acc.Itv.intersects(Itv)) {
+        F(Cur.Acc);
+      }
+      N = Cur.Right;
+    }
+  }
+
+public:
+  // Iterates over the accesses in insertion order.
+  class const_iterator {
+    std::vector<Node>::const_iterator It;
+
+  public:
+    explicit const_iterator(std::vector<Node>::const_iterator It) : It(It) {}
+    Access const &operator*() const { return It->Acc; }
+    Access const *operator->() const { return &It->Acc; }
+    const_iterator &operator++() {
+      ++It;
+      return *this;
+    }
+    bool operator!=(const_iterator const &Other) const {
+      return It != Other.It;
+    }
+  };
+
+  const_iterator begin() const { return const_iterator(Nodes.begin()); }
+  const_iterator end() const { return const_iterator(Nodes.end()); }
+  size_t size() const { return Nodes.size(); }
+  bool empty() const { return Nodes.empty(); }
+
+  void insert(Access const &A);
+  void clear();
+
+  // Call F on every access intersecting Itv, ordered on their interval.
+  // This doesn't allocate, but F must not modify the tree.
+  template <typename Fn>
+  void forEachIntersecting(Interval const &Itv, Fn &&F) const {
+    visitIntersecting(Root, Itv, F);
+  }
+};
+
+} // namespace parcoach::rma
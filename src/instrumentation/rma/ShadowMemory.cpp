@@ -0,0 +1,73 @@
+#include "ShadowMemory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace parcoach::rma {
+
+namespace {
+
+constexpr uint8_t stateBit(AccessType T) {
+  return 1 << static_cast<int>(T);
+}
+
+// The state bits of the access types conflicting with T, following
+// Access::conflictsWith.
+constexpr uint8_t conflictMask(AccessType T) {
+  uint8_t Mask = 0;
+  for (int Other = 0; Other < 4; Other++) {
+    if ((static_cast<int>(T) | Other) ==
+        static_cast<int>(AccessType::RMA_WRITE)) {
+      Mask |= 1 << Other;
+    }
+  }
+  return Mask;
+}
+
+} // namespace
+
+ShadowMemory::ShadowMemory(uint64_t Base, size_t Size)
+    : Range{Base, Base + Size - 1}, State(Size), DirtyLow(Range.Up + 1) {}
+
+bool ShadowMemory::mayConflict(Access const &A) const {
+  uint8_t const *Begin = stateOf(A.Itv.Low);
+  size_t Size = A.Itv.Up - A.Itv.Low + 1;
+  // Gather the state of all the bytes, a word at a time, before testing it:
+  // this is branchless and easily vectorized.
+  uint64_t Word = 0;
+  size_t I = 0;
+  for (; I + sizeof(uint64_t) <= Size; I += sizeof(uint64_t)) {
+    uint64_t Chunk;
+    std::memcpy(&Chunk, Begin + I, sizeof(uint64_t));
+    Word |= Chunk;
+  }
+  for (; I < Size; I++) {
+    Word |= Begin[I];
+  }
+  return Word & (conflictMask(A.Type) * 0x0101010101010101ULL);
+}
+
+void ShadowMemory::insert(Access const &A) {
+  uint8_t Bit = stateBit(A.Type);
+  uint8_t *Begin = stateOf(A.Itv.Low);
+  uint8_t *End = stateOf(A.Itv.Up) + 1;
+  for (uint8_t *It = Begin; It != End; ++It) {
+    *It |= Bit;
+  }
+  DirtyLow = std::min(DirtyLow, A.Itv.Low);
+  DirtyUp = std::max(DirtyUp, A.Itv.Up);
+  if (Accesses.empty() || !Accesses.back().tryMerge(A)) {
+    Accesses.push_back(A);
+  }
+}
+
+void ShadowMemory::clear() {
+  if (DirtyLow <= DirtyUp) {
+    std::fill(stateOf(DirtyLow), stateOf(DirtyUp) + 1, 0);
+  }
+  DirtyLow = Range.Up + 1;
+  DirtyUp = 0;
+  Accesses.clear();
+}
+
+} // namespace parcoach::rma
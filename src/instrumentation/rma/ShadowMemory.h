@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Interval.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace parcoach::rma {
+
+// The access state of every byte of a window during an epoch, as one bit per
+// AccessType.
+// This is an alternative to the IntervalTree for small and densely accessed
+// windows: checking and inserting an access only costs bitwise operations
+// over the bytes it touches, whatever the number of accesses already done
+// during the epoch.
+// The accesses themselves are only kept to report conflicts, consecutive
+// accesses extending each other being merged.
+class ShadowMemory {
+  Interval Range;
+  std::vector<uint8_t> State;
+  std::vector<Access> Accesses;
+  // The bytes touched since the last clear, so that clearing doesn't have to
+  // go over the whole window.
+  uint64_t DirtyLow;
+  uint64_t DirtyUp{};
+
+  uint8_t *stateOf(uint64_t Addr) { return &State[Addr - Range.Low]; }
+  uint8_t const *stateOf(uint64_t Addr) const {
+    return &State[Addr - Range.Low];
+  }
+  bool mayConflict(Access const &A) const;
+
+public:
+  // Create the shadow memory of the Size bytes starting at Base, Size must not
+  // be 0.
+  ShadowMemory(uint64_t Base, size_t Size);
+
+  Interval const &range() const { return Range; }
+  bool empty() const { return Accesses.empty(); }
+
+  // Call F on every access conflicting with A, which must be within range().
+  template <typename Fn>
+  void forEachConflicting(Access const &A, Fn &&F) const {
+    if (!mayConflict(A)) {
+      return;
+    }
+    for (Access const &Other : Accesses) {
+      if (Other.conflictsWith(A)) {
+        F(Other);
+      }
+    }
+  }
+
+  // Call F on every access intersecting Itv. This goes over all the accesses,
+  // it's only meant for debugging.
+  template <typename Fn>
+  void forEachIntersecting(Interval const &Itv, Fn &&F) const {
+    for (Access const &Other : Accesses) {
+      if (Other.Itv.intersects(Itv)) {
+        F(Other);
+      }
+    }
+  }
+
+  // Record A, which must be within range().
+  void insert(Access const &A);
+  void clear();
+};
+
+} // namespace parcoach::rma
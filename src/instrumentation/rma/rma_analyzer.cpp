@@ -1,29 +1,39 @@
 #include "rma_analyzer.h"
 
+#include "AccessBuffer.h"
 #include "Interval.h"
 #include "util.h"
 
 #include <mpi.h>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
-#include <map>
 #include <memory>
-#include <optional>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
 
 using namespace std;
 using namespace parcoach::rma;
 namespace {
-map<MPI_Win, std::unique_ptr<rma_analyzer_state>> States;
 /******************************************************
  *             RMA Analyzer global state              *
  ******************************************************/
 
-int win_mpi_tag_id[RMA_ANALYZER_MAX_WIN] = {0};
+/* The states of all the windows. Each state is also cached as an attribute
+ * of its window, so that looking it up doesn't need any search.
+ * Application threads go through the states while windows are created and
+ * freed, StatesMutex must be held to access the vector. */
+vector<unique_ptr<rma_analyzer_state>> States;
+shared_mutex StatesMutex;
+int StateKeyval = MPI_KEYVAL_INVALID;
 
 /* Activate or deactivate window filtering. Activated by default. */
 int rma_analyzer_filter_window = 1;
@@ -37,19 +47,54 @@ int rma_analyzer_is_active_epoch(MPI_Win win) {
   return (state->active_epoch > 0);
 }
 
-/* Save the interval given in parameter so that future intersections
- * can be detected. Returns 1 if the interval has been saved, 0
- * otherwise: this means that the interval has been filtered out. */
-int rma_analyzer_save_interval(parcoach::rma::Access &&Acc, MPI_Win win) {
-  RMA_DEBUG(cerr << "Getting state in " << __func__ << "\n");
-  rma_analyzer_state *state = rma_analyzer_get_state(win);
-  RMA_DEBUG({
-    Err << "Access " << Acc << " for window: " << win << "\n";
-    cerr << Err.str();
-  });
-  scoped_lock Lock(state->ListMutex);
-  auto Conflicting = state->getConflictingIntervals(Acc);
-  for (Access const &Found : Conflicting) {
+/* The states of the windows, for the routines which may end up taking
+ * StatesMutex themselves. */
+vector<rma_analyzer_state *> rma_analyzer_get_states() {
+  shared_lock Lock(StatesMutex);
+  vector<rma_analyzer_state *> Ret;
+  for (auto &State : States) {
+    Ret.push_back(State.get());
+  }
+  return Ret;
+}
+
+/* Use a shadow memory for each window rather than an interval tree.
+ * Activated through the RMA_ANALYZER_SHADOW_MEMORY environment variable. */
+int rma_analyzer_shadow_memory = 0;
+
+/* Call Outside on the parts of the access outside of the window's shadow
+ * memory, if any, and Inside on the part within it. */
+template <typename OutsideFn, typename InsideFn>
+void rma_analyzer_split_access(rma_analyzer_state const *state,
+                               Access const &Acc, OutsideFn &&Outside,
+                               InsideFn &&Inside) {
+  if (!state->Shadow) {
+    Outside(Acc);
+    return;
+  }
+  Interval const &Range = state->Shadow->range();
+  if (!Acc.Itv.intersects(Range)) {
+    Outside(Acc);
+    return;
+  }
+  if (Acc.Itv.Low < Range.Low) {
+    Outside(Access(Interval{Acc.Itv.Low, Range.Low - 1}, Acc.Type, Acc.Dbg));
+  }
+  if (Acc.Itv.Up > Range.Up) {
+    Outside(Access(Interval{Range.Up + 1, Acc.Itv.Up}, Acc.Type, Acc.Dbg));
+  }
+  Interval Within{max(Acc.Itv.Low, Range.Low), min(Acc.Itv.Up, Range.Up)};
+  Inside(Access(Within, Acc.Type, Acc.Dbg));
+}
+
+/* Check the interval given in parameter against the ones already inserted
+ * in the state, and insert it so that future intersections can be detected.
+ * The state's ListMutex must be held by the caller. */
+void rma_analyzer_check_and_insert_interval(rma_analyzer_state *state,
+                                            Access const &Acc) {
+  bool HasConflict = false;
+  auto Report = [&](Access const &Found) {
+    HasConflict = true;
     RMA_DEBUG({
       Err << "Interval " << Acc << " conflicts with " << Found << "\n";
       cerr << Err.str();
@@ -62,8 +107,19 @@ int rma_analyzer_save_interval(parcoach::rma::Access &&Acc, MPI_Win win) {
         << "The program will be exiting now with MPI_Abort.\n";
     // Emit the error all at once.
     cerr << Err.str();
-  }
-  if (!Conflicting.empty()) {
+  };
+  auto CheckTree = [&](Access const &Part) {
+    state->Intervals.forEachIntersecting(Part.Itv, [&](Access const &Found) {
+      if (Found.conflictsWith(Part)) {
+        Report(Found);
+      }
+    });
+  };
+  auto CheckShadow = [&](Access const &Part) {
+    state->Shadow->forEachConflicting(Part, Report);
+  };
+  rma_analyzer_split_access(state, Acc, CheckTree, CheckShadow);
+  if (HasConflict) {
     MPI_Abort(MPI_COMM_WORLD, 1);
   }
   RMA_DEBUG({
@@ -75,142 +131,438 @@ int rma_analyzer_save_interval(parcoach::rma::Access &&Acc, MPI_Win win) {
     Err << "===\n";
     cerr << Err.str();
   });
-  state->Intervals.emplace(Acc);
-  return 1;
+  rma_analyzer_split_access(
+      state, Acc, [&](Access const &Part) { state->Intervals.insert(Part); },
+      [&](Access const &Part) { state->Shadow->insert(Part); });
 }
 
-/* This routine is only to be called by the communication checking
- * thread. It checks if an interval has landed locally, and returns
- * only if an interval has been received. On return, the received_itv
- * parameter has been filled with a new interval.
- * Returns true if the thread should exit. */
-optional<Access> rma_analyzer_check_communication(MPI_Win win) {
+/* Save the interval given in parameter so that future intersections
+ * can be detected. Returns 1 if the interval has been saved, 0
+ * otherwise: this means that the interval has been filtered out. */
+int rma_analyzer_save_interval(parcoach::rma::Access &&Acc, MPI_Win win) {
   RMA_DEBUG(cerr << "Getting state in " << __func__ << "\n");
   rma_analyzer_state *state = rma_analyzer_get_state(win);
+  RMA_DEBUG({
+    Err << "Access " << Acc << " for window: " << win << "\n";
+    cerr << Err.str();
+  });
+  scoped_lock Lock(state->ListMutex);
+  rma_analyzer_check_and_insert_interval(state, Acc);
+  return 1;
+}
 
-  int nb_loops = 0;
-  int mpi_flag = 0;
-  MPI_Request mpi_request;
-  Access ReceivedInterval{};
-
-  RMA_DEBUG(cerr << "Irecv on tag: " << state->mpi_tag + state->count_epoch
-                 << "\n";);
-  MPI_Irecv(&ReceivedInterval, 1, state->interval_datatype, MPI_ANY_SOURCE,
-            state->mpi_tag + state->count_epoch, state->win_comm, &mpi_request);
-
-  while (mpi_flag == 0) {
-    if ((state->thread_end == 1) && (state->count == state->value)) {
-      MPI_Cancel(&mpi_request);
-      state->count = 0;
-      return {};
-    }
+/******************************************************
+ *         Deferred checking of local accesses        *
+ ******************************************************/
 
-    /* Yield the thread when looping too much to reduce the pressure on
-     * application threads, and the overhead */
-    if (nb_loops >= 100) {
-      nb_loops = 0;
-      sched_yield();
+/* When activated through the RMA_ANALYZER_DEFER_LOCAL_CHECKS environment
+ * variable, loads and stores are not checked immediately: each application
+ * thread records them in its own buffer, without taking any lock, and they
+ * are checked in bulk against all active windows when an epoch starts or
+ * ends, or when the buffer is full.
+ * Local accesses can only conflict with RMA accesses, and the set of active
+ * windows doesn't change between two flushes, so this detects the same
+ * conflicts as checking them one by one. */
+int rma_analyzer_defer_local_checks = 0;
+
+/* Number of windows with an active epoch, so that loads and stores
+ * happening outside of any epoch can be discarded without a lookup. */
+atomic<int> rma_analyzer_active_epochs{0};
+
+mutex LocalBuffersMutex;
+vector<AccessBuffer *> LocalBuffers;
+
+/* Check the accesses recorded in the given buffer against all the active
+ * windows, taking each window's lock once per chunk of accesses. */
+void rma_analyzer_drain_local_buffer(AccessBuffer &Buffer) {
+  Buffer.drain([](Access const *Begin, Access const *End) {
+    shared_lock StatesLock(StatesMutex);
+    for (auto &State : States) {
+      if (!State->active_epoch) {
+        continue;
+      }
+      scoped_lock Lock(State->ListMutex);
+      for (Access const *It = Begin; It != End; ++It) {
+        rma_analyzer_check_and_insert_interval(State.get(), *It);
+      }
     }
-    nb_loops++;
+  });
+}
 
-    MPI_Test(&mpi_request, &mpi_flag, MPI_STATUS_IGNORE);
+/* Check the local accesses recorded by all application threads. */
+void rma_analyzer_flush_local_buffers() {
+  if (!rma_analyzer_defer_local_checks) {
+    return;
   }
-  state->count++;
-  mpi_flag = 0;
+  scoped_lock Lock(LocalBuffersMutex);
+  for (AccessBuffer *Buffer : LocalBuffers) {
+    rma_analyzer_drain_local_buffer(*Buffer);
+  }
+}
+
+/* The buffer owned by each application thread; it is registered on first
+ * use, and flushed when the thread exits. */
+struct LocalAccessBuffer {
+  AccessBuffer Buffer{RMA_ANALYZER_LOCAL_BUFFER_SIZE};
+  LocalAccessBuffer() {
+    scoped_lock Lock(LocalBuffersMutex);
+    LocalBuffers.push_back(&Buffer);
+  }
+  ~LocalAccessBuffer() {
+    scoped_lock Lock(LocalBuffersMutex);
+    rma_analyzer_drain_local_buffer(Buffer);
+    LocalBuffers.erase(find(LocalBuffers.begin(), LocalBuffers.end(), &Buffer));
+  }
+};
+
+/* Record a local access in the calling thread's buffer. */
+void rma_analyzer_record_local_access(Access const &Acc) {
+  if (rma_analyzer_active_epochs.load(memory_order_relaxed) == 0) {
+    return;
+  }
+  thread_local LocalAccessBuffer Local;
+  while (!Local.Buffer.push(Acc)) {
+    rma_analyzer_drain_local_buffer(Local.Buffer);
+  }
+}
+
+/* Filenames are only sent the first time an origin uses them in accesses
+ * targeting a given rank of the window, on a tag never used by epochs. The
+ * message holds the origin's id for the filename,
+ * followed by the filename itself.
+ * The target only receives it when it gets the batch of accesses using it,
+ * so the send is not waited for until the end of the epoch. The state's
+ * OutgoingMutex must be held by the caller. */
+void rma_analyzer_send_filename(rma_analyzer_state *state, uint32_t FileId,
+                                int target_rank) {
+  vector<bool> &Sent = state->SentFilenames[target_rank];
+  if (FileId < Sent.size() && Sent[FileId]) {
+    return;
+  }
+  if (FileId >= Sent.size()) {
+    Sent.resize(FileId + 1);
+  }
+  Sent[FileId] = true;
+
+  string const &Filename = getFilename(FileId);
+  string Message(sizeof(FileId) + Filename.size(), '\0');
+  memcpy(Message.data(), &FileId, sizeof(FileId));
+  memcpy(Message.data() + sizeof(FileId), Filename.data(), Filename.size());
+  string &Buffer = state->FilenameMessages.emplace_back(std::move(Message));
+  MPI_Isend(Buffer.data(), Buffer.size(), MPI_BYTE, target_rank,
+            RMA_ANALYZER_FILENAME_TAG, state->win_comm,
+            &state->FilenameRequests.emplace_back());
+}
 
-  // Now that we have a basic Access let's receive the one thing that has
-  // to be sent separately: the filename. We first get the raw string length,
-  // then allocate a local buffer of the appropriate size, then turn it into
-  // a proper string in the ReceivedInterval's debug info.
+/* Receive the next filename sent by the source, and remember its id. */
+void rma_analyzer_receive_filename(rma_analyzer_state *state, int source) {
   MPI_Status status;
-  MPI_Probe(MPI_ANY_SOURCE, RMA_ANALYZER_STRING_MPI_TAG, state->win_comm,
-            &status);
+  MPI_Probe(source, RMA_ANALYZER_FILENAME_TAG, state->win_comm, &status);
   int length = 0;
-  MPI_Get_count(&status, MPI_CHAR, &length);
-  unique_ptr<char[]> Buffer = make_unique<char[]>(length);
+  MPI_Get_count(&status, MPI_BYTE, &length);
+  string Message(length, '\0');
+  MPI_Recv(Message.data(), length, MPI_BYTE, source,
+           RMA_ANALYZER_FILENAME_TAG, state->win_comm, MPI_STATUS_IGNORE);
+
+  uint32_t RemoteId;
+  memcpy(&RemoteId, Message.data(), sizeof(RemoteId));
+  string Filename = Message.substr(sizeof(RemoteId));
+  RMA_DEBUG(cerr << "Received filename " << RemoteId << ": '" << Filename
+                 << "'\n");
+  state->ReceivedFilenames[source][RemoteId] = internFilename(Filename);
+}
 
-  RMA_DEBUG(cerr << "Receiving string length: " << length << "\n");
+/* Send the accesses buffered for the target rank, if any, in a single
+ * message. The state's OutgoingMutex must be held by the caller. */
+void rma_analyzer_flush_outgoing(rma_analyzer_state *state, int target_rank) {
+  vector<Access> &Outgoing = state->OutgoingAccesses[target_rank];
+  if (Outgoing.empty()) {
+    return;
+  }
+  for (Access const &Acc : Outgoing) {
+    rma_analyzer_send_filename(state, Acc.Dbg.FileId, target_rank);
+  }
+  RMA_DEBUG(cerr << "Sending " << Outgoing.size() << " accesses to "
+                 << target_rank << "\n");
+  MPI_Send(Outgoing.data(), Outgoing.size(), state->interval_datatype,
+           target_rank, state->epoch_tag(), state->win_comm);
+  /* Increment number of messages sent to the target */
+  state->array[target_rank]++;
+  Outgoing.clear();
+}
 
-  MPI_Recv(Buffer.get(), length, MPI_CHAR, MPI_ANY_SOURCE,
-           RMA_ANALYZER_STRING_MPI_TAG, state->win_comm, &status);
+/* Buffer the access to send to the target rank, merging it with the previous
+ * one when possible. Accesses are sent when the buffer is full, or at the end
+ * of the epoch. */
+void rma_analyzer_buffer_outgoing(rma_analyzer_state *state,
+                                  Access const &TargetAccess,
+                                  int target_rank) {
+  scoped_lock Lock(state->OutgoingMutex);
+  vector<Access> &Outgoing = state->OutgoingAccesses[target_rank];
+  if (!Outgoing.empty() && Outgoing.back().tryMerge(TargetAccess)) {
+    return;
+  }
+  if (Outgoing.size() == RMA_ANALYZER_BATCH_SIZE) {
+    rma_analyzer_flush_outgoing(state, target_rank);
+  }
+  Outgoing.push_back(TargetAccess);
+}
 
-  ReceivedInterval.Dbg.Filename = string(Buffer.get(), length);
+/* Send the accesses buffered for all ranks; if do_send is 0 they are
+ * discarded, as nobody expects them. */
+void rma_analyzer_flush_all_outgoing(rma_analyzer_state *state, int do_send) {
+  scoped_lock Lock(state->OutgoingMutex);
+  for (int i = 0; i < state->size_comm; i++) {
+    if (do_send) {
+      rma_analyzer_flush_outgoing(state, i);
+    } else {
+      state->OutgoingAccesses[i].clear();
+    }
+  }
+  /* The targets have received the filenames along with the accesses */
+  MPI_Waitall(state->FilenameRequests.size(), state->FilenameRequests.data(),
+              MPI_STATUSES_IGNORE);
+  state->FilenameRequests.clear();
+  state->FilenameMessages.clear();
+}
 
-  // Fix the interval by adding the base address.
-  RMA_DEBUG(cerr << "Received(beforefix): " << ReceivedInterval << "\n");
-  ReceivedInterval.Itv.fixForWindow(state->win_base, state->disp_unit);
-  RMA_DEBUG({
-    cerr << "Received(afterfix): " << ReceivedInterval << "\n";
-    cerr << "Filename: '" << ReceivedInterval.Dbg.Filename << "'\n";
-  });
-  return ReceivedInterval;
+/* Post the receive for the next batch of accesses sent to this window during
+ * the current epoch. */
+void rma_analyzer_post_receive(rma_analyzer_state *state) {
+  RMA_DEBUG(cerr << "Irecv on tag: " << state->epoch_tag() << "\n";);
+  state->Received.resize(RMA_ANALYZER_BATCH_SIZE);
+  MPI_Irecv(state->Received.data(), RMA_ANALYZER_BATCH_SIZE,
+            state->interval_datatype, MPI_ANY_SOURCE, state->epoch_tag(),
+            state->win_comm, &state->recv_request);
 }
 
-/* This function is needed to receive the intervals and do comparaisons */
-void rma_analyzer_comm_check_thread(MPI_Win win) {
-  while (1) {
-    auto Received = rma_analyzer_check_communication(win);
-    if (!Received) {
-      return;
+/* Check the batch of accesses that has just been received by the window
+ * against the ones already inserted, and insert them. */
+void rma_analyzer_check_received(rma_analyzer_state *state,
+                                 MPI_Status &status) {
+  state->count++;
+
+  int nb_received = 0;
+  MPI_Get_count(&status, state->interval_datatype, &nb_received);
+  state->Received.resize(nb_received);
+
+  // Accesses refer to filenames through the origin's ids: translate them to
+  // ours, receiving the filenames the origin uses for the first time for this
+  // window.
+  int source = status.MPI_SOURCE;
+  auto &Known = state->ReceivedFilenames[source];
+  for (Access &ReceivedInterval : state->Received) {
+    while (Known.count(ReceivedInterval.Dbg.FileId) == 0) {
+      rma_analyzer_receive_filename(state, source);
     }
+    ReceivedInterval.Dbg.FileId = Known[ReceivedInterval.Dbg.FileId];
 
-    rma_analyzer_save_interval(std::move(*Received), win);
+    // The origin has already taken our displacement unit into account, fix
+    // the interval by adding the base address.
+    RMA_DEBUG(cerr << "Received(beforefix): " << ReceivedInterval << "\n");
+    ReceivedInterval.Itv.fixForWindow(state->win_base, 1);
+    RMA_DEBUG(cerr << "Received(afterfix): " << ReceivedInterval << "\n");
+  }
+
+  scoped_lock Lock(state->ListMutex);
+  for (Access const &Acc : state->Received) {
+    rma_analyzer_check_and_insert_interval(state, Acc);
   }
 }
 
-/* This routine returns a new tag range to use for the allocation of a
- * new window */
-int rma_analyzer_get_tag_range_id() {
-  for (int i = 0; i < RMA_ANALYZER_MAX_WIN; i++) {
-    if (win_mpi_tag_id[i] == 0) {
-      win_mpi_tag_id[i] = 1;
-      return i;
+/******************************************************
+ *                 Progress engine                    *
+ ******************************************************/
+
+/* A single thread per process receives the accesses sent to all the windows
+ * with an active epoch, and is reused across epochs.
+ * When no epoch is active it sleeps on a condition variable, otherwise it
+ * blocks in MPI_Waitany on the windows' receives. Application threads wake
+ * it up with an empty message on a private communicator when an epoch
+ * starts or ends. */
+struct ProgressEngine {
+  thread Thread;
+  mutex Mutex;
+  condition_variable CV;
+  /* Windows whose epoch started since the engine last looked */
+  vector<rma_analyzer_state *> Starting;
+  /* Set when an epoch started or ended since the engine last looked */
+  bool Pending{};
+  bool Stop{};
+  MPI_Comm WakeComm{MPI_COMM_NULL};
+  /* Keyval of the MPI_COMM_SELF attribute stopping the engine, MPI deletes
+   * it at the beginning of MPI_Finalize */
+  int FinalizeKeyval{MPI_KEYVAL_INVALID};
+
+  /* The program may exit without calling MPI_Finalize, or before freeing its
+   * windows: a joinable thread must not be left behind. */
+  ~ProgressEngine() { stop(); }
+
+  static int onFinalize(MPI_Comm, int, void *Engine, void *) {
+    static_cast<ProgressEngine *>(Engine)->stop();
+    return MPI_SUCCESS;
+  }
+
+  void wake() {
+    CV.notify_all();
+    MPI_Send(nullptr, 0, MPI_BYTE, 0, 0, WakeComm);
+  }
+
+  /* Start serving the window's current epoch. */
+  void activate(rma_analyzer_state *state) {
+    if (!Thread.joinable()) {
+      if (FinalizeKeyval == MPI_KEYVAL_INVALID) {
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, onFinalize,
+                               &FinalizeKeyval, nullptr);
+        MPI_Comm_set_attr(MPI_COMM_SELF, FinalizeKeyval, this);
+      }
+      MPI_Comm_dup(MPI_COMM_SELF, &WakeComm);
+      Thread = thread(&ProgressEngine::run, this);
+    }
+    {
+      scoped_lock Lock(Mutex);
+      state->epoch_done = 0;
+      Starting.push_back(state);
+      Pending = true;
     }
+    wake();
   }
 
-  /* No tag found, return an error as -1 */
-  return -1;
-}
+  /* Wait until all the accesses of the window's epoch have been received.
+   * The number of expected messages must have been set in state->value. */
+  void waitForEpochEnd(rma_analyzer_state *state) {
+    {
+      scoped_lock Lock(Mutex);
+      state->thread_end = 1;
+      Pending = true;
+    }
+    wake();
+    unique_lock Lock(Mutex);
+    CV.wait(Lock, [&]() { return state->epoch_done == 1; });
+  }
 
-/* Gives the tag range back to the RMA analyzer to use it for a newly
- * allocated window */
-void rma_analyzer_free_tag_range(int tag_id) {
-  int id = (tag_id - RMA_ANALYZER_BASE_MPI_TAG) / RMA_ANALYZER_MAX_EPOCH_NUMBER;
-  win_mpi_tag_id[id] = 0;
-}
+  /* Stop the thread. The epochs of the windows it still serves are never
+   * ended, their receives are cancelled. */
+  void stop() {
+    if (!Thread.joinable()) {
+      return;
+    }
+    {
+      scoped_lock Lock(Mutex);
+      Stop = true;
+    }
+    wake();
+    Thread.join();
+    Stop = false;
+    /* Drop the wake up messages the engine didn't need */
+    int flag = 1;
+    while (flag) {
+      MPI_Iprobe(0, 0, WakeComm, &flag, MPI_STATUS_IGNORE);
+      if (flag) {
+        MPI_Recv(nullptr, 0, MPI_BYTE, 0, 0, WakeComm, MPI_STATUS_IGNORE);
+      }
+    }
+    MPI_Comm_free(&WakeComm);
+  }
+
+  void run() {
+    vector<rma_analyzer_state *> Served;
+    vector<MPI_Request> Requests;
+    MPI_Request WakeRequest;
+    MPI_Irecv(nullptr, 0, MPI_BYTE, 0, 0, WakeComm, &WakeRequest);
+
+    while (true) {
+      {
+        unique_lock Lock(Mutex);
+        if (Served.empty()) {
+          CV.wait(Lock, [&]() { return Pending || Stop; });
+        }
+        if (Stop) {
+          for (rma_analyzer_state *state : Served) {
+            MPI_Cancel(&state->recv_request);
+            MPI_Wait(&state->recv_request, MPI_STATUS_IGNORE);
+          }
+          break;
+        }
+        Pending = false;
+        for (rma_analyzer_state *state : Starting) {
+          rma_analyzer_post_receive(state);
+          Served.push_back(state);
+        }
+        Starting.clear();
+
+        /* Stop serving windows which received everything for their epoch */
+        auto Done = [&](rma_analyzer_state *state) {
+          if (state->thread_end == 0 || state->count != state->value) {
+            return false;
+          }
+          MPI_Cancel(&state->recv_request);
+          MPI_Wait(&state->recv_request, MPI_STATUS_IGNORE);
+          state->epoch_done = 1;
+          return true;
+        };
+        size_t Before = Served.size();
+        Served.erase(remove_if(Served.begin(), Served.end(), Done),
+                     Served.end());
+        if (Served.size() != Before) {
+          CV.notify_all();
+        }
+      }
+      if (Served.empty()) {
+        continue;
+      }
+
+      Requests.clear();
+      Requests.push_back(WakeRequest);
+      for (rma_analyzer_state *state : Served) {
+        Requests.push_back(state->recv_request);
+      }
+      int Index;
+      MPI_Status status;
+      MPI_Waitany(Requests.size(), Requests.data(), &Index, &status);
+      if (Index == 0) {
+        MPI_Irecv(nullptr, 0, MPI_BYTE, 0, 0, WakeComm, &WakeRequest);
+        continue;
+      }
+      rma_analyzer_state *state = Served[Index - 1];
+      rma_analyzer_check_received(state, status);
+      rma_analyzer_post_receive(state);
+    }
+
+    MPI_Cancel(&WakeRequest);
+    MPI_Wait(&WakeRequest, MPI_STATUS_IGNORE);
+  }
+};
+
+ProgressEngine Engine;
 
 } // namespace
 
 IntervalViewContainer
 rma_analyzer_state::getIntersectingIntervals(Access const &A) const {
   IntervalViewContainer Ret;
-  // Find the first neighbor > A
-  auto ItNeighbor = Intervals.upper_bound(A);
-  // Add neighbors from It to End, exit early when finding a non-intersecting.
-  auto AddNeighbors = [&](auto It, auto End) {
-    while (It != End) {
-      if (It->Itv.intersects(A.Itv)) {
-        Ret.insert(std::ref(*It));
-      } else {
-        // We found the first neighbors non-intersecting, we can exit the loop.
-        break;
-      }
-      ++It;
-    }
-  };
-  AddNeighbors(ItNeighbor, Intervals.end());
-  AddNeighbors(make_reverse_iterator(ItNeighbor), Intervals.rend());
+  auto Add = [&](Access const &Current) { Ret.emplace_back(Current); };
+  Intervals.forEachIntersecting(A.Itv, Add);
+  if (Shadow) {
+    Shadow->forEachIntersecting(A.Itv, Add);
+  }
   return Ret;
 }
 
 IntervalViewContainer
 rma_analyzer_state::getConflictingIntervals(Access const &A) const {
   IntervalViewContainer Ret;
-  for (Access const &Current : getIntersectingIntervals(A)) {
-    if (Current.conflictsWith(A)) {
-      Ret.insert(std::ref(Current));
-    }
-  }
+  auto Add = [&](Access const &Current) { Ret.emplace_back(Current); };
+  rma_analyzer_split_access(
+      this, A,
+      [&](Access const &Part) {
+        Intervals.forEachIntersecting(Part.Itv, [&](Access const &Current) {
+          if (Current.conflictsWith(Part)) {
+            Add(Current);
+          }
+        });
+      },
+      [&](Access const &Part) { Shadow->forEachConflicting(Part, Add); });
   return Ret;
 }
 
@@ -224,15 +576,19 @@ rma_analyzer_state::getConflictingIntervals(Access const &A) const {
 
 /* Get the RMA analyzer state associated to the window */
 extern "C" rma_analyzer_state *rma_analyzer_get_state(MPI_Win win) {
-  auto &State = States[win];
+  rma_analyzer_state *State = nullptr;
+  int found = 0;
+  if (StateKeyval != MPI_KEYVAL_INVALID) {
+    MPI_Win_get_attr(win, StateKeyval, &State, &found);
+  }
 
-  if (!State) {
+  if (!found) {
     RMA_DEBUG(cerr << "Error : no state found for " << (void *)win << " in "
                    << __func__ << ", exiting now\n");
     exit(EXIT_FAILURE);
   }
 
-  return State.get();
+  return State;
 }
 
 /* Save the interval given in parameter in all active windows.
@@ -246,7 +602,12 @@ extern "C" void rma_analyzer_save_interval_all_wins(Access Acc) {
   //  count = 0;
   // }
   RMA_DEBUG(cerr << "rma_save_interval_all_wins\n");
-  for (auto &[_, State] : States) {
+  if (rma_analyzer_defer_local_checks) {
+    rma_analyzer_record_local_access(Acc);
+    return;
+  }
+  shared_lock StatesLock(StatesMutex);
+  for (auto &State : States) {
     if (rma_analyzer_is_active_epoch(State->state_win)) {
       RMA_DEBUG(cerr << "saving interval to all win: " << Acc << "\n");
       rma_analyzer_save_interval(std::move(Acc), State->state_win);
@@ -255,29 +616,40 @@ extern "C" void rma_analyzer_save_interval_all_wins(Access Acc) {
 }
 
 /* This routine initializes the state variables needed for the
- * communication checking thread to work and starts it. */
+ * communication checking to work, and has the progress engine serve the
+ * window. */
 extern "C" void rma_analyzer_init_comm_check_thread(MPI_Win win) {
   RMA_DEBUG(cerr << "Getting state in " << __func__ << "\n");
   rma_analyzer_state *state = rma_analyzer_get_state(win);
 
+  /* Deferred local accesses happened before this epoch: check them before
+   * the set of active windows changes. */
+  rma_analyzer_flush_local_buffers();
+
   for (int i = 0; i < state->size_comm; i++) {
     state->array[i] = 0;
   }
   state->thread_end = 0;
   state->count_epoch++;
+  if (!state->active_epoch) {
+    rma_analyzer_active_epochs++;
+  }
   state->active_epoch = 1;
 
-  state->Thread = thread(&rma_analyzer_comm_check_thread, win);
+  Engine.activate(state);
 }
 
-/* This routine clears the state variables needed for the
- * communication checking thread to work. It should be called after
- * any call to pthread_join() for the communication checking thread. */
+/* This routine waits for the progress engine to receive all the accesses
+ * of the window's epoch, and clears the state variables needed for the
+ * communication checking to work. */
 extern "C" void rma_analyzer_clear_comm_check_thread(int do_reduce,
                                                      MPI_Win win) {
   RMA_DEBUG(cerr << "Getting state in " << __func__ << "\n");
   rma_analyzer_state *state = rma_analyzer_get_state(win);
 
+  /* Check the deferred local accesses of this epoch. */
+  rma_analyzer_flush_local_buffers();
+
   int my_rank;
   MPI_Comm_rank(state->win_comm, &my_rank);
 
@@ -286,15 +658,19 @@ extern "C" void rma_analyzer_clear_comm_check_thread(int do_reduce,
     RMA_DEBUG(cerr << "Array elements: " << state->array[i] << "\n");
   }
 
+  /* Send the remaining accesses of this epoch to their targets */
+  rma_analyzer_flush_all_outgoing(state, do_reduce);
+
   /* Get the number of expected communications on each process, to be
    * able to detect the termination of communication checking. If
-   * specified in the routine call, do the reduce, else just affects
-   * zero to the number of communication the thread waits for. */
+   * specified in the routine call, sum the number of messages sent to
+   * each process and scatter the result in a single collective, else just
+   * affects zero to the number of communication the thread waits for. */
   if (do_reduce) {
-    for (int i = 0; i < state->size_comm; i++) {
-      MPI_Reduce(&(state->array[i]), (void *)(&state->value), 1, MPI_INT,
-                 MPI_SUM, i, state->win_comm);
-    }
+    int expected = 0;
+    MPI_Reduce_scatter_block(state->array.get(), &expected, 1, MPI_INT,
+                             MPI_SUM, state->win_comm);
+    state->value = expected;
   } else {
     state->value = 0;
   }
@@ -302,24 +678,31 @@ extern "C" void rma_analyzer_clear_comm_check_thread(int do_reduce,
   RMA_DEBUG(cerr << "I'm process " << my_rank << " I expect " << state->value
                  << " comms.\n");
 
-  /* Switch the flag to check the end of the thread, and wait for it */
-  state->thread_end = 1;
-  state->Thread.join();
-  RMA_DEBUG(cerr << "I passed the pthread join\n");
+  /* Wait for the progress engine to receive everything for this epoch */
+  Engine.waitForEpochEnd(state);
+  RMA_DEBUG(cerr << "I passed the end of the epoch\n");
 
-  /* Clear the state of the communication checking thread */
+  /* Clear the state of the communication checking, other application threads
+   * may be draining their buffers in it */
+  scoped_lock Lock(state->ListMutex);
   state->count = 0;
+  if (state->active_epoch) {
+    rma_analyzer_active_epochs--;
+  }
   state->active_epoch = 0;
   state->Intervals.clear();
+  if (state->Shadow) {
+    state->Shadow->clear();
+  }
 }
 
 /* This routine initializes the state variables needed for the communication
- * checking thread to work and starts it on all windows that have been cleared
- * by a synchronization. This is particularly used for in-window
+ * checking to work and has the progress engine serve all windows that have
+ * been cleared by a synchronization. This is particularly used for in-window
  * synchronizations that are not attached to a specific window, such as
  * MPI_Barrier.  */
 extern "C" void rma_analyzer_init_comm_check_thread_all_wins() {
-  for (auto &[_, State] : States) {
+  for (rma_analyzer_state *State : rma_analyzer_get_states()) {
     /* Only restarts if the epoch has not been really stopped, but the flag has
      * been flipped by a synchronization inside the epoch */
     if ((0 == rma_analyzer_is_active_epoch(State->state_win)) &&
@@ -334,7 +717,7 @@ extern "C" void rma_analyzer_init_comm_check_thread_all_wins() {
  * in-window synchronizations that are not attached to a specific window, such
  * as Barrier.  */
 extern "C" void rma_analyzer_clear_comm_check_thread_all_wins(int do_reduce) {
-  for (auto &[_, State] : States) {
+  for (rma_analyzer_state *State : rma_analyzer_get_states()) {
     if (rma_analyzer_is_active_epoch(State->state_win)) {
       rma_analyzer_clear_comm_check_thread(do_reduce, State->state_win);
       State->from_sync = 1;
@@ -345,11 +728,10 @@ extern "C" void rma_analyzer_clear_comm_check_thread_all_wins(int do_reduce) {
 /* This routine takes care of the update of the local list with the
  * new interval and the sending of the detected interval to the remote
  * peer */
-// NOTE: The TargetAccess is intentionally "wrong": it doesn't take into
-// account the displacement unit, because we can only compute it when we
-// know the *target* window. Therefore we send the Acces "as-is" and we will
-// fix its interval when it reaches the target (see the fixForWindow call in
-// rma_analyzer_check_communication).
+// NOTE: The TargetAccess is intentionally "wrong": its lower bound is a
+// displacement, which doesn't take into account the target's displacement
+// unit. We fix it here, and the target will add its base address when it
+// receives it (see the fixForWindow call in rma_analyzer_check_received).
 extern "C" void rma_analyzer_update_on_comm_send(Access LocalAccess,
                                                  Access TargetAccess,
                                                  int target_rank, MPI_Win win) {
@@ -360,20 +742,10 @@ extern "C" void rma_analyzer_update_on_comm_send(Access LocalAccess,
 
   rma_analyzer_save_interval(std::move(LocalAccess), win);
 
+  TargetAccess.Itv.fixForWindow(0, state->disp_units[target_rank]);
   RMA_DEBUG(cerr << "TargetInterval: " << TargetAccess << "\n");
 
-  // print_interval(*target_itv);
-  /* Send the struct Interval with interval_datatype MPI datatype to the target
-   */
-  MPI_Send(&TargetAccess, 1, state->interval_datatype, target_rank,
-           state->mpi_tag + state->count_epoch, state->win_comm);
-
-  string const &Filename = TargetAccess.Dbg.Filename;
-  MPI_Send(Filename.c_str(), Filename.size(), MPI_CHAR, target_rank,
-           RMA_ANALYZER_STRING_MPI_TAG, state->win_comm);
-
-  /* Increment number of communications sent to the target */
-  state->array[target_rank]++;
+  rma_analyzer_buffer_outgoing(state, TargetAccess, target_rank);
 }
 
 /* Initialize the RMA analyzer */
@@ -387,44 +759,64 @@ extern "C" void rma_analyzer_start(void *base, MPI_Aint size, MPI_Comm comm,
     rma_analyzer_filter_window = atoi(tmp);
   }
 
+  /* Check if loads and stores should be checked at epoch boundaries */
+  tmp = getenv("RMA_ANALYZER_DEFER_LOCAL_CHECKS");
+  if (tmp) {
+    rma_analyzer_defer_local_checks = atoi(tmp);
+  }
+
+  /* Check if the accesses within the window should be tracked by a shadow
+   * memory */
+  tmp = getenv("RMA_ANALYZER_SHADOW_MEMORY");
+  if (tmp) {
+    rma_analyzer_shadow_memory = atoi(tmp);
+  }
+
   unique_ptr<rma_analyzer_state> new_state = make_unique<rma_analyzer_state>();
 
   new_state->disp_unit = disp_unit;
   new_state->state_win = *win;
   new_state->win_base = (uint64_t)base;
   new_state->win_size = (size_t)size;
-  new_state->win_comm = comm;
+  if (rma_analyzer_shadow_memory && size > 0) {
+    new_state->Shadow = make_unique<ShadowMemory>(new_state->win_base,
+                                                  new_state->win_size);
+  }
+  /* Use our own communicator so that our messages can't be mixed up with
+   * the application's or with another window's */
+  MPI_Comm_dup(comm, &new_state->win_comm);
   MPI_Comm_size(new_state->win_comm, &(new_state->size_comm));
   new_state->array = std::make_unique<int[]>(new_state->size_comm);
+  new_state->SentFilenames.resize(new_state->size_comm);
+  new_state->ReceivedFilenames.resize(new_state->size_comm);
+  new_state->OutgoingAccesses.resize(new_state->size_comm);
+
+  /* Origins take the target's displacement unit into account before sending
+   * accesses, so that they can merge them */
+  new_state->disp_units.resize(new_state->size_comm);
+  MPI_Allgather(&disp_unit, 1, MPI_INT, new_state->disp_units.data(), 1,
+                MPI_INT, new_state->win_comm);
 
   /* Create the MPI Datatype needed to exchange intervals */
-  // Send everything but the last element of the struct which is a string:
-  // it has to be sent separately.
-  int struct_size = sizeof(Access) - sizeof(string);
+  int struct_size = sizeof(Access);
   RMA_DEBUG(cerr << "Creating type: " << struct_size << ", " << (void *)MPI_BYTE
                  << ", " << &(new_state->interval_datatype) << "\n");
   MPI_Type_contiguous(struct_size, MPI_BYTE, &(new_state->interval_datatype));
   MPI_Type_commit(&new_state->interval_datatype);
 
-  /* Get the tag range that the RMA analyzer will be able to use for
-   * this specific window */
-  int tag_id = rma_analyzer_get_tag_range_id();
-  if (tag_id < 0) {
-    RMA_DEBUG({
-      cerr << "Error : no tag to use. Please check if you have allocated more "
-              "than "
-           << RMA_ANALYZER_MAX_WIN << " windows simultaneously.\n";
-    });
-  }
-  new_state->mpi_tag =
-      RMA_ANALYZER_BASE_MPI_TAG + (RMA_ANALYZER_MAX_EPOCH_NUMBER * tag_id);
-  RMA_DEBUG(cerr << "Got tag " << new_state->mpi_tag << "\n");
-
   RMA_DEBUG(cerr << "New state window added for window "
                  << (void *)new_state->state_win
                  << ". Win addr: " << new_state->win_base << " ("
                  << (void *)new_state->win_base << ").\n");
-  States.emplace(*win, std::move(new_state));
+  if (StateKeyval == MPI_KEYVAL_INVALID) {
+    MPI_Win_create_keyval(MPI_WIN_NULL_COPY_FN, MPI_WIN_NULL_DELETE_FN,
+                          &StateKeyval, nullptr);
+  }
+  MPI_Win_set_attr(*win, StateKeyval, new_state.get());
+  {
+    scoped_lock Lock(StatesMutex);
+    States.push_back(std::move(new_state));
+  }
 
   RMA_DEBUG({
     int r;
@@ -440,7 +832,20 @@ extern "C" void rma_analyzer_stop(MPI_Win win) {
   printf("PARCOACH: stopping RMA analyzer, no issues found.\n");
   rma_analyzer_state *state = rma_analyzer_get_state(win);
 
-  rma_analyzer_free_tag_range(state->mpi_tag);
   MPI_Type_free(&state->interval_datatype);
-  States.erase(win);
+  MPI_Comm_free(&state->win_comm);
+  MPI_Win_delete_attr(win, StateKeyval);
+  bool NoWindowLeft;
+  {
+    scoped_lock Lock(StatesMutex);
+    States.erase(
+        find_if(States.begin(), States.end(),
+                [&](auto const &State) { return State.get() == state; }));
+    NoWindowLeft = States.empty();
+  }
+
+  /* Don't keep the progress engine around when no window needs it */
+  if (NoWindowLeft) {
+    Engine.stop();
+  }
 }
@@ -2,48 +2,78 @@
 #define __RMA_ANALYZER__H__
 
 #include "Interval.h"
+#include "IntervalTree.h"
+#include "ShadowMemory.h"
+
 #include <mpi.h>
 
-#include <limits>
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <thread>
-
-#define RMA_ANALYZER_BASE_MPI_TAG std::numeric_limits<unsigned short>::max()
-/* Maximum number of epochs during the lifetime of a window */
-#define RMA_ANALYZER_MAX_EPOCH_NUMBER 1024
-/* Maximum number of windows supported simultaneously */
-#define RMA_ANALYZER_MAX_WIN 32
-// FIXME: check this work on relatively big example; otherwise we might need
-// to create two unique tags per window/epoch.
-#define RMA_ANALYZER_STRING_MPI_TAG                                            \
-  std::numeric_limits<unsigned short>::max() - 1
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Tag used to send filenames on the window's communicator */
+#define RMA_ANALYZER_FILENAME_TAG 0
+/* Number of tags cycled through by epochs, so that the accesses of two
+ * consecutive epochs can't be mixed up. Tags start at 1 and stay within the
+ * minimal MPI_TAG_UB guaranteed by the standard. */
+#define RMA_ANALYZER_EPOCH_TAGS 32766
+/* Number of loads and stores each thread can record before checking them,
+ * when local checks are deferred */
+#define RMA_ANALYZER_LOCAL_BUFFER_SIZE 4096
+/* Maximum number of accesses sent to a target in a single message */
+#define RMA_ANALYZER_BATCH_SIZE 256
 
 #define DO_REDUCE 1
 
 /* This structure contains the global state of the RMA analyzer
  * associated to a specific window */
 struct rma_analyzer_state {
-  /* Key of RMA analyzer state hash table */
+  /* Window this state is attached to */
   MPI_Win state_win;
-  std::thread Thread;
   std::mutex ListMutex;
-  parcoach::rma::IntervalContainer Intervals;
+  parcoach::rma::IntervalTree Intervals;
+  /* When enabled, the accesses within the window are tracked here rather
+   * than in Intervals */
+  std::unique_ptr<parcoach::rma::ShadowMemory> Shadow;
   uint64_t win_base{};
   int disp_unit{};
+  /* Displacement unit of each rank of the window */
+  std::vector<int> disp_units;
   size_t win_size{};
+  /* Duplicate of the window's communicator, private to the analyzer */
   MPI_Comm win_comm;
   MPI_Datatype interval_datatype;
   int size_comm{};
-  int mpi_tag{};
   std::unique_ptr<int[]> array;
+  /* For each rank, the filename ids already sent to it */
+  std::vector<std::vector<bool>> SentFilenames;
+  /* Filenames sent during the current epoch, and their pending sends */
+  std::deque<std::string> FilenameMessages;
+  std::vector<MPI_Request> FilenameRequests;
+  /* For each rank, the mapping from its filename ids to ours */
+  std::vector<std::unordered_map<uint32_t, uint32_t>> ReceivedFilenames;
+  /* For each rank, the accesses not sent yet */
+  std::mutex OutgoingMutex;
+  std::vector<std::vector<parcoach::rma::Access>> OutgoingAccesses;
   int volatile value{};
   int volatile thread_end{};
   int volatile count_epoch{};
   int volatile count_fence{};
   int volatile count{};
-  int volatile active_epoch{};
+  /* Read by application threads checking their local accesses */
+  std::atomic<int> active_epoch{};
   int volatile from_sync{};
+  /* Set by the progress engine once everything has been received for the
+   * current epoch */
+  int volatile epoch_done{};
+  /* Pending receive for the current epoch, and its buffer */
+  MPI_Request recv_request{MPI_REQUEST_NULL};
+  std::vector<parcoach::rma::Access> Received;
+  int epoch_tag() const { return 1 + count_epoch % RMA_ANALYZER_EPOCH_TAGS; }
   parcoach::rma::IntervalViewContainer
   getIntersectingIntervals(parcoach::rma::Access const &I) const;
   parcoach::rma::IntervalViewContainer
@@ -56,17 +86,18 @@ extern "C" {
 rma_analyzer_state *rma_analyzer_get_state(MPI_Win win);
 
 /* This routine initializes the state variables needed for the
- * communication checking thread to work and starts it. */
+ * communication checking to work, and has the progress engine serve the
+ * window. */
 void rma_analyzer_init_comm_check_thread(MPI_Win win);
 
-/* This routine clears the state variables needed for the
- * communication checking thread to work. It should be called after
- * any call to pthread_join(); for the communication checking thread. */
+/* This routine waits for the progress engine to receive all the accesses
+ * of the window's epoch, and clears the state variables needed for the
+ * communication checking to work. */
 void rma_analyzer_clear_comm_check_thread(int do_reduce, MPI_Win win);
 
 /* This routine initializes the state variables needed for the communication
- * checking thread to work and starts it on all windows that have been cleared
- * by a synchronization. This is particularly used for in-window
+ * checking to work and has the progress engine serve all windows that have
+ * been cleared by a synchronization. This is particularly used for in-window
  * synchronizations that are not attached to a specific window, such as
  * MPI_Barrier.  */
 void rma_analyzer_init_comm_check_thread_all_wins();
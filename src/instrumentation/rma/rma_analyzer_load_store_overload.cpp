@@ -2,6 +2,34 @@
 #include "util.h"
 
 using namespace parcoach::rma;
+
+namespace {
+/* Save the accesses to count elements of size bytes, separated by stride
+ * bytes and starting at address. When the elements are contiguous, they are
+ * saved as a single access covering all of them. */
+void rma_analyzer_save_strided_accesses(uint64_t address, int64_t stride,
+                                        uint64_t count, uint64_t size,
+                                        AccessType type, DebugInfo Dbg) {
+  if (count == 0) {
+    return;
+  }
+  uint64_t abs_stride = stride < 0 ? -(uint64_t)stride : (uint64_t)stride;
+  /* Start from the lowest element, whatever the direction of the loop. */
+  if (stride < 0) {
+    address -= (count - 1) * abs_stride;
+  }
+  if (abs_stride <= size) {
+    rma_analyzer_save_interval_all_wins(Access(
+        MemoryAccess{address, (count - 1) * abs_stride + size}, type, Dbg));
+    return;
+  }
+  for (uint64_t i = 0; i < count; i++) {
+    rma_analyzer_save_interval_all_wins(
+        Access(MemoryAccess{address + i * abs_stride, size}, type, Dbg));
+  }
+}
+} // namespace
+
 extern "C" {
 void parcoach_rma_store(void *addr, uint64_t size, int line, char *filename) {
   uint64_t address = (uint64_t)addr;
@@ -26,4 +54,24 @@ void parcoach_rma_load(void *addr, uint64_t size, int line, char *filename) {
                                              AccessType::LOCAL_READ,
                                              DebugInfo(line, filename)));
 }
+
+/* Range accesses stand for all the accesses done by a loop, they are
+ * inserted by the instrumentation before loops with affine accesses. */
+void parcoach_rma_store_range(void *addr, int64_t stride, uint64_t count,
+                              uint64_t size, int line, char *filename) {
+  RMA_DEBUG(std::cerr << "Store range " << addr << " stride " << stride
+                      << " count " << count << "\n");
+  rma_analyzer_save_strided_accesses((uint64_t)addr, stride, count, size / 8,
+                                     AccessType::LOCAL_WRITE,
+                                     DebugInfo(line, filename));
+}
+
+void parcoach_rma_load_range(void *addr, int64_t stride, uint64_t count,
+                             uint64_t size, int line, char *filename) {
+  RMA_DEBUG(std::cerr << "Load range " << addr << " stride " << stride
+                      << " count " << count << "\n");
+  rma_analyzer_save_strided_accesses((uint64_t)addr, stride, count, size / 8,
+                                     AccessType::LOCAL_READ,
+                                     DebugInfo(line, filename));
+}
 }
@@ -0,0 +1,236 @@
+#include "parcoach/RMAPasses.h"
+
+#include "PTACallGraph.h"
+#include "Utils.h"
+
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace llvm;
+
+namespace parcoach::rma {
+
+namespace {
+
+enum class EpochEffect { None, Start, End };
+
+EpochEffect getEpochEffect(Function const &F) {
+  return StringSwitch<EpochEffect>(F.getName())
+#define RMA_INSTRUMENTED(Name, FName, Epoch)                                   \
+  .Case(#Name, EpochEffect::Epoch).Case(#FName, EpochEffect::Epoch)
+#include "InstrumentedFunctions.def"
+      .Default(EpochEffect::None);
+}
+
+EpochInfo::State operator|(EpochInfo::State A, EpochInfo::State B) {
+  return static_cast<EpochInfo::State>(A | static_cast<uint8_t>(B));
+}
+
+EpochInfo::State &operator|=(EpochInfo::State &A, EpochInfo::State B) {
+  return A = A | B;
+}
+
+EpochInfo::State applyEffect(EpochEffect Effect, EpochInfo::State S) {
+  switch (Effect) {
+  case EpochEffect::Start:
+    return EpochInfo::In;
+  case EpochEffect::End:
+    return EpochInfo::Out;
+  case EpochEffect::None:
+    break;
+  }
+  return S;
+}
+
+} // namespace
+
+class EpochSolver {
+  EpochInfo &Info;
+  Module &M;
+  // The states the program may be in when entering each function.
+  DenseMap<Function const *, EpochInfo::State> FunctionStates;
+  bool FunctionStatesChanged{};
+
+  // Propagate the given entry state through F, and return the states at its
+  // exits. If Record is set, the entry states of its blocks are recorded,
+  // and the callees' entry states are updated.
+  EpochInfo::State solve(Function const &F, EpochInfo::State Entry,
+                         bool Record);
+  void updateCallees(CallBase const &CB, EpochInfo::State S);
+
+public:
+  EpochSolver(EpochInfo &Info, Module &M) : Info(Info), M(M) {}
+  void computeSummaries();
+  void computeEntryStates();
+};
+
+EpochInfo::State EpochSolver::solve(Function const &F, EpochInfo::State Entry,
+                                    bool Record) {
+  DenseMap<BasicBlock const *, EpochInfo::State> States;
+  SmallVector<BasicBlock const *> Worklist;
+  EpochInfo::State Exit = EpochInfo::None;
+  if (Entry == EpochInfo::None) {
+    return Exit;
+  }
+  States[&F.getEntryBlock()] = Entry;
+  Worklist.push_back(&F.getEntryBlock());
+  while (!Worklist.empty()) {
+    BasicBlock const *BB = Worklist.pop_back_val();
+    EpochInfo::State S = States[BB];
+    for (Instruction const &I : *BB) {
+      S = Info.transfer(I, S);
+    }
+    if (isa<ReturnInst>(BB->getTerminator())) {
+      Exit |= S;
+    }
+    for (BasicBlock const *Succ : successors(BB)) {
+      EpochInfo::State &SuccS = States[Succ];
+      if ((SuccS | S) != SuccS) {
+        SuccS |= S;
+        Worklist.push_back(Succ);
+      }
+    }
+  }
+
+  if (Record) {
+    for (auto [BB, S] : States) {
+      Info.EntryStates[BB] = S;
+      for (Instruction const &I : *BB) {
+        if (auto const *CB = dyn_cast<CallBase>(&I)) {
+          updateCallees(*CB, S);
+        }
+        S = Info.transfer(I, S);
+      }
+    }
+  }
+  return Exit;
+}
+
+void EpochSolver::updateCallees(CallBase const &CB, EpochInfo::State S) {
+  auto Update = [&](Function const *Callee) {
+    if (Callee->isDeclaration()) {
+      return;
+    }
+    EpochInfo::State &CalleeS = FunctionStates[Callee];
+    if ((CalleeS | S) != CalleeS) {
+      CalleeS |= S;
+      FunctionStatesChanged = true;
+    }
+  };
+  if (Function const *Callee = CB.getCalledFunction()) {
+    Update(Callee);
+  } else {
+    for (Function const *Callee : getRange(Info.CG.getIndirectCallMap(), &CB)) {
+      Update(Callee);
+    }
+  }
+}
+
+void EpochSolver::computeSummaries() {
+  // Iterate until reaching a fixed point: summaries only grow, and the
+  // transfer function is monotonic.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (Function const &F : M) {
+      if (F.isDeclaration()) {
+        continue;
+      }
+      std::array<EpochInfo::State, 2> Summary = {
+          solve(F, EpochInfo::Out, false),
+          solve(F, EpochInfo::In, false),
+      };
+      std::array<EpochInfo::State, 2> &Old = Info.Summaries[&F];
+      if (Summary != Old) {
+        Old = Summary;
+        Changed = true;
+      }
+    }
+  }
+}
+
+void EpochSolver::computeEntryStates() {
+  // The program starts out of any epoch, and we can't know anything about
+  // the functions which may be entered from outside of the module: the ones
+  // other modules or callbacks may call, and all of them if the module has no
+  // main.
+  Function const *Main = M.getFunction("main");
+  bool HasMain = Main && !Main->isDeclaration();
+  for (Function const &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+    if (&F == Main) {
+      FunctionStates[&F] = EpochInfo::Out;
+    } else if (!HasMain || !F.hasLocalLinkage() || F.hasAddressTaken() ||
+               !Info.CG.isReachableFromEntry(F)) {
+      FunctionStates[&F] = EpochInfo::Any;
+    }
+  }
+
+  do {
+    FunctionStatesChanged = false;
+    for (Function const &F : M) {
+      if (!F.isDeclaration()) {
+        solve(F, FunctionStates.lookup(&F), true);
+      }
+    }
+  } while (FunctionStatesChanged);
+}
+
+EpochInfo::State EpochInfo::getEntryState(BasicBlock const &BB) const {
+  return EntryStates.lookup(&BB);
+}
+
+EpochInfo::State EpochInfo::transfer(Instruction const &I, State S) const {
+  // Invokes start and end epochs as well.
+  auto const *CB = dyn_cast<CallBase>(&I);
+  if (!CB || S == None) {
+    return S;
+  }
+
+  auto Apply = [&](Function const *Callee) {
+    if (Callee->isDeclaration()) {
+      return applyEffect(getEpochEffect(*Callee), S);
+    }
+    auto It = Summaries.find(Callee);
+    if (It == Summaries.end()) {
+      return None;
+    }
+    State Res = None;
+    if (S & Out) {
+      Res |= It->second[0];
+    }
+    if (S & In) {
+      Res |= It->second[1];
+    }
+    return Res;
+  };
+
+  if (Function const *Callee = CB->getCalledFunction()) {
+    return Apply(Callee);
+  }
+  auto Callees = getRange(CG.getIndirectCallMap(), CB);
+  if (Callees.empty()) {
+    return S;
+  }
+  State Res = None;
+  for (Function const *Callee : Callees) {
+    Res |= Apply(Callee);
+  }
+  return Res;
+}
+
+AnalysisKey RMAEpochAnalysis::Key;
+
+RMAEpochAnalysis::Result RMAEpochAnalysis::run(Module &M,
+                                               ModuleAnalysisManager &AM) {
+  TimeTraceScope TTS("RMAEpochAnalysis");
+  EpochInfo Res(*AM.getResult<PTACallGraphAnalysis>(M));
+  EpochSolver Solver(Res, M);
+  Solver.computeSummaries();
+  Solver.computeEntryStates();
+  return Res;
+}
+
+} // namespace parcoach::rma
@@ -0,0 +1,113 @@
+#include "parcoach/RMAPasses.h"
+
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/InstIterator.h"
+
+#include <optional>
+#include <vector>
+
+using namespace llvm;
+
+namespace parcoach::rma {
+
+namespace {
+
+// The argument through which a call gives a buffer to RMA operations, and
+// whether it's a pointer to the buffer's address (as for MPI_Win_allocate)
+// rather than the buffer's address itself.
+struct ExposedArg {
+  unsigned Pos;
+  bool Indirect;
+};
+
+std::optional<ExposedArg> getExposedArg(CallBase const &CB) {
+  if (!CB.getCalledFunction()) {
+    return {};
+  }
+  return StringSwitch<std::optional<ExposedArg>>(
+             CB.getCalledFunction()->getName())
+      .Cases("MPI_Win_create", "mpi_win_create_", ExposedArg{0, false})
+      .Cases("MPI_Win_allocate", "mpi_win_allocate_", ExposedArg{4, true})
+      .Cases("MPI_Win_allocate_shared", "mpi_win_allocate_shared_",
+             ExposedArg{4, true})
+      .Cases("MPI_Put", "mpi_put_", ExposedArg{0, false})
+      .Cases("MPI_Get", "mpi_get_", ExposedArg{0, false})
+      .Cases("MPI_Accumulate", "mpi_accumulate_", ExposedArg{0, false})
+      .Default({});
+}
+
+} // namespace
+
+bool ExposedMemory::mayBeExposed(Value const *Ptr) const {
+  return Unknown || AA.mayPointToAny(Ptr, Objects);
+}
+
+AnalysisKey RMAExposedMemoryAnalysis::Key;
+
+RMAExposedMemoryAnalysis::Result
+RMAExposedMemoryAnalysis::run(Module &M, ModuleAnalysisManager &AM) {
+  TimeTraceScope TTS("RMAExposedMemoryAnalysis");
+  Andersen const &AA = AM.getResult<AndersenAA>(M);
+  ExposedMemory Res(AA);
+  // The memory the points-to analysis knows nothing about may always be
+  // exposed.
+  Res.Objects.insert(AA.getUniversalObjNode());
+
+  AndersPtsSet Pts;
+  AndersPtsSet BufferPts;
+  // The other modules may expose the globals they can see, and the memory
+  // reachable from them.
+  std::vector<NodeIndex> Reachable;
+  for (GlobalVariable const &GV : M.globals()) {
+    if (GV.hasLocalLinkage()) {
+      continue;
+    }
+    if (!AA.getPointsToNodes(&GV, Pts)) {
+      Res.Unknown = true;
+      return Res;
+    }
+    for (NodeIndex Obj : Pts) {
+      if (Res.Objects.insert(Obj)) {
+        Reachable.push_back(Obj);
+      }
+    }
+  }
+  while (!Reachable.empty()) {
+    NodeIndex Obj = Reachable.back();
+    Reachable.pop_back();
+    AA.getPointsToNodes(Obj, Pts);
+    for (NodeIndex Pointee : Pts) {
+      if (Res.Objects.insert(Pointee)) {
+        Reachable.push_back(Pointee);
+      }
+    }
+  }
+
+  for (Function &F : M) {
+    for (Instruction &I : instructions(F)) {
+      auto *CB = dyn_cast<CallBase>(&I);
+      if (!CB) {
+        continue;
+      }
+      std::optional<ExposedArg> Arg = getExposedArg(*CB);
+      if (!Arg || Arg->Pos >= CB->arg_size()) {
+        continue;
+      }
+      if (!AA.getPointsToNodes(CB->getArgOperand(Arg->Pos), Pts)) {
+        Res.Unknown = true;
+        return Res;
+      }
+      if (!Arg->Indirect) {
+        Res.Objects.unionWith(Pts);
+        continue;
+      }
+      for (NodeIndex Obj : Pts) {
+        AA.getPointsToNodes(Obj, BufferPts);
+        Res.Objects.unionWith(BufferPts);
+      }
+    }
+  }
+  return Res;
+}
+
+} // namespace parcoach::rma
@@ -1,12 +1,23 @@
 #include "parcoach/RMAPasses.h"
 
+#include "parcoach/Options.h"
+
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Analysis/DominanceFrontier.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/WithColor.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+#include <optional>
 
 using namespace llvm;
 
@@ -14,17 +25,28 @@ namespace parcoach::rma {
 
 namespace {
 
+cl::opt<bool> OptStaticPruning(
+    "rma-static-pruning",
+    cl::desc("only instrument the loads and stores which may access memory "
+             "exposed to RMA operations, according to the points-to analysis"),
+    cl::init(true), cl::cat(ParcoachCategory));
+
+cl::opt<bool> OptRangeInstrumentation(
+    "rma-range-instrumentation",
+    cl::desc("instrument the affine loads and stores of innermost loops with "
+             "a single range access before the loop"),
+    cl::init(true), cl::cat(ParcoachCategory));
+
 constexpr StringRef ParcoachPrefix = "parcoach_rma_";
 
-std::pair<bool, bool> getInstrumentationInfo(CallBase const &CB) {
+bool shouldInstrumentCall(CallBase const &CB) {
   if (!CB.getCalledFunction()) {
-    return {};
+    return false;
   }
-  return StringSwitch<std::pair<bool, bool>>(CB.getCalledFunction()->getName())
-#define RMA_INSTRUMENTED(Name, FName, ChangesEpoch)                            \
-  .Case(#Name, {true, ChangesEpoch}).Case(#FName, {true, ChangesEpoch})
+  return StringSwitch<bool>(CB.getCalledFunction()->getName())
+#define RMA_INSTRUMENTED(Name, FName, Epoch) .Cases(#Name, #FName, true)
 #include "InstrumentedFunctions.def"
-      .Default({});
+      .Default(false);
 }
 
 Twine getInstrumentedName(Function const &F) {
@@ -47,6 +69,20 @@ FunctionCallee getInstrumentedFunction(Function &F) {
                                             getInstrumentedFunctionType(F));
 }
 
+// Return a pointer to a constant holding the filename, shared by all the
+// instrumentation calls of the module: the runtime interns filenames based on
+// this pointer, so it's important to always pass the same one.
+Value *getFilenameConstant(IRBuilder<> &B, DebugLoc const &Dbg) {
+  StringRef Filename = Dbg ? Dbg->getFilename() : "?";
+  Module &M = *B.GetInsertBlock()->getModule();
+  std::string Name = ("parcoach_rma.filename." + Filename).str();
+  GlobalVariable *GV = M.getNamedGlobal(Name);
+  if (!GV) {
+    GV = B.CreateGlobalString(Filename, Name);
+  }
+  return B.CreateConstInBoundsGEP2_32(GV->getValueType(), GV, 0, 0);
+}
+
 CallInst *createInstrumentedCall(CallBase &CB) {
   IRBuilder<> B(&CB);
   SmallVector<Value *> Args(CB.args());
@@ -54,12 +90,7 @@ CallInst *createInstrumentedCall(CallBase &CB) {
   DebugLoc Dbg = CB.getDebugLoc();
 
   Args.push_back(B.getInt32(Dbg ? Dbg.getLine() : 0));
-  // FIXME: this creates one constant per call, even if the filename is the
-  // same.
-  // We should do a getOrInsertGlobal (where the name is the filename) to
-  // reuse existing constant.
-  StringRef Filename = Dbg ? Dbg->getFilename() : "?";
-  Args.push_back(B.CreateGlobalStringPtr(Filename));
+  Args.push_back(getFilenameConstant(B, Dbg));
 
   // We assume shouldInstrumentFunction is true and that getCalledFunction is
   // not null.
@@ -91,10 +122,8 @@ void insertInstrumentationCall(Instruction &I, Value *Addr, Type *Ty,
       B.getInt64(I.getModule()->getDataLayout().getTypeSizeInBits(Ty));
   DebugLoc Dbg = I.getDebugLoc();
   Constant *Line = B.getInt32(Dbg ? Dbg.getLine() : 0);
-  StringRef Filename = Dbg ? Dbg->getFilename() : "?";
-  Constant *ConstantFilename = B.CreateGlobalStringPtr(Filename);
 
-  B.CreateCall(CalledF, {Addr, Size, Line, ConstantFilename});
+  B.CreateCall(CalledF, {Addr, Size, Line, getFilenameConstant(B, Dbg)});
 }
 
 void insertInstrumentationCall(StoreInst &SI) {
@@ -106,6 +135,94 @@ void insertInstrumentationCall(LoadInst &LI) {
   insertInstrumentationCall(LI, LI.getPointerOperand(), LI.getType(), "load");
 }
 
+FunctionCallee getInstrumentationRangeFunction(Module &M, StringRef InstName) {
+  LLVMContext &Ctx = M.getContext();
+  std::array<Type *, 6> Args = {
+      Type::getInt8PtrTy(Ctx), Type::getInt64Ty(Ctx), Type::getInt64Ty(Ctx),
+      Type::getInt64Ty(Ctx),   Type::getInt32Ty(Ctx), Type::getInt8PtrTy(Ctx),
+  };
+  auto *CalledFTy = FunctionType::get(Type::getVoidTy(Ctx), Args, false);
+  return M.getOrInsertFunction((ParcoachPrefix + InstName + "_range").str(),
+                               CalledFTy);
+}
+
+// A load or store executed once per iteration of a loop, at an address which
+// is an affine function of the iteration number.
+struct RangeAccess {
+  Instruction *I;
+  SCEV const *Start;
+  int64_t Stride;
+};
+
+bool isSafeToExpandAt(ScalarEvolution &SE, SCEV const *S, BasicBlock *BB) {
+  // Only divisions by constants are sure not to trap.
+  auto MayTrap = [](SCEV const *E) {
+    auto const *Div = dyn_cast<SCEVUDivExpr>(E);
+    return Div && !isa<SCEVConstant>(Div->getRHS());
+  };
+  return SE.dominates(S, BB) && !SCEVExprContains(S, MayTrap);
+}
+
+// Return the number of iterations of L as an i64, if all its iterations
+// execute its whole body up to its latch, and if it doesn't call any function
+// (which could change epochs or do RMA operations).
+SCEV const *getRangeTripCount(Loop const &L, ScalarEvolution &SE) {
+  BasicBlock *Preheader = L.getLoopPreheader();
+  if (!L.isInnermost() || !Preheader || !L.getLoopLatch() ||
+      L.getExitingBlock() != L.getLoopLatch()) {
+    return nullptr;
+  }
+  for (BasicBlock *BB : L.blocks()) {
+    for (Instruction &I : *BB) {
+      if (isa<CallBase>(I) && !isa<IntrinsicInst>(I)) {
+        return nullptr;
+      }
+    }
+  }
+  SCEV const *BTC = SE.getBackedgeTakenCount(&L);
+  if (isa<SCEVCouldNotCompute>(BTC)) {
+    return nullptr;
+  }
+  Type *Int64Ty = Type::getInt64Ty(L.getHeader()->getContext());
+  SCEV const *Count = SE.getAddExpr(SE.getTruncateOrZeroExtend(BTC, Int64Ty),
+                                    SE.getOne(Int64Ty));
+  return isSafeToExpandAt(SE, Count, Preheader) ? Count : nullptr;
+}
+
+std::optional<RangeAccess> getRangeAccess(Instruction &I, Value *Ptr,
+                                          Loop const &L, ScalarEvolution &SE) {
+  auto const *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr));
+  if (!AR || AR->getLoop() != &L || !AR->isAffine()) {
+    return {};
+  }
+  auto const *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+  if (!Step ||
+      !isSafeToExpandAt(SE, AR->getStart(), L.getLoopPreheader())) {
+    return {};
+  }
+  return RangeAccess{&I, AR->getStart(), Step->getAPInt().getSExtValue()};
+}
+
+void insertRangeInstrumentationCall(RangeAccess const &RA, Value *Count,
+                                    SCEVExpander &Expander,
+                                    Instruction *InsertPt) {
+  Module &M = *InsertPt->getModule();
+  bool IsStore = isa<StoreInst>(RA.I);
+  Type *Ty = IsStore ? cast<StoreInst>(RA.I)->getValueOperand()->getType()
+                     : RA.I->getType();
+  FunctionCallee CalledF =
+      getInstrumentationRangeFunction(M, IsStore ? "store" : "load");
+
+  IRBuilder<> B(InsertPt);
+  Value *Start = Expander.expandCodeFor(RA.Start, B.getInt8PtrTy(), InsertPt);
+  Constant *Size = B.getInt64(M.getDataLayout().getTypeSizeInBits(Ty));
+  DebugLoc Dbg = RA.I->getDebugLoc();
+  Constant *Line = B.getInt32(Dbg ? Dbg.getLine() : 0);
+
+  B.CreateCall(CalledF, {Start, B.getInt64(RA.Stride), Count, Size, Line,
+                         getFilenameConstant(B, Dbg)});
+}
+
 auto MagentaErr = []() {
   return WithColor(errs(), raw_ostream::Colors::MAGENTA);
 };
@@ -120,107 +237,135 @@ public:
 
 private:
   static int CountLoad, CountStore, CountInstStore, CountInstLoad;
+  // The memory which may be accessed by RMA operations, or nullptr if every
+  // load and store in an epoch must be instrumented.
+  ExposedMemory const *Exposed{};
+  EpochInfo const *Epochs{};
+  // The loads and stores already instrumented by a range access.
+  SmallPtrSet<Instruction const *, 16> RangeInstrumented;
 
   // Instrumentation for dynamic analysis
-  bool hasWhiteSucc(BasicBlock *BB);
-  void instrumentMemAccessesIt(Function &F);
-  void dfsBb(BasicBlock *Bb, bool InEpoch);
-  static bool instrumentBb(BasicBlock &BB, bool InEpoch);
+  void instrumentMemAccesses(Function &F, FunctionAnalysisManager &FAM);
+  void instrumentLoopAccesses(Loop &L, ScalarEvolution &SE, DominatorTree &DT);
+  void instrumentBb(BasicBlock &BB);
+  bool mayBeExposed(Value const *Ptr) const {
+    return !Exposed || Exposed->mayBeExposed(Ptr);
+  }
   // Debug
 #ifndef NDEBUG
   static void printBB(BasicBlock *BB);
 #endif
   // Utils
   static void resetCounters();
-  enum Color { WHITE, GREY, BLACK };
-  using BBColorMap = DenseMap<BasicBlock const *, Color>;
-  using MemMap = ValueMap<Value *, Instruction *>;
-  BBColorMap ColorMap;
 };
 
-bool LocalConcurrencyDetection::instrumentBb(BasicBlock &Bb, bool InEpoch) {
-  bool NewEpoch = false;
+void LocalConcurrencyDetection::instrumentBb(BasicBlock &Bb) {
+  EpochInfo::State S = Epochs->getEntryState(Bb);
 
   // We use make_early_inc_range here because we may have to erase the
   // current instruction.
   for (Instruction &I : make_early_inc_range(Bb)) {
+    bool InEpoch = S & EpochInfo::In;
+    S = Epochs->transfer(I, S);
     if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-      auto [shouldInstrument, changesEpoch] = getInstrumentationInfo(*CI);
-      if (shouldInstrument) {
+      if (shouldInstrumentCall(*CI)) {
         CI->replaceAllUsesWith(createInstrumentedCall(*CI));
         CI->eraseFromParent();
-        NewEpoch = changesEpoch;
       }
     }
+    if (RangeInstrumented.contains(&I)) {
+      if (isa<StoreInst>(I)) {
+        CountStore++;
+      } else {
+        CountLoad++;
+      }
+      continue;
+    }
     if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
-      if (InEpoch || NewEpoch) {
+      if (InEpoch && mayBeExposed(SI->getPointerOperand())) {
         insertInstrumentationCall(*SI);
         CountInstStore++;
       }
       CountStore++;
     }
     if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-      if (InEpoch || NewEpoch) {
+      if (InEpoch && mayBeExposed(LI->getPointerOperand())) {
         insertInstrumentationCall(*LI);
         CountInstLoad++;
       }
       CountLoad++;
     }
   }
-  return NewEpoch ? !InEpoch : InEpoch;
 }
 
-// Instrument memory accesses (DFS is used to instrument only in epochs)
-// TODO: interprocedural info: start with the main function
+// Instrument the affine accesses of L with a single range access in its
+// preheader, instead of one access per iteration.
+void LocalConcurrencyDetection::instrumentLoopAccesses(Loop &L,
+                                                       ScalarEvolution &SE,
+                                                       DominatorTree &DT) {
+  if (!(Epochs->getEntryState(*L.getHeader()) & EpochInfo::In)) {
+    return;
+  }
+  SCEV const *TripCount = getRangeTripCount(L, SE);
+  if (!TripCount) {
+    return;
+  }
 
-bool LocalConcurrencyDetection::hasWhiteSucc(BasicBlock *BB) {
-  succ_iterator SI = succ_begin(BB);
-  succ_iterator E = succ_end(BB);
-  for (; SI != E; ++SI) {
-    BasicBlock *Succ = *SI;
-    if (ColorMap[Succ] == WHITE) {
-      return true;
+  SmallVector<RangeAccess> Accesses;
+  for (BasicBlock *BB : L.blocks()) {
+    // Only the accesses executed by every iteration can be described by a
+    // range access.
+    if (!DT.dominates(BB, L.getLoopLatch())) {
+      continue;
+    }
+    for (Instruction &I : *BB) {
+      Value *Ptr = getLoadStorePointerOperand(&I);
+      if (!Ptr || !mayBeExposed(Ptr)) {
+        continue;
+      }
+      if (auto RA = getRangeAccess(I, Ptr, L, SE)) {
+        Accesses.push_back(*RA);
+      }
     }
   }
-  return false;
-}
-
-// Iterative version
-void LocalConcurrencyDetection::instrumentMemAccessesIt(Function &F) {
-  // All BB must be white at the beginning
-  for (BasicBlock &BB : F) {
-    ColorMap[&BB] = WHITE;
+  if (Accesses.empty()) {
+    return;
   }
-  // start with entry BB
-  BasicBlock &Entry = F.getEntryBlock();
-  bool InEpoch = false;
-  std::deque<BasicBlock *> Unvisited;
-  Unvisited.push_back(&Entry);
-  InEpoch = instrumentBb(Entry, InEpoch);
-  ColorMap[&Entry] = GREY;
-
-  while (!Unvisited.empty()) {
-    BasicBlock *Header = *Unvisited.begin();
-
-    if (hasWhiteSucc(Header)) {
-      // inEpoch = InstrumentBB(*header, Ctx, datalayout, inEpoch);
-      succ_iterator SI = succ_begin(Header);
-      succ_iterator E = succ_end(Header);
-      for (; SI != E; ++SI) {
-        BasicBlock *Succ = *SI;
-        if (ColorMap[Succ] == WHITE) {
-          Unvisited.push_front(Succ);
-          InEpoch = instrumentBb(*Succ, InEpoch);
-          ColorMap[Succ] = GREY;
-        }
-      }
+
+  Instruction *InsertPt = L.getLoopPreheader()->getTerminator();
+  SCEVExpander Expander(SE, InsertPt->getModule()->getDataLayout(),
+                        "parcoach.rma");
+  Value *Count =
+      Expander.expandCodeFor(TripCount, TripCount->getType(), InsertPt);
+  for (RangeAccess const &RA : Accesses) {
+    insertRangeInstrumentationCall(RA, Count, Expander, InsertPt);
+    RangeInstrumented.insert(RA.I);
+    if (isa<StoreInst>(RA.I)) {
+      CountInstStore++;
     } else {
-      Unvisited.pop_front();
-      ColorMap[Header] = BLACK;
+      CountInstLoad++;
     }
   }
 }
 
+// Instrument the memory accesses which may happen within an epoch, according
+// to the interprocedural RMAEpochAnalysis.
+void LocalConcurrencyDetection::instrumentMemAccesses(
+    Function &F, FunctionAnalysisManager &FAM) {
+  RangeInstrumented.clear();
+  if (OptRangeInstrumentation) {
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      instrumentLoopAccesses(*L, SE, DT);
+    }
+  }
+  for (BasicBlock &BB : F) {
+    instrumentBb(BB);
+  }
+}
+
 #ifndef NDEBUG
 void LocalConcurrencyDetection::printBB(BasicBlock *Bb) {
   errs() << "DEBUG: BB ";
@@ -246,6 +391,12 @@ bool LocalConcurrencyDetection::runOnModule(Module &M,
   MagentaErr() << "===========================\n";
 
   auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  // This must be computed before instrumenting anything, as the points-to
+  // analysis refers to the calls we replace.
+  if (OptStaticPruning) {
+    Exposed = &AM.getResult<RMAExposedMemoryAnalysis>(M);
+  }
+  Epochs = &AM.getResult<RMAEpochAnalysis>(M);
 
   for (Function &F : M) {
     if (F.isDeclaration()) {
@@ -289,7 +440,7 @@ bool LocalConcurrencyDetection::runOnModule(Module &M,
 
     // Instrumentation of memory accesses for dynamic analysis
     CyanErr() << "(3) Instrumentation for dynamic analysis ...";
-    instrumentMemAccessesIt(F);
+    instrumentMemAccesses(F, FAM);
     CyanErr() << "done \n";
 
     // Print statistics per function
@@ -1,3 +1,4 @@
+#include "parcoach/ModuleSummary.h"
 #include "parcoach/Passes.h"
 
 #include "llvm/ADT/Triple.h"
@@ -76,6 +77,18 @@ cl::opt<std::string>
 static cl::opt<bool> ShowVersion("parcoach-version",
                                  cl::desc("Show PARCOACH version"));
 
+cl::list<std::string> LinkSummaries(
+    "link-summaries",
+    cl::desc("Combine the given module summaries (see -emit-summary) instead "
+             "of analyzing an input module"),
+    cl::CommaSeparated, cl::value_desc("filenames"));
+
+cl::opt<std::string> SummaryIndex(
+    "summary-index",
+    cl::desc("With -link-summaries, also write the combined summaries to this "
+             "file, to be used by -import-summaries"),
+    cl::value_desc("filename"));
+
 enum OutputKind {
   OK_NoOutput,
   OK_OutputAssembly,
@@ -129,6 +142,11 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  if (!LinkSummaries.empty()) {
+    bool Linked = parcoach::summary::linkSummaries(LinkSummaries, SummaryIndex);
+    return Linked ? 0 : 1;
+  }
+
   LLVMContext Context;
 
   SMDiagnostic Err;
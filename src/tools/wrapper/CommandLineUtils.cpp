@@ -52,6 +52,17 @@ ArgList BuildParcoachArgs(ArgList const &Argv, StringRef ParcoachBin,
   return ParcoachArgs;
 }
 
+ArgList BuildLinkSummariesArgs(ArgList const &Argv, StringRef ParcoachBin,
+                               StringRef LinkSummariesArg) {
+  ArgList ParcoachArgs = {ParcoachBin};
+  auto ArgsPos = llvm::find(Argv, ARGS_ARG);
+  if (ArgsPos != Argv.end()) {
+    ParcoachArgs.insert(ParcoachArgs.end(), Argv.begin(), ArgsPos);
+  }
+  ParcoachArgs.emplace_back(LinkSummariesArg);
+  return ParcoachArgs;
+}
+
 std::optional<FoundProgramResult> FindProgram(ArgList const &Argv) {
   auto ArgsPos = llvm::find(Argv, ARGS_ARG);
   auto ProgArg = (ArgsPos != Argv.end()) ? ++ArgsPos : Argv.begin();
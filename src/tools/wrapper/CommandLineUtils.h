@@ -26,6 +26,11 @@ ArgList BuildParcoachArgs(ArgList const &Argv, llvm::StringRef ParcoachBin,
                           TempFileRAII const &IRFile,
                           std::optional<TempFileRAII> const &OutputFile);
 
+// Build the command line combining the module summaries at link time.
+// LinkSummariesArg is the "-link-summaries=..." argument.
+ArgList BuildLinkSummariesArgs(ArgList const &Argv, llvm::StringRef ParcoachBin,
+                               llvm::StringRef LinkSummariesArg);
+
 std::optional<FoundProgramResult> FindProgram(ArgList const &Argv);
 
 } // namespace parcoach
@@ -2,6 +2,7 @@
 #include "TempFileRAII.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Program.h"
@@ -12,12 +13,47 @@ using namespace parcoach;
 
 namespace {
 std::string const PARCOACH_BIN_NAME{"parcoach"};
-}
+// The summary of a module is stored next to its object file, with this suffix.
+std::string const SUMMARY_SUFFIX{".parcoach.json"};
+} // namespace
 
 bool isSourceFile(StringRef arg) {
   return arg.endswith(".c") || arg.endswith(".cpp") || arg.endswith(".f90");
 }
 
+// Return the object file created by the compilation, if we can tell.
+std::optional<std::string> getObjectFile(ArgList const &OriginalProgramArgs) {
+  if (!is_contained(OriginalProgramArgs, "-c")) {
+    return std::nullopt;
+  }
+  auto OutputPos = llvm::find(OriginalProgramArgs, "-o");
+  if (OutputPos != OriginalProgramArgs.end()) {
+    if (++OutputPos == OriginalProgramArgs.end() || *OutputPos == "/dev/null") {
+      return std::nullopt;
+    }
+    return OutputPos->str();
+  }
+  // Without -o, the object file is created in the current directory.
+  auto Sources = make_filter_range(OriginalProgramArgs, isSourceFile);
+  if (!hasSingleElement(Sources)) {
+    return std::nullopt;
+  }
+  return (sys::path::stem(*Sources.begin()) + ".o").str();
+}
+
+// Return the summaries of the object files being linked.
+std::vector<std::string>
+getLinkedSummaries(ArgList const &OriginalProgramArgs) {
+  std::vector<std::string> Summaries;
+  for (StringRef Arg : drop_begin(OriginalProgramArgs)) {
+    std::string Summary = (Arg + SUMMARY_SUFFIX).str();
+    if (Arg.endswith(".o") && sys::fs::exists(Summary)) {
+      Summaries.push_back(std::move(Summary));
+    }
+  }
+  return Summaries;
+}
+
 int main(int argc, char const **argv) {
   ++argv;
   --argc;
@@ -61,7 +97,20 @@ int main(int argc, char const **argv) {
         << "Parcoach: this is a linker invocation, not running parcoach.\n";
   }
 
-  if (OriginalResult != 0 || IsLinkerInvocation) {
+  if (OriginalResult != 0) {
+    return OriginalResult;
+  }
+
+  if (IsLinkerInvocation) {
+    // Combine the summaries written when compiling the object files, to find
+    // the issues crossing modules.
+    std::vector<std::string> Summaries =
+        getLinkedSummaries(OriginalProgramArgs);
+    if (!Summaries.empty()) {
+      std::string LinkSummariesArg =
+          "-link-summaries=" + join(Summaries, ",");
+      Execute(BuildLinkSummariesArgs(Argv, *ParcoachBin, LinkSummariesArg));
+    }
     return OriginalResult;
   }
 
@@ -98,6 +147,11 @@ int main(int argc, char const **argv) {
 
   ArgList ParcoachArgs =
       BuildParcoachArgs(Argv, *ParcoachBin, *IRFile, OutputFile);
+  std::string EmitSummaryArg;
+  if (auto ObjectFile = getObjectFile(OriginalProgramArgs)) {
+    EmitSummaryArg = "-emit-summary=" + *ObjectFile + SUMMARY_SUFFIX;
+    ParcoachArgs.emplace_back(EmitSummaryArg);
+  }
   Result = Execute(ParcoachArgs);
 
   if (ShouldInstrument) {
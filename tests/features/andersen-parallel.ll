@@ -0,0 +1,70 @@
+; RUN: %parcoach -check=rma -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check=rma -andersen-threads=4 -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check=rma -andersen-threads=4 -andersen-check-parallel -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check=rma -andersen-stats -disable-output %s 2>&1 | %filecheck %s --check-prefix=STATS
+; RUN: %parcoach -check=rma -andersen-stats -andersen-threads=2 -disable-output %s 2>&1 | %filecheck %s --check-prefix=STATS
+; The results are cached on the first run, the copy of the module reuses them
+; as the key doesn't depend on the path of the file.
+; RUN: rm -rf "%t" && mkdir -p "%t"
+; RUN: %parcoach -check=rma -andersen-cache-dir="%t" -andersen-stats -disable-output %s 2>&1 | %filecheck %s --check-prefixes=CHECK,SOLVE
+; RUN: cp %s "%t/copy.ll"
+; RUN: %parcoach -check=rma -andersen-cache-dir="%t" -andersen-stats -disable-output "%t/copy.ll" 2>&1 | %filecheck %s --check-prefixes=CHECK,CACHED
+; The window buffer only reaches @touch through a cycle of copies and an
+; indirect call: both solvers must find that only the store done by @touch
+; and the one to the origin buffer may access RMA memory.
+; SOLVE: andersen: constraint solving
+; SOLVE-NOT: loaded the results
+; CACHED-NOT: constraint solving
+; CACHED: andersen: loaded the results from {{.*}}.anders
+; CHECK: LOAD/STORE STATISTICS: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; CHECK: LOAD/STORE STATISTICS: 0 (/3) LOAD and 1 (/4) STORE are instrumented
+; STATS: andersen: constraint collection: {{.*}} s, {{.*}} MB
+; STATS: andersen: {{[0-9]+}} constraints
+; STATS: andersen: {{[0-9]+}} constraint graph edges
+; STATS: andersen: constraint solving: {{.*}} s, {{.*}} MB
+; STATS: andersen: {{[0-9]+}} points-to sets
+; STATS: andersen: {{[0-9]+}} distinct points-to sets
+source_filename = "andersen-parallel.c"
+
+@fptr = internal global ptr null
+
+define void @touch(ptr %p) {
+entry:
+  store i32 1, ptr %p, align 4
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %winbuf = alloca [10 x i32], align 4
+  %priv = alloca [10 x i32], align 4
+  %origin = alloca i32, align 4
+  %slot = alloca ptr, align 8
+  %w = alloca i32, align 4
+  %call = call i32 @MPI_Win_create(ptr %winbuf, i64 40, i32 4, i32 0, i32 0, ptr %w)
+  %win = load i32, ptr %w, align 4
+  store ptr @touch, ptr @fptr, align 8
+  %call1 = call i32 @MPI_Win_fence(i32 0, i32 %win)
+  br label %loop
+
+loop:
+  %cur = phi ptr [ %winbuf, %entry ], [ %next, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  store ptr %cur, ptr %slot, align 8
+  %next = load ptr, ptr %slot, align 8
+  store i32 0, ptr %priv, align 4
+  %inc = add i32 %i, 1
+  %cmp = icmp slt i32 %inc, 10
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %f = load ptr, ptr @fptr, align 8
+  call void %f(ptr %next)
+  store i32 5, ptr %origin, align 4
+  %call2 = call i32 @MPI_Put(ptr %origin, i32 1, i32 0, i32 0, i64 0, i32 1, i32 0, i32 %win)
+  %call3 = call i32 @MPI_Win_fence(i32 0, i32 %win)
+  ret i32 0
+}
+declare i32 @MPI_Win_create(ptr, i64, i32, i32, i32, ptr)
+declare i32 @MPI_Win_fence(i32, i32)
+declare i32 @MPI_Put(ptr, i32, i32, i32, i64, i32, i32, i32)
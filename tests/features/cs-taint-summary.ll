@@ -0,0 +1,64 @@
+; RUN: %parcoach -check-mpi -disable-output %s 2>&1 | %filecheck %s
+; @check is flooded with an untainted argument first, then with the rank from
+; @second and @first: the summary of the first flood must not hide the warning.
+; CHECK: main.c: warning: MPI_Barrier line 3 possibly not called by all processes because of conditional(s) line(s)  2 (main.c)
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+
+define void @check(i32 %v) !dbg !12 {
+entry:
+  %cmp = icmp eq i32 %v, 0, !dbg !13
+  br i1 %cmp, label %then, label %end, !dbg !13
+
+then:
+  %call = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !14
+  br label %end, !dbg !14
+
+end:
+  ret void, !dbg !14
+}
+
+define void @first(i32 %v) {
+entry:
+  call void @check(i32 %v)
+  ret void
+}
+
+define void @second(i32 %v) {
+entry:
+  call void @check(i32 %v)
+  ret void
+}
+
+define i32 @main() !dbg !5 {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r), !dbg !8
+  %0 = load i32, ptr %r, align 4, !dbg !9
+  call void @first(i32 0), !dbg !9
+  call void @second(i32 %0), !dbg !10
+  call void @first(i32 %0), !dbg !11
+  ret i32 0, !dbg !11
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 10, type: !6, scopeLine: 10, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 12, column: 3, scope: !5)
+!9 = !DILocation(line: 13, column: 3, scope: !5)
+!10 = !DILocation(line: 14, column: 3, scope: !5)
+!11 = !DILocation(line: 15, column: 3, scope: !5)
+!12 = distinct !DISubprogram(name: "check", scope: !1, file: !1, line: 1, type: !6, scopeLine: 1, spFlags: DISPFlagDefinition, unit: !0)
+!13 = !DILocation(line: 2, column: 7, scope: !12)
+!14 = !DILocation(line: 3, column: 5, scope: !12)
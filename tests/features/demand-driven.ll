@@ -0,0 +1,96 @@
+; RUN: %parcoach -check-mpi -context-insensitive -demand-driven -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check-mpi -context-insensitive -demand-driven -disable-output %s 2>&1 | %filecheck %s --check-prefix=UNRELATED
+; The graph of @get_rank is only built when the walk back from the condition
+; of @main reaches its call, the condition on %n doesn't depend on the rank.
+; The rank stored to @g by @set_g reaches @main through the return mu of
+; @set_g, a phi which is eliminated when the walk reaches it.
+; CHECK-DAG: main.c: warning: MPI_Barrier line 10 possibly not called by all processes because of conditional(s) line(s)  9 (main.c)
+; CHECK-DAG: main.c: warning: MPI_Barrier line 16 possibly not called by all processes because of conditional(s) line(s)  15 (main.c)
+; UNRELATED-NOT: MPI_Barrier line 13
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+@g = global i32 0
+
+define i32 @get_rank() {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r)
+  %0 = load i32, ptr %r, align 4
+  ret i32 %0
+}
+
+define void @set_g(i32 %c) {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r)
+  %0 = load i32, ptr %r, align 4
+  %tobool = icmp ne i32 %c, 0
+  br i1 %tobool, label %then, label %else
+
+then:
+  store i32 %0, ptr @g, align 4
+  br label %end
+
+else:
+  store i32 %0, ptr @g, align 4
+  br label %end
+
+end:
+  ret void
+}
+
+define i32 @main(i32 %n) !dbg !5 {
+entry:
+  %r = call i32 @get_rank(), !dbg !8
+  %cmp = icmp eq i32 %r, 0, !dbg !9
+  br i1 %cmp, label %then, label %next, !dbg !9
+
+then:
+  %call = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !10
+  br label %next, !dbg !10
+
+next:
+  %cmp2 = icmp sgt i32 %n, 0, !dbg !12
+  br i1 %cmp2, label %then2, label %end, !dbg !12
+
+then2:
+  %call2 = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !13
+  br label %next2, !dbg !13
+
+next2:
+  call void @set_g(i32 %n), !dbg !14
+  %0 = load i32, ptr @g, align 4, !dbg !15
+  %cmp3 = icmp eq i32 %0, 0, !dbg !15
+  br i1 %cmp3, label %then3, label %end, !dbg !15
+
+then3:
+  %call3 = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !16
+  br label %end, !dbg !16
+
+end:
+  ret i32 0, !dbg !11
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 3, type: !6, scopeLine: 3, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 5, column: 3, scope: !5)
+!9 = !DILocation(line: 9, column: 7, scope: !5)
+!10 = !DILocation(line: 10, column: 5, scope: !5)
+!11 = !DILocation(line: 17, column: 3, scope: !5)
+!12 = !DILocation(line: 12, column: 7, scope: !5)
+!13 = !DILocation(line: 13, column: 5, scope: !5)
+!14 = !DILocation(line: 14, column: 3, scope: !5)
+!15 = !DILocation(line: 15, column: 7, scope: !5)
+!16 = !DILocation(line: 16, column: 5, scope: !5)
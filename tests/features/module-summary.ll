@@ -0,0 +1,118 @@
+; RUN: rm -f "%t.json"
+; RUN: %parcoach -check-mpi -emit-summary="%t.json" -disable-output %s
+; RUN: %filecheck %s --check-prefix=SUMMARY < "%t.json"
+; The helper function is defined in another module, whose summary says it
+; calls a collective through a third function.
+; RUN: echo '{"version": 1, "functions": {"helper": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "sync", "location": {"file": "helper.c", "line": 2}, "conditionals": []}]}, "sync": {"collectives": ["MPI_Barrier"], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": []}}}' > "%t.helper.json"
+; RUN: %parcoach -link-summaries="%t.json,%t.helper.json" 2>&1 | %filecheck %s --check-prefix=LINK
+; Without the other module, the link step doesn't know what helper does.
+; RUN: %parcoach -link-summaries="%t.json" 2>&1 | %filecheck %s --check-prefix=ALONE
+; Another module may call sync_if with a rank-dependent value, which decides
+; whether it executes its barrier.
+; RUN: echo '{"version": 1, "functions": {"sync_if": {"collectives": ["MPI_Barrier"], "mod": [], "ref": [], "rankDependentArgs": [0], "collectiveArgs": [0], "rankDependentReturn": false, "externalCalls": []}}}' > "%t.index.json"
+; RUN: %parcoach -check-mpi -import-summaries="%t.index.json" -disable-output %s 2>&1 | %filecheck %s --check-prefix=IMPORT
+; RUN: %parcoach -check-mpi -disable-output %s 2>&1 | %filecheck %s --check-prefix=NOIMPORT
+; The rank returned by get_rank and given to set_rank doesn't decide any
+; collective in this module, but it may in the others.
+; SUMMARY: "get_rank": {
+; SUMMARY: "rankDependentReturn": true
+; SUMMARY: "main": {
+; SUMMARY-NEXT: "collectiveArgs": [],
+; SUMMARY-NEXT: "collectives": [
+; SUMMARY-NEXT: "MPI_Barrier"
+; SUMMARY-NEXT: ],
+; SUMMARY: "callee": "helper",
+; SUMMARY-NEXT: "conditionalArgs": [],
+; SUMMARY-NEXT: "conditionals": [
+; SUMMARY-NEXT: {
+; SUMMARY-NEXT: "file": "main.c",
+; SUMMARY-NEXT: "line": 6
+; SUMMARY: "set_rank": {
+; SUMMARY: "rankDependentArgs": [
+; SUMMARY-NEXT: 0
+; SUMMARY-NEXT: ],
+; SUMMARY-NEXT: "rankDependentReturn": false
+; SUMMARY: "sync_if": {
+; SUMMARY-NEXT: "collectiveArgs": [
+; SUMMARY-NEXT: 0
+; SUMMARY-NEXT: ],
+; SUMMARY: "version": 1
+; LINK: main.c: warning: helper line 7 possibly not called by all processes because of conditional(s) line(s)  6 (main.c) (Call Ordering Error)
+; ALONE: remark: No issues found.
+; IMPORT: main.c: warning: MPI_Barrier line 22 possibly not called by all processes because of conditional(s) line(s)  21 (main.c)
+; NOIMPORT-NOT: MPI_Barrier line 22
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+@last_rank = global i32 0
+
+define i32 @get_rank() {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r)
+  %0 = load i32, ptr %r, align 4
+  ret i32 %0
+}
+
+define void @set_rank(i32 %x) {
+entry:
+  store i32 %x, ptr @last_rank, align 4
+  ret void
+}
+
+define void @sync_if(i32 %x) !dbg !20 {
+entry:
+  %tobool = icmp ne i32 %x, 0, !dbg !21
+  br i1 %tobool, label %then, label %end, !dbg !21
+
+then:
+  %call = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !22
+  br label %end, !dbg !22
+
+end:
+  ret void, !dbg !23
+}
+
+define i32 @main() !dbg !5 {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r), !dbg !8
+  %0 = load i32, ptr %r, align 4, !dbg !9
+  %rank = call i32 @get_rank(), !dbg !8
+  call void @set_rank(i32 %rank), !dbg !8
+  call void @sync_if(i32 1), !dbg !8
+  %cmp = icmp eq i32 %0, 0, !dbg !9
+  br i1 %cmp, label %then, label %end, !dbg !9
+
+then:
+  call void @helper(), !dbg !10
+  br label %end, !dbg !10
+
+end:
+  %call1 = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !11
+  ret i32 0, !dbg !12
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+declare void @helper()
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 3, type: !6, scopeLine: 3, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 5, column: 3, scope: !5)
+!9 = !DILocation(line: 6, column: 7, scope: !5)
+!10 = !DILocation(line: 7, column: 5, scope: !5)
+!11 = !DILocation(line: 8, column: 3, scope: !5)
+!12 = !DILocation(line: 9, column: 3, scope: !5)
+!20 = distinct !DISubprogram(name: "sync_if", scope: !1, file: !1, line: 20, type: !6, scopeLine: 20, spFlags: DISPFlagDefinition, unit: !0)
+!21 = !DILocation(line: 21, column: 7, scope: !20)
+!22 = !DILocation(line: 22, column: 5, scope: !20)
+!23 = !DILocation(line: 23, column: 1, scope: !20)
@@ -0,0 +1,54 @@
+; RUN: %parcoach -check-mpi -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check-mpi -mssa-threads=4 -disable-output %s 2>&1 | %filecheck %s
+; The rank only reaches the condition through the memory written by
+; @save_rank and read by @saved_rank, whose memory SSA are built separately.
+; CHECK: main.c: warning: MPI_Barrier line 10 possibly not called by all processes because of conditional(s) line(s)  9 (main.c)
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+@rank = global i32 0
+
+define void @save_rank() {
+entry:
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr @rank)
+  ret void
+}
+
+define i32 @saved_rank() {
+entry:
+  %0 = load i32, ptr @rank, align 4
+  ret i32 %0
+}
+
+define i32 @main() !dbg !5 {
+entry:
+  call void @save_rank(), !dbg !8
+  %r = call i32 @saved_rank(), !dbg !8
+  %cmp = icmp eq i32 %r, 0, !dbg !9
+  br i1 %cmp, label %then, label %end, !dbg !9
+
+then:
+  %call = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !10
+  br label %end, !dbg !10
+
+end:
+  ret i32 0, !dbg !11
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 3, type: !6, scopeLine: 3, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 5, column: 3, scope: !5)
+!9 = !DILocation(line: 9, column: 7, scope: !5)
+!10 = !DILocation(line: 10, column: 5, scope: !5)
+!11 = !DILocation(line: 11, column: 3, scope: !5)
@@ -0,0 +1,79 @@
+; RUN: %parcoach -check-mpi -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check-mpi -context-insensitive -disable-output %s 2>&1 | %filecheck %s
+; Both arms of the nested conditionals store the rank to @rank. The joins are
+; laid out from the outer one, so the phi of each join can only be eliminated
+; once the phi of the next block is.
+; CHECK: main.c: warning: MPI_Barrier line 10 possibly not called by all processes because of conditional(s) line(s)  9 (main.c)
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+@rank = global i32 0
+
+define i32 @main(i32 %n) !dbg !5 {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r), !dbg !8
+  %v = load i32, ptr %r, align 4, !dbg !8
+  %c1 = icmp sgt i32 %n, 1, !dbg !8
+  br i1 %c1, label %c2, label %else1, !dbg !8
+
+c2:
+  %k2 = icmp sgt i32 %n, 2, !dbg !8
+  br i1 %k2, label %c3, label %else2, !dbg !8
+
+c3:
+  %k3 = icmp sgt i32 %n, 3, !dbg !8
+  br i1 %k3, label %then3, label %else3, !dbg !8
+
+then3:
+  store i32 %v, ptr @rank, align 4, !dbg !8
+  br label %join3, !dbg !8
+
+else3:
+  store i32 %v, ptr @rank, align 4, !dbg !8
+  br label %join3, !dbg !8
+
+else2:
+  store i32 %v, ptr @rank, align 4, !dbg !8
+  br label %join2, !dbg !8
+
+else1:
+  store i32 %v, ptr @rank, align 4, !dbg !8
+  br label %join1, !dbg !8
+
+join1:
+  %0 = load i32, ptr @rank, align 4, !dbg !9
+  %cmp = icmp eq i32 %0, 0, !dbg !9
+  br i1 %cmp, label %then, label %end, !dbg !9
+
+join2:
+  br label %join1, !dbg !8
+
+join3:
+  br label %join2, !dbg !8
+
+then:
+  %call1 = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !10
+  br label %end, !dbg !10
+
+end:
+  ret i32 0, !dbg !11
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 3, type: !6, scopeLine: 3, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 5, column: 3, scope: !5)
+!9 = !DILocation(line: 9, column: 7, scope: !5)
+!10 = !DILocation(line: 10, column: 5, scope: !5)
+!11 = !DILocation(line: 11, column: 3, scope: !5)
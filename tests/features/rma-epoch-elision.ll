@@ -0,0 +1,89 @@
+; RUN: %parcoach -check=rma -rma-static-pruning=false -disable-output %s 2>&1 | %filecheck %s
+; RUN: sed 's/@main(/@not_main(/' %s > "%t.ll"
+; RUN: %parcoach -check=rma -rma-static-pruning=false -disable-output "%t.ll" 2>&1 | %filecheck %s --check-prefix=NOMAIN
+; Only the accesses which may happen within an epoch must be instrumented,
+; depending on where the functions are called from, and on the epochs started
+; and ended by invokes. The functions other modules may call can be entered
+; within an epoch, and so can all of them when the module has no main.
+; CHECK: ANALYZING function in_epoch_only
+; CHECK: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; CHECK: ANALYZING function outside_only
+; CHECK: 0 (/0) LOAD and 0 (/1) STORE are instrumented
+; CHECK: ANALYZING function exported
+; CHECK: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; CHECK: ANALYZING function both
+; CHECK: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; CHECK: ANALYZING function invoked
+; CHECK: 0 (/0) LOAD and 1 (/2) STORE are instrumented
+; CHECK: ANALYZING function main
+; CHECK: 0 (/0) LOAD and 1 (/2) STORE are instrumented
+; NOMAIN: ANALYZING function in_epoch_only
+; NOMAIN: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; NOMAIN: ANALYZING function outside_only
+; NOMAIN: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; NOMAIN: ANALYZING function exported
+; NOMAIN: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; NOMAIN: ANALYZING function both
+; NOMAIN: 0 (/0) LOAD and 1 (/1) STORE are instrumented
+; NOMAIN: ANALYZING function invoked
+; NOMAIN: 0 (/0) LOAD and 1 (/2) STORE are instrumented
+; NOMAIN: ANALYZING function not_main
+; NOMAIN: 0 (/0) LOAD and 1 (/2) STORE are instrumented
+@g = global i32 0
+define internal void @in_epoch_only() {
+  store i32 1, ptr @g
+  ret void
+}
+define internal void @outside_only() {
+  store i32 2, ptr @g
+  ret void
+}
+define void @exported() {
+  store i32 4, ptr @g
+  ret void
+}
+define internal void @both() {
+  store i32 3, ptr @g
+  ret void
+}
+define internal void @opens(i32 %w) {
+  call i32 @MPI_Win_lock_all(i32 0, i32 %w)
+  ret void
+}
+define internal void @invoked() personality ptr @__CxxFrameHandler3 {
+entry:
+  invoke i32 @MPI_Win_lock_all(i32 0, i32 0)
+          to label %locked unwind label %lpad
+locked:
+  store i32 7, ptr @g
+  invoke i32 @MPI_Win_unlock_all(i32 0)
+          to label %unlocked unwind label %lpad
+unlocked:
+  store i32 8, ptr @g
+  ret void
+lpad:
+  %cp = cleanuppad within none []
+  cleanupret from %cp unwind to caller
+}
+define i32 @main(i1 %c) {
+entry:
+  call void @invoked()
+  call void @outside_only()
+  call void @exported()
+  call void @both()
+  call void @opens(i32 0)
+  call void @in_epoch_only()
+  call void @both()
+  br i1 %c, label %a, label %b
+a:
+  call i32 @MPI_Win_unlock_all(i32 0)
+  br label %b
+b:
+  store i32 5, ptr @g
+  call i32 @MPI_Win_unlock_all(i32 0)
+  store i32 6, ptr @g
+  ret i32 0
+}
+declare i32 @MPI_Win_lock_all(i32, i32)
+declare i32 @MPI_Win_unlock_all(i32)
+declare i32 @__CxxFrameHandler3(...)
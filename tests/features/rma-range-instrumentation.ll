@@ -0,0 +1,37 @@
+; RUN: %parcoach -check=rma -S -o %t.ll %s 2>&1 | %filecheck %s --check-prefix=STATS
+; RUN: %filecheck %s < %t.ll
+; The affine accesses to the window in the loop are instrumented by a single
+; range access before the loop, the ones to @priv are not instrumented at all.
+; STATS: LOAD/STORE STATISTICS: 1 (/3) LOAD and 1 (/1) STORE are instrumented
+; CHECK: call void @parcoach_rma_store_range(ptr @buf, i64 4, i64 %[[COUNT:.*]], i64 32,
+; CHECK-NEXT: call void @parcoach_rma_load_range(ptr @buf, i64 8, i64 %[[COUNT]], i64 32,
+; CHECK-NEXT: br label %loop
+; CHECK-NOT: call void @parcoach_rma_load(
+; CHECK-NOT: call void @parcoach_rma_store(
+@buf = global [100 x i32] zeroinitializer
+@priv = internal global [100 x i32] zeroinitializer
+define i32 @main(i64 %n) {
+entry:
+  %w = alloca i32
+  call i32 @MPI_Win_create(ptr @buf, i64 400, i32 4, i32 0, i32 0, ptr %w)
+  %win = load i32, ptr %w
+  call i32 @MPI_Win_fence(i32 0, i32 %win)
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds [100 x i32], ptr @buf, i64 0, i64 %i
+  store i32 1, ptr %p
+  %q = getelementptr inbounds [100 x i32], ptr @priv, i64 0, i64 %i
+  %v = load i32, ptr %q
+  %i2 = mul i64 %i, 2
+  %r = getelementptr inbounds [100 x i32], ptr @buf, i64 0, i64 %i2
+  %x = load i32, ptr %r
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  call i32 @MPI_Win_fence(i32 0, i32 %win)
+  ret i32 0
+}
+declare i32 @MPI_Win_create(ptr, i64, i32, i32, i32, ptr)
+declare i32 @MPI_Win_fence(i32, i32)
@@ -0,0 +1,50 @@
+; RUN: %parcoach -check=rma -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check=rma -rma-static-pruning=false -disable-output %s 2>&1 | %filecheck %s --check-prefix=NOPRUNING
+; Only the accesses to the windows and to the origin buffer of MPI_Put must be
+; instrumented, the ones to %priv and @private can't conflict with RMA
+; operations. Another module may expose @shared, and @reached through
+; @visible.
+; CHECK: LOAD/STORE STATISTICS: 0 (/4) LOAD and 6 (/8) STORE are instrumented
+; NOPRUNING: LOAD/STORE STATISTICS: 3 (/4) LOAD and 8 (/8) STORE are instrumented
+@shared = external global [10 x i32]
+@private = internal global i32 0
+@reached = internal global i32 0
+@visible = global ptr @reached
+define i32 @main() {
+entry:
+  %winbuf = alloca [10 x i32], align 4
+  %priv = alloca [10 x i32], align 4
+  %origin = alloca i32, align 4
+  %abuf = alloca ptr, align 8
+  %w = alloca i32, align 4
+  %w2 = alloca i32, align 4
+  %sbuf = alloca ptr, align 8
+  %w3 = alloca i32, align 4
+  %call = call i32 @MPI_Win_create(ptr %winbuf, i64 40, i32 4, i32 0, i32 0, ptr %w)
+  %call1 = call i32 @MPI_Win_allocate(i64 40, i32 4, i32 0, i32 0, ptr %abuf, ptr %w2)
+  %calls = call i32 @MPI_Win_allocate_shared(i64 40, i32 4, i32 0, i32 0, ptr %sbuf, ptr %w3)
+  %win = load i32, ptr %w, align 4
+  %call2 = call i32 @MPI_Win_fence(i32 0, i32 %win)
+  %p1 = getelementptr inbounds [10 x i32], ptr %priv, i64 0, i64 1
+  store i32 1, ptr %p1, align 4
+  %v = load i32, ptr %p1, align 4
+  %wb2 = getelementptr inbounds [10 x i32], ptr %winbuf, i64 0, i64 2
+  store i32 %v, ptr %wb2, align 4
+  %a = load ptr, ptr %abuf, align 8
+  %a3 = getelementptr inbounds i32, ptr %a, i64 3
+  store i32 4, ptr %a3, align 4
+  %s = load ptr, ptr %sbuf, align 8
+  store i32 6, ptr %s, align 4
+  store i32 5, ptr %origin, align 4
+  store i32 7, ptr @shared, align 4
+  store i32 8, ptr @private, align 4
+  store i32 9, ptr @reached, align 4
+  %call3 = call i32 @MPI_Put(ptr %origin, i32 1, i32 0, i32 0, i64 0, i32 1, i32 0, i32 %win)
+  %call4 = call i32 @MPI_Win_fence(i32 0, i32 %win)
+  ret i32 0
+}
+declare i32 @MPI_Win_create(ptr, i64, i32, i32, i32, ptr)
+declare i32 @MPI_Win_allocate(i64, i32, i32, i32, ptr, ptr)
+declare i32 @MPI_Win_allocate_shared(i64, i32, i32, i32, ptr, ptr)
+declare i32 @MPI_Win_fence(i32, i32)
+declare i32 @MPI_Put(ptr, i32, i32, i32, i64, i32, i32, i32)
@@ -0,0 +1,55 @@
+; RUN: %parcoach -check-mpi -context-insensitive -disable-output %s 2>&1 | %filecheck %s
+; RUN: %parcoach -check-mpi -context-insensitive -taint-threads=4 -disable-output %s 2>&1 | %filecheck %s
+; The rank goes up from @get_rank to @main, then down to @check: the taint
+; crosses the functions twice, which are flooded separately in parallel.
+; CHECK: main.c: warning: MPI_Barrier line 3 possibly not called by all processes because of conditional(s) line(s)  2 (main.c)
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+
+define void @check(i32 %v) !dbg !12 {
+entry:
+  %cmp = icmp eq i32 %v, 0, !dbg !13
+  br i1 %cmp, label %then, label %end, !dbg !13
+
+then:
+  %call = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !14
+  br label %end, !dbg !14
+
+end:
+  ret void, !dbg !14
+}
+
+define i32 @get_rank() {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r)
+  %0 = load i32, ptr %r, align 4
+  ret i32 %0
+}
+
+define i32 @main() !dbg !5 {
+entry:
+  %r = call i32 @get_rank(), !dbg !8
+  call void @check(i32 %r), !dbg !9
+  ret i32 0, !dbg !9
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 10, type: !6, scopeLine: 10, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 12, column: 3, scope: !5)
+!9 = !DILocation(line: 13, column: 3, scope: !5)
+!12 = distinct !DISubprogram(name: "check", scope: !1, file: !1, line: 1, type: !6, scopeLine: 1, spFlags: DISPFlagDefinition, unit: !0)
+!13 = !DILocation(line: 2, column: 7, scope: !12)
+!14 = !DILocation(line: 3, column: 5, scope: !12)
@@ -0,0 +1,98 @@
+; The summaries of the other modules are combined into an index, which is then
+; imported to analyze this module on its own.
+; RUN: echo '{"version": 1, "functions": {"helper": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "sync", "location": {"file": "helper.c", "line": 2}, "conditionals": []}]}, "sync": {"collectives": ["MPI_Barrier"], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": []}, "get_color": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": true, "externalCalls": []}}}' > "%t.helper.json"
+; RUN: rm -f "%t.index.json"
+; RUN: %parcoach -link-summaries="%t.helper.json" -summary-index="%t.index.json"
+; RUN: %filecheck %s --check-prefix=INDEX < "%t.index.json"
+; RUN: %parcoach -check-mpi -import-summaries="%t.index.json" -disable-output %s 2>&1 | %filecheck %s --check-prefix=IMPORT
+; Without the index, helper and get_color are unknown functions.
+; RUN: %parcoach -check-mpi -disable-output %s 2>&1 | %filecheck %s --check-prefix=ALONE
+; a and b call each other from different modules, both execute the barrier of a.
+; RUN: echo '{"version": 1, "functions": {"a": {"collectives": ["MPI_Barrier"], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "b", "location": {"file": "a.c", "line": 3}, "conditionals": []}]}, "a0": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "a", "location": {"file": "a.c", "line": 9}, "conditionals": [{"file": "a.c", "line": 8}]}]}}}' > "%t.a.json"
+; RUN: echo '{"version": 1, "functions": {"b": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "a", "location": {"file": "c.c", "line": 2}, "conditionals": []}]}, "c": {"collectives": [], "mod": [], "ref": [], "rankDependentArgs": [], "rankDependentReturn": false, "externalCalls": [{"callee": "b", "location": {"file": "c.c", "line": 7}, "conditionals": [{"file": "c.c", "line": 6}]}]}}}' > "%t.c.json"
+; RUN: rm -f "%t.rec.json"
+; RUN: %parcoach -link-summaries="%t.a.json,%t.c.json" -summary-index="%t.rec.json" 2>&1 | %filecheck %s --check-prefix=RECURSIVE
+; RUN: %filecheck %s --check-prefix=RECURSIVE-INDEX < "%t.rec.json"
+; sync_if, defined in another module, only executes its barrier depending on
+; its argument, which is the rank here.
+; RUN: rm -f "%t.main.json" "%t.args.json"
+; RUN: %parcoach -check-mpi -emit-summary="%t.main.json" -disable-output %s
+; RUN: echo '{"version": 1, "functions": {"sync_if": {"collectives": ["MPI_Barrier"], "mod": [], "ref": [], "rankDependentArgs": [], "collectiveArgs": [0], "rankDependentReturn": false, "externalCalls": []}}}' > "%t.sync.json"
+; RUN: %parcoach -link-summaries="%t.main.json,%t.sync.json" -summary-index="%t.args.json" 2>&1 | %filecheck %s --check-prefix=ARGS
+; RUN: %filecheck %s --check-prefix=ARGS-INDEX < "%t.args.json"
+; INDEX: "helper": {
+; INDEX-NEXT: "collectiveArgs": [],
+; INDEX-NEXT: "collectives": [
+; INDEX-NEXT: "MPI_Barrier"
+; INDEX-NEXT: ],
+; IMPORT-DAG: main.c: warning: helper line 7 possibly not called by all processes because of conditional(s) line(s)  6 (main.c)
+; IMPORT-DAG: main.c: warning: MPI_Barrier line 10 possibly not called by all processes because of conditional(s) line(s)  9 (main.c)
+; ALONE: remark: No issues found.
+; RECURSIVE-DAG: a.c: warning: a line 9 possibly not called by all processes because of conditional(s) line(s)  8 (a.c) (Call Ordering Error)
+; RECURSIVE-DAG: c.c: warning: b line 7 possibly not called by all processes because of conditional(s) line(s)  6 (c.c) (Call Ordering Error)
+; RECURSIVE-INDEX: "b": {
+; RECURSIVE-INDEX-NEXT: "collectiveArgs": [],
+; RECURSIVE-INDEX-NEXT: "collectives": [
+; RECURSIVE-INDEX-NEXT: "MPI_Barrier"
+; ARGS: main.c: warning: sync_if line 12 possibly not executing its collectives on all processes because of rank-dependent argument(s)  1 (Call Ordering Error)
+; ARGS-INDEX: "sync_if": {
+; ARGS-INDEX-NEXT: "collectiveArgs": [
+; ARGS-INDEX-NEXT: 0
+; ARGS-INDEX-NEXT: ],
+; ARGS-INDEX: "rankDependentArgs": [
+; ARGS-INDEX-NEXT: 0
+; ARGS-INDEX-NEXT: ],
+%struct.ompi_predefined_communicator_t = type opaque
+
+@ompi_mpi_comm_world = external global %struct.ompi_predefined_communicator_t, align 1
+
+define i32 @main() !dbg !5 {
+entry:
+  %r = alloca i32, align 4
+  %call = call i32 @MPI_Comm_rank(ptr @ompi_mpi_comm_world, ptr %r), !dbg !8
+  %0 = load i32, ptr %r, align 4, !dbg !9
+  call void @sync_if(i32 %0), !dbg !15
+  %cmp = icmp eq i32 %0, 0, !dbg !9
+  br i1 %cmp, label %then, label %color, !dbg !9
+
+then:
+  call void @helper(), !dbg !10
+  br label %color, !dbg !10
+
+color:
+  %c = call i32 @get_color(), !dbg !11
+  %cmp1 = icmp eq i32 %c, 0, !dbg !13
+  br i1 %cmp1, label %then1, label %end, !dbg !13
+
+then1:
+  %call1 = call i32 @MPI_Barrier(ptr @ompi_mpi_comm_world), !dbg !14
+  br label %end, !dbg !14
+
+end:
+  ret i32 0, !dbg !12
+}
+
+declare i32 @MPI_Comm_rank(ptr, ptr)
+declare i32 @MPI_Barrier(ptr)
+declare void @helper()
+declare i32 @get_color()
+declare void @sync_if(i32)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "main.c", directory: "/tmp")
+!2 = !{i32 7, !"Dwarf Version", i32 5}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 3, type: !6, scopeLine: 3, spFlags: DISPFlagDefinition, unit: !0)
+!6 = !DISubroutineType(types: !7)
+!7 = !{null}
+!8 = !DILocation(line: 5, column: 3, scope: !5)
+!9 = !DILocation(line: 6, column: 7, scope: !5)
+!10 = !DILocation(line: 7, column: 5, scope: !5)
+!11 = !DILocation(line: 8, column: 11, scope: !5)
+!12 = !DILocation(line: 11, column: 3, scope: !5)
+!13 = !DILocation(line: 9, column: 7, scope: !5)
+!14 = !DILocation(line: 10, column: 5, scope: !5)
+!15 = !DILocation(line: 12, column: 3, scope: !5)
@@ -0,0 +1,99 @@
+#include "parcoach/andersen/PtsSet.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+namespace {
+
+// The store is shared by the whole process, so the tests only look at how the
+// number of distinct sets changes.
+size_t getNumDistinctSets() {
+  size_t Memory;
+  return AndersPtsSet::getNumDistinctSets(Memory);
+}
+
+AndersPtsSet makeSet(std::vector<unsigned> const &Elements) {
+  AndersPtsSet Set;
+  Set.insert(Elements);
+  return Set;
+}
+
+TEST(AndersPtsSet, Interning) {
+  size_t Before = getNumDistinctSets();
+  {
+    AndersPtsSet A;
+    EXPECT_TRUE(A.isEmpty());
+    EXPECT_TRUE(A.insert(130));
+    EXPECT_TRUE(A.insert(3));
+    EXPECT_FALSE(A.insert(3));
+    AndersPtsSet B = makeSet({3, 130, 3});
+    // Both sets share the same content.
+    EXPECT_TRUE(A == B);
+    EXPECT_EQ(A.getSize(), 2u);
+    EXPECT_TRUE(A.has(130));
+    EXPECT_FALSE(A.has(66));
+    EXPECT_EQ(std::vector<unsigned>(A.begin(), A.end()),
+              (std::vector<unsigned>{3, 130}));
+    EXPECT_EQ(getNumDistinctSets(), Before + 1);
+
+    // Modifying a set doesn't change the other ones sharing its content.
+    B.insert(66);
+    EXPECT_FALSE(A == B);
+    EXPECT_EQ(A.getSize(), 2u);
+    EXPECT_EQ(B.getSize(), 3u);
+  }
+  // The contents are freed with their last set.
+  EXPECT_EQ(getNumDistinctSets(), Before);
+}
+
+TEST(AndersPtsSet, Release) {
+  size_t Before = getNumDistinctSets();
+  AndersPtsSet A = makeSet({1, 2});
+  {
+    AndersPtsSet Copy = A;
+    AndersPtsSet Moved = std::move(Copy);
+    EXPECT_TRUE(Moved == A);
+  }
+  EXPECT_EQ(getNumDistinctSets(), Before + 1);
+  EXPECT_TRUE(A.subtract(makeSet({1, 2})));
+  EXPECT_TRUE(A.isEmpty());
+  EXPECT_EQ(getNumDistinctSets(), Before);
+}
+
+TEST(AndersPtsSet, MemoisedUnion) {
+  AndersPtsSet A = makeSet({1});
+  AndersPtsSet B = makeSet({200});
+  size_t Before = getNumDistinctSets();
+  {
+    AndersPtsSet C = A;
+    EXPECT_TRUE(C.unionWith(B));
+    EXPECT_FALSE(C.unionWith(B));
+    EXPECT_TRUE(C == makeSet({1, 200}));
+  }
+  // The memoised union keeps its result alive, and gives it back.
+  EXPECT_EQ(getNumDistinctSets(), Before + 1);
+  AndersPtsSet D = B;
+  EXPECT_TRUE(D.unionWith(A));
+  EXPECT_TRUE(D == makeSet({1, 200}));
+  EXPECT_EQ(getNumDistinctSets(), Before + 1);
+  EXPECT_TRUE(A.contains(makeSet({1})));
+  EXPECT_TRUE(D.contains(A));
+  EXPECT_FALSE(A.contains(D));
+  EXPECT_TRUE(D.intersectWith(B));
+  EXPECT_FALSE(A.intersectWith(B));
+}
+
+TEST(AndersPtsSet, ForgottenUnions) {
+  size_t Before = getNumDistinctSets();
+  constexpr unsigned NumUnions = 1 << 19;
+  AndersPtsSet Zero = makeSet({0});
+  for (unsigned I = 1; I <= NumUnions; I++) {
+    AndersPtsSet Set = Zero;
+    Set.unionWith(makeSet({I}));
+  }
+  // The results nobody uses anymore aren't all kept by the memoised unions.
+  EXPECT_LE(getNumDistinctSets(), Before + NumUnions / 2);
+}
+
+} // namespace
@@ -0,0 +1,43 @@
+#include "AccessBuffer.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace parcoach::rma;
+
+namespace {
+
+TEST(RMAAccessBuffer, PushAndDrain) {
+  AccessBuffer Buffer(4);
+  std::vector<uint64_t> Drained;
+  auto Collect = [&](Access const *Begin, Access const *End) {
+    for (Access const *It = Begin; It != End; ++It) {
+      Drained.push_back(It->Itv.Low);
+    }
+  };
+  for (uint64_t I = 0; I < 4; I++) {
+    EXPECT_TRUE(Buffer.push(
+        Access{Interval{I, I}, AccessType::LOCAL_READ, DebugInfo()}));
+  }
+  // The buffer is full.
+  EXPECT_FALSE(
+      Buffer.push(Access{Interval{4, 4}, AccessType::LOCAL_READ, DebugInfo()}));
+  Buffer.drain(Collect);
+  EXPECT_EQ(Drained, (std::vector<uint64_t>{0, 1, 2, 3}));
+
+  // Wrap around the end of the storage.
+  Drained.clear();
+  for (uint64_t I = 4; I < 7; I++) {
+    EXPECT_TRUE(Buffer.push(
+        Access{Interval{I, I}, AccessType::LOCAL_READ, DebugInfo()}));
+  }
+  Buffer.drain(Collect);
+  EXPECT_EQ(Drained, (std::vector<uint64_t>{4, 5, 6}));
+
+  Drained.clear();
+  Buffer.drain(Collect);
+  EXPECT_TRUE(Drained.empty());
+}
+
+} // namespace
@@ -0,0 +1,31 @@
+#include "Interval.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace parcoach::rma;
+
+namespace {
+
+TEST(RMADebugInfo, InternFilenames) {
+  EXPECT_EQ(getFilename(DebugInfo().FileId), "unknown_file");
+  EXPECT_EQ(DebugInfo(1, nullptr).FileId, DebugInfo().FileId);
+
+  char const *Foo = "foo.c";
+  DebugInfo A(1, Foo);
+  DebugInfo B(2, Foo);
+  EXPECT_EQ(A.FileId, B.FileId);
+  EXPECT_EQ(getFilename(A.FileId), "foo.c");
+
+  // Different pointers to the same filename get the same id.
+  static char const OtherFoo[] = "foo.c";
+  EXPECT_EQ(DebugInfo(1, OtherFoo), A);
+  EXPECT_EQ(internFilename(std::string(OtherFoo)), A.FileId);
+
+  DebugInfo C(1, "bar.c");
+  EXPECT_NE(C.FileId, A.FileId);
+  EXPECT_EQ(getFilename(C.FileId), "bar.c");
+}
+
+} // namespace
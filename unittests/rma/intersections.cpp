@@ -26,4 +26,66 @@ TEST(RMAIntervals, FindIntersections) {
   EXPECT_THAT(Conflicting, ElementsAre(C));
 }
 
+TEST(RMAIntervals, FindLongIntersections) {
+  using ::testing::ElementsAre;
+  rma_analyzer_state State;
+  auto &Intervals = State.Intervals;
+  // A long interval starting before its non-intersecting neighbors must still
+  // be found.
+  Access A{Interval{0, 100}, AccessType::LOCAL_WRITE, DebugInfo()};
+  Access B{Interval{10, 12}, AccessType::RMA_READ, DebugInfo()};
+  Access C{Interval{20, 22}, AccessType::RMA_READ, DebugInfo()};
+  Intervals.insert(A);
+  Intervals.insert(B);
+  Intervals.insert(C);
+
+  Access NewAccess{Interval{50, 60}, AccessType::RMA_READ, DebugInfo()};
+  EXPECT_THAT(State.getIntersectingIntervals(NewAccess), ElementsAre(A));
+  EXPECT_THAT(State.getConflictingIntervals(NewAccess), ElementsAre(A));
+
+  Intervals.clear();
+  EXPECT_TRUE(State.getIntersectingIntervals(NewAccess).empty());
+}
+
+TEST(RMAIntervals, ManyIntersections) {
+  rma_analyzer_state State;
+  auto &Intervals = State.Intervals;
+  // Insert [2i, 2i+1] in an order forcing rebalancing.
+  for (uint64_t I = 0; I < 1000; I++) {
+    uint64_t Low = 2 * ((I * 7919) % 1000);
+    Intervals.insert(
+        Access{Interval{Low, Low + 1}, AccessType::RMA_READ, DebugInfo()});
+  }
+  EXPECT_EQ(Intervals.size(), 1000u);
+
+  Access NewAccess{Interval{101, 120}, AccessType::RMA_WRITE, DebugInfo()};
+  auto Intersecting = State.getIntersectingIntervals(NewAccess);
+  ASSERT_EQ(Intersecting.size(), 11u);
+  // Results are ordered on their interval.
+  for (size_t I = 0; I < Intersecting.size(); I++) {
+    EXPECT_EQ(Intersecting[I].get().Itv.Low, 100 + 2 * I);
+  }
+}
+
+TEST(RMAIntervals, MergeAccesses) {
+  DebugInfo Dbg(1, "merge.c");
+  Access A{Interval{0, 3}, AccessType::RMA_WRITE, Dbg};
+  // Adjacent accesses are merged.
+  EXPECT_TRUE(A.tryMerge(Access{Interval{4, 7}, AccessType::RMA_WRITE, Dbg}));
+  EXPECT_EQ(A.Itv, (Interval{0, 7}));
+  // Conflicting accesses are not, even if they overlap.
+  EXPECT_FALSE(A.tryMerge(Access{Interval{6, 9}, AccessType::RMA_WRITE, Dbg}));
+  // Neither are accesses with a different type or location.
+  EXPECT_FALSE(A.tryMerge(Access{Interval{8, 9}, AccessType::RMA_READ, Dbg}));
+  EXPECT_FALSE(
+      A.tryMerge(Access{Interval{8, 9}, AccessType::RMA_WRITE, DebugInfo()}));
+  EXPECT_EQ(A.Itv, (Interval{0, 7}));
+
+  Access B{Interval{10, 13}, AccessType::RMA_READ, Dbg};
+  EXPECT_TRUE(B.tryMerge(Access{Interval{12, 20}, AccessType::RMA_READ, Dbg}));
+  EXPECT_TRUE(B.tryMerge(Access{Interval{2, 9}, AccessType::RMA_READ, Dbg}));
+  EXPECT_EQ(B.Itv, (Interval{2, 20}));
+  EXPECT_FALSE(B.tryMerge(Access{Interval{30, 40}, AccessType::RMA_READ, Dbg}));
+}
+
 } // namespace
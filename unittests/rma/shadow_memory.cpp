@@ -0,0 +1,68 @@
+#include "ShadowMemory.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace parcoach::rma;
+
+namespace {
+
+Access makeAccess(uint64_t Low, uint64_t Up, AccessType T, int Line = 0) {
+  return Access{Interval{Low, Up}, T, DebugInfo(Line, nullptr)};
+}
+
+std::vector<Access> conflicting(ShadowMemory const &Shadow, Access const &A) {
+  std::vector<Access> Ret;
+  Shadow.forEachConflicting(A,
+                            [&](Access const &Found) { Ret.push_back(Found); });
+  return Ret;
+}
+
+TEST(RMAShadowMemory, Conflicts) {
+  ShadowMemory Shadow(1000, 100);
+  EXPECT_EQ(Shadow.range(), (Interval{1000, 1099}));
+  Shadow.insert(makeAccess(1010, 1019, AccessType::LOCAL_READ));
+  Shadow.insert(makeAccess(1040, 1079, AccessType::RMA_READ, 1));
+
+  // Reads never conflict.
+  EXPECT_TRUE(conflicting(Shadow, makeAccess(1000, 1099, AccessType::RMA_READ))
+                  .empty());
+  // Local accesses only conflict with RMA accesses.
+  EXPECT_TRUE(
+      conflicting(Shadow, makeAccess(1015, 1015, AccessType::LOCAL_WRITE))
+          .empty());
+  EXPECT_EQ(
+      conflicting(Shadow, makeAccess(1075, 1090, AccessType::LOCAL_WRITE)),
+      (std::vector<Access>{makeAccess(1040, 1079, AccessType::RMA_READ, 1)}));
+  // Only bytes actually touched matter.
+  EXPECT_TRUE(
+      conflicting(Shadow, makeAccess(1020, 1039, AccessType::RMA_WRITE))
+          .empty());
+  EXPECT_EQ(conflicting(Shadow, makeAccess(1019, 1040, AccessType::RMA_WRITE))
+                .size(),
+            2u);
+}
+
+TEST(RMAShadowMemory, MergeAndClear) {
+  ShadowMemory Shadow(0, 64);
+  for (uint64_t I = 0; I < 8; I++) {
+    Shadow.insert(makeAccess(I * 4, I * 4 + 3, AccessType::RMA_WRITE));
+  }
+  // Consecutive accesses from the same place are merged.
+  std::vector<Access> All;
+  Shadow.forEachIntersecting(Interval{0, 63},
+                             [&](Access const &A) { All.push_back(A); });
+  EXPECT_EQ(All, (std::vector<Access>{
+                     makeAccess(0, 31, AccessType::RMA_WRITE)}));
+  EXPECT_EQ(conflicting(Shadow, makeAccess(31, 40, AccessType::LOCAL_READ))
+                .size(),
+            1u);
+
+  Shadow.clear();
+  EXPECT_TRUE(Shadow.empty());
+  EXPECT_TRUE(
+      conflicting(Shadow, makeAccess(0, 63, AccessType::RMA_WRITE)).empty());
+}
+
+} // namespace